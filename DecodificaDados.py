@@ -0,0 +1,154 @@
+import binascii
+import struct
+import sys
+
+# Decodifica um arquivo binário comprimido do datalogger (.imu) para CSV.
+# Formato dos blocos descrito em lib/compressao.h.
+# Uso: python DecodificaDados.py ArquivosDados/mpu_data.imu [saida.csv] [--bruto]
+#
+# Gravações em RAID-0 deixam um arquivo .imu em cada cartão; passe os dois na ordem dos
+# cartões (0 e depois 1) e o tamanho da faixa em setores, se diferente do padrão:
+#   python DecodificaDados.py cartao0/mpu_data.imu cartao1/mpu_data.imu [saida.csv] [--faixa=8]
+#
+# No espelho (RAID-1) cada cartão tem a gravação inteira; basta um dos arquivos. Se um
+# cartão falhou durante a gravação, o arquivo dele termina no primeiro bloco inválido.
+#
+# Para gravações grandes, host/ tem a ferramenta imulog em C++: mesma saída, lida com
+# mapeamento em memória e decodificada em paralelo, e exporta também matrizes .npy.
+
+BLOCO_TAM = 512
+BLOCO_MAGICO = 0x42554D49
+CABECALHO = struct.Struct("<IIIHHHBB")
+QUADRO_CHAVE = struct.Struct("<I6h")
+
+SENSIBILIDADE_ACCEL = 16384.0
+SENSIBILIDADE_GYRO = 131.0
+
+FAIXA_PADRAO = 8  # RAID_FAIXA_SETORES em datalogger.c
+
+
+def ler_varint(dados, pos):
+    valor = 0
+    deslocamento = 0
+    while True:
+        byte = dados[pos]
+        pos += 1
+        valor |= (byte & 0x7F) << deslocamento
+        if not byte & 0x80:
+            return valor, pos
+        deslocamento += 7
+
+
+def dezigzag(v):
+    return (v >> 1) ^ -(v & 1)
+
+
+def para_int16(v):
+    return ((v + 0x8000) & 0xFFFF) - 0x8000
+
+
+def decodificar_bloco(bloco):
+    magico, sessao, seq, n, tam, crc, canais, canal = CABECALHO.unpack_from(bloco)
+    if magico != BLOCO_MAGICO:
+        return None
+    # CRC-16/XMODEM do bloco com o campo de CRC zerado
+    if binascii.crc_hqx(bloco[:16] + b"\0\0" + bloco[18:], 0) != crc:
+        return None
+
+    # Com vários sensores, dt e canal vêm juntos no primeiro varint e os deltas são
+    # relativos à amostra anterior do mesmo canal (ou ao quadro-chave)
+    canais = canais or 1
+    dados = bloco[CABECALHO.size:CABECALHO.size + tam]
+    tempo, *chave = QUADRO_CHAVE.unpack_from(dados)
+    anteriores = {canal: chave}
+    amostras = [(tempo, canal, *chave)]
+    pos = QUADRO_CHAVE.size
+    for _ in range(n - 1):
+        v, pos = ler_varint(dados, pos)
+        tempo += v // canais
+        canal = v % canais
+        eixos = list(anteriores.get(canal, chave))
+        for i in range(6):
+            v, pos = ler_varint(dados, pos)
+            eixos[i] = para_int16(eixos[i] + dezigzag(v))
+        anteriores[canal] = eixos
+        amostras.append((tempo, canal, *eixos))
+    return sessao, seq, canais, amostras
+
+
+def ler_blocos(arquivos, faixa):
+    # Com mais de um arquivo, as faixas de `faixa` blocos se alternam entre eles
+    # na ordem dos cartões; a gravação termina na primeira faixa incompleta
+    if len(arquivos) == 1:
+        while True:
+            bloco = arquivos[0].read(BLOCO_TAM)
+            if len(bloco) < BLOCO_TAM:
+                return
+            yield bloco
+    while True:
+        for f in arquivos:
+            dados = f.read(BLOCO_TAM * faixa)
+            for i in range(0, len(dados) - BLOCO_TAM + 1, BLOCO_TAM):
+                yield dados[i:i + BLOCO_TAM]
+            if len(dados) < BLOCO_TAM * faixa:
+                return
+
+
+def main():
+    args = [a for a in sys.argv[1:] if not a.startswith("--")]
+    bruto = "--bruto" in sys.argv
+    faixa = FAIXA_PADRAO
+    for a in sys.argv[1:]:
+        if a.startswith("--faixa="):
+            faixa = int(a.split("=", 1)[1])
+    entradas = [a for a in args if a.lower().endswith(".imu")] or args[:1]
+    if not entradas:
+        print("Uso: python DecodificaDados.py entrada.imu [entrada_cartao1.imu] [saida.csv] [--bruto] [--faixa=N]")
+        sys.exit(1)
+    outros = [a for a in args if a not in entradas]
+    saida = outros[0] if outros else entradas[0].rsplit(".", 1)[0] + ".csv"
+
+    sessao_atual = None
+    seq_esperada = 0
+    total = 0
+    arquivos = [open(e, "rb") for e in entradas]
+    with open(saida, "w") as out:
+        varios = None  # Coluna do sensor só em gravações com mais de um
+        for bloco in ler_blocos(arquivos, faixa):
+            resultado = decodificar_bloco(bloco)
+            if resultado is None:
+                print(f"Bloco {total} inválido, decodificação encerrada")
+                break
+            sessao, seq, canais, amostras = resultado
+            if sessao_atual is None:
+                sessao_atual = sessao
+                varios = canais > 1
+                out.write("time_ms," + ("sensor," if varios else "") +
+                          "accel_x,accel_y,accel_z,giro_x,giro_y,giro_z\n")
+            if sessao != sessao_atual:
+                print(f"Bloco {seq} pertence a outra sessão, decodificação encerrada")
+                break
+            if seq != seq_esperada:
+                print(f"Aviso: esperado bloco {seq_esperada}, lido {seq}")
+            seq_esperada = seq + 1
+
+            for t, canal, ax, ay, az, gx, gy, gz in amostras:
+                if varios:
+                    out.write(f"{t},{canal},")
+                else:
+                    out.write(f"{t},")
+                if bruto:
+                    out.write(f"{ax},{ay},{az},{gx},{gy},{gz}\n")
+                else:
+                    out.write(f"{ax / SENSIBILIDADE_ACCEL:.5f},{ay / SENSIBILIDADE_ACCEL:.5f},"
+                              f"{az / SENSIBILIDADE_ACCEL:.5f},{gx / SENSIBILIDADE_GYRO:.3f},"
+                              f"{gy / SENSIBILIDADE_GYRO:.3f},{gz / SENSIBILIDADE_GYRO:.3f}\n")
+            total += 1
+    for f in arquivos:
+        f.close()
+
+    print(f"{total} blocos decodificados em {saida}")
+
+
+if __name__ == "__main__":
+    main()
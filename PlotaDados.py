@@ -1,7 +1,8 @@
 import pandas as pd
 import matplotlib.pyplot as plt
 
-# Lê o arquivo CSV
+# Lê o arquivo CSV. Para sessões longas demais para desenhar amostra por amostra, use o
+# envelope mínimo/máximo de host/ (imulog_envelope, formato em host/envelope.h)
 df = pd.read_csv("ArquivosDados/mpu_data.csv")
 
  # Converte o tempo de milissegundos para segundos para melhor visualização
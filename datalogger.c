@@ -7,21 +7,166 @@
 #include "pico/stdlib.h"
 #include "pico/binary_info.h"
 #include "pico/bootrom.h"
+#include "pico/multicore.h"
 #include "hardware/i2c.h"
 #include "hardware/pwm.h"
 #include "hardware/timer.h"
 
 #include "ff.h"
 #include "diskio.h"
+#include "disk_cache.h"
 #include "f_util.h"
 #include "hw_config.h"
 #include "my_debug.h"
+#include "raid.h"
+#include "rtc.h"
 #include "sd_card.h"
 #include "ssd1306.h"
+#include "amostra.h"
+#include "calibracao.h"
+#include "compressao.h"
+#include "decimador.h"
+#include "espectro.h"
+#include "evento.h"
+#include "recuperacao.h"
+#include "indice.h"
+#include "mapa_clusters.h"
+#include "formatacao.h"
+#include "fusao.h"
+#include "mpu6050.h"
+#include "barramento_i2c.h"
+#include "resumo.h"
 
 // Definição de intervalos
 #define LED_BLINK_MS 200
 #define BUZZER_BEEP_MS 100
+#define DISPLAY_UPD_MS 500
+
+// Calibração de bias: média de CALIBRACAO_AMOSTRAS leituras com o sensor parado, feita no
+// boot quando não há offsets na flash ou pelo comando "cal" no terminal USB
+#define CALIBRACAO_AMOSTRAS 500
+#define CALIBRACAO_INTERVALO_US 2000   // 1 s de medida
+
+// Política de durabilidade: f_sync quando SYNC_BYTES forem gravados ou SYNC_MS passarem desde
+// o último sync (0 desativa o critério). Numa queda de energia perde-se no máximo essa janela,
+// mais as amostras ainda na fila. No formato binário o bloco parcial é fechado a cada sync, mesmo
+// incompleto, para não ficar em RAM além da janela
+#define SYNC_BYTES 32768
+#define SYNC_MS 5000
+
+// Falha do cartão durante a gravação (retirada ou erro de escrita/sync): a escrita para na hora e as amostras ficam retidas em RAM, até
+// RESERVA_AMOSTRAS (potência de 2). O cartão é reiniciado e o volume remontado em tentativas
+// espaçadas de CARTAO_ESTAVEL_MS, dobrando até CARTAO_ESPERA_MAX_MS; a gravação continua no
+// mesmo arquivo a partir do último sync. As amostras gravadas desde esse sync ficam num
+// diário em RAM (DIARIO_AMOSTRAS, potência de 2) e são regravadas antes das retidas, então
+// nada se perde enquanto a reserva não transborda. Um diário a 3/4 força o sync.
+// Na BitDogLab o pino de detecção do cartão (GPIO 22) é o botão do joystick, então
+// use_card_detect fica desligado em hw_config.c e uma retirada só é notada na primeira escrita
+// ou sync que falhar; com a detecção ligada, a pausa começa no momento da retirada
+#define RESERVA_AMOSTRAS 1024
+#define DIARIO_AMOSTRAS 1024
+#define CARTAO_ESTAVEL_MS 500
+#define CARTAO_ESPERA_MAX_MS 8000
+
+// Modo de gravação: 0 grava todas as amostras, 1 grava apenas janelas em torno de eventos
+#define MODO_EVENTO 0
+
+// Formato do arquivo: 0 grava CSV, 1 grava blocos binários comprimidos (ver compressao.h)
+#define FORMATO_BINARIO 0
+
+// No formato binário o arquivo é pré-alocado de forma contígua com este tamanho; se a
+// energia cair durante a gravação, o tamanho real é recuperado no próximo boot
+#define PREALOCACAO_MB 64
+
+// Índice de tempo ao lado do log (mpu_data.csv -> mpu_data.idx, formato em indice.h): uma
+// entrada a cada INDICE_PASSO linhas do CSV ou INDICE_PASSO_BLOCOS blocos do binário. O
+// comando "ver" do terminal usa o índice para mostrar um intervalo de tempo sem ler o log
+// desde o início. Não há índice no RAID, nem quando só o resumo é gravado
+#define INDICE_ATIVO 1
+#define INDICE_PASSO 256
+#define INDICE_PASSO_BLOCOS 8
+
+// RAM, em palavras de 32 bits, para as tabelas de busca rápida (FF_USE_FASTSEEK) dos logs
+// lidos pelo terminal ("ver", "cauda", "trecho"), guardadas entre um comando e outro
+// (mapa_clusters.h). Um log contíguo usa 4 palavras, e cada fragmento a mais, 2; um log
+// fragmentado demais para o orçamento é lido seguindo a FAT
+#define MAPA_CLUSTERS_PALAVRAS 512
+
+// Maior trecho do log enviado em hexadecimal por um comando "trecho"
+#define TRECHO_MAX 4096
+
+// Dois cartões em SPIs separadas (RAID_MODO vem do CMakeLists.txt porque hw_config.c também
+// depende dele). Com 1, os blocos do formato binário são distribuídos em faixas de
+// RAID_FAIXA_SETORES entre os cartões 0 e 1 e gravados nos dois ao mesmo tempo; cada cartão
+// recebe um arquivo de mesmo nome pré-alocado com PREALOCACAO_MB.
+// Com 2, cada bloco vai para os dois cartões (espelho). Cada cartão tem sua própria fila
+// em RAID_FILA_SETORES setores de RAM e grava até RAID_FAIXA_SETORES por vez quando está
+// livre, então um cartão lento pode atrasar sem travar o outro; o cartão que falhar é
+// descartado e a gravação continua no que sobrou
+#ifndef RAID_MODO
+#define RAID_MODO 0
+#endif
+#define RAID_FAIXA_SETORES 8
+#define RAID_FILA_SETORES 64
+
+// O sensor é lido FATOR_DECIMACAO vezes por intervalo de gravação e filtrado antes
+// de armazenar (1, 2, 4 ou 8; 1 desativa o filtro)
+#define FATOR_DECIMACAO 1
+
+// Orientação: 1 grava o quaternion estimado no núcleo 1 em vez dos eixos brutos.
+// O sensor é lido a cada FUSAO_PERIODO_US e um quaternion é gravado por intervalo de
+// gravação; FATOR_DECIMACAO não se aplica neste modo
+#define LOG_ORIENTACAO 0
+#define FUSAO_MODO FUSAO_COMPLEMENTAR
+#define FUSAO_PERIODO_US 1000       // 1 kHz
+#define FUSAO_GANHO_MIL 1000        // Kp = 1,0 (complementar); use ~100 para beta no Madgwick
+
+// Espectro de vibração: 1 amostra o sensor a cada ESPECTRO_PERIODO_US, calcula a FFT de
+// ESPECTRO_N pontos de um eixo do acelerômetro e grava potência por faixa e frequência
+// dominante em arquivo_espectro. A gravação normal continua a cada intervalo_log
+#define ESPECTRO_ATIVO 0
+#define ESPECTRO_N 512              // 256, 512 ou 1024 pontos
+#define ESPECTRO_PERIODO_US 1000    // 1 kHz: faixas de 62,5 Hz até 500 Hz
+#define ESPECTRO_EIXO 2             // 0 = X, 1 = Y, 2 = Z
+
+// Resumo estatístico: 1 grava por janela de RESUMO_JANELA_MS a média, mínimo, máximo, RMS,
+// pico e fator de crista de cada eixo. Com RESUMO_GRAVA_BRUTO 1 as amostras continuam
+// no arquivo principal e o resumo vai para arquivo_resumo; com 0 só o resumo é gravado
+#define RESUMO_ATIVO 0
+#define RESUMO_GRAVA_BRUTO 0
+#define RESUMO_INTERVALO_MS 5         // 200 Hz: 200 amostras resumidas por janela
+#define RESUMO_JANELA_MS 1000
+
+#if RESUMO_ATIVO && MODO_EVENTO
+#error "MODO_EVENTO usa seu próprio intervalo de amostragem e não funciona com RESUMO_ATIVO"
+#endif
+#if RESUMO_ATIVO && !RESUMO_GRAVA_BRUTO && (FORMATO_BINARIO || LOG_ORIENTACAO)
+#error "Sem RESUMO_GRAVA_BRUTO o arquivo principal recebe o resumo em CSV"
+#endif
+
+#if RAID_MODO && !FORMATO_BINARIO
+#error "RAID_MODO distribui setores de 512 bytes e exige FORMATO_BINARIO"
+#endif
+
+#if LOG_ORIENTACAO && ESPECTRO_ATIVO
+#error "LOG_ORIENTACAO lê o sensor no núcleo 1 e não alimenta o espectro"
+#endif
+
+#if LOG_ORIENTACAO && MODO_EVENTO
+#error "MODO_EVENTO dispara por limiares de aceleração e não funciona com LOG_ORIENTACAO"
+#endif
+
+// No RAID o arquivo é dividido entre os cartões, e sem RESUMO_GRAVA_BRUTO as amostras não
+// chegam ao arquivo principal
+#define INDICE_GRAVA (INDICE_ATIVO && !RAID_MODO && !(RESUMO_ATIVO && !RESUMO_GRAVA_BRUTO))
+
+// Parâmetros do modo por evento
+#define EVENTO_INTERVALO_MS 10       // Amostragem de 100 Hz para capturar impactos
+#define EVENTO_PRE_MS 2000           // Histórico mantido em RAM antes do disparo
+#define EVENTO_POS_MS 3000           // Janela gravada após o último disparo
+#define EVENTO_LIMIAR_ACCEL 24576    // 1,5 g no fundo de escala de ±2 g (16384 LSB/g)
+#define EVENTO_LIMIAR_GYRO 26200     // 200 °/s no fundo de escala de ±250 °/s (131 LSB/(°/s))
+#define EVENTO_CAPACIDADE 256        // Potência de 2 >= EVENTO_PRE_MS / EVENTO_INTERVALO_MS
 
 // Definição de parâmetros PWM para Buzzer
 #define WRAP 1000
@@ -44,8 +189,49 @@ ssd1306_t ssd;
 #define I2C_SDA 0
 #define I2C_SCL 1
 
-// Endereço padrão do MPU6050
-static int addr = 0x68;
+// Sensores lidos em cada amostragem (1 a 4), na ordem de imu_config. Os de barramentos
+// diferentes são lidos ao mesmo tempo e os do mesmo barramento em sequência imediata, com
+// um carimbo de tempo comum por rodada. O i2c1 é o barramento do display, que deixa de ser
+// atualizado durante a gravação quando há sensores nele. A calibração vale para o sensor 0
+#define IMU_SENSORES 1
+static const struct
+{
+    i2c_inst_t *i2c;
+    uint8_t endereco;
+} imu_config[MPU6050_MAX_SENSORES] = {
+    {I2C_PORT, MPU6050_ENDERECO_AD0_BAIXO},
+    {I2C_PORT_DISP, MPU6050_ENDERECO_AD0_BAIXO},
+    {I2C_PORT, MPU6050_ENDERECO_AD0_ALTO},
+    {I2C_PORT_DISP, MPU6050_ENDERECO_AD0_ALTO},
+};
+static mpu6050_grupo_t imus;
+
+// Barramentos por índice do controlador (i2c0, i2c1). Um sensor com IMU_FALHAS_RECUPERAR
+// leituras seguidas sem resposta marca o seu barramento em imu_recuperar; a amostragem
+// fica suspensa até o laço principal limpar o barramento e reiniciar os sensores dele
+#define IMU_FALHAS_RECUPERAR 10
+static barramento_i2c_t barramento[2];
+static volatile uint32_t imu_recuperar = 0;
+static uint32_t imu_recuperacoes = 0;
+static volatile uint32_t imu_rodadas_puladas = 0;
+
+// Com IMU_DMA a leitura do sensor 0 é feita por DMA: o temporizador só dispara a rajada e
+// a amostra segue para a fila na IRQ de fim do DMA, sem a CPU esperar o barramento
+#define IMU_DMA 0
+#if IMU_DMA
+static mpu6050_dma_t imu_dma;
+static void imu_dma_concluida();
+#endif
+
+#if IMU_SENSORES < 1 || IMU_SENSORES > MPU6050_MAX_SENSORES
+#error "IMU_SENSORES vai de 1 a 4"
+#endif
+#if IMU_SENSORES > 1 && (LOG_ORIENTACAO || MODO_EVENTO || RESUMO_ATIVO || FATOR_DECIMACAO > 1)
+#error "Com vários sensores as amostras são gravadas diretamente, sem fusão, evento, resumo ou decimação"
+#endif
+#if IMU_DMA && (IMU_SENSORES > 1 || LOG_ORIENTACAO)
+#error "A leitura por DMA atende um sensor lido pelo temporizador"
+#endif
 
 // Pinos
 const uint8_t btn_A_pin = 5;
@@ -80,8 +266,85 @@ static uint8_t buzzer_num_beeps;
 
 // Parâmetros para gravação de dados
 static volatile uint curr_amostras = 0;
+#if MODO_EVENTO
+static const uint32_t intervalo_log = EVENTO_INTERVALO_MS;
+#elif RESUMO_ATIVO
+static const uint32_t intervalo_log = RESUMO_INTERVALO_MS;
+#else
 static const uint32_t intervalo_log = 250;
-static absolute_time_t last_log_time;
+#endif
+static absolute_time_t last_display_time;
+
+// Amostragem periódica por temporizador: a leitura do sensor não espera pela escrita no SD
+struct repeating_timer amostragem_timer;
+static absolute_time_t inicio_gravacao;
+static amostra_t fila_buf[64];
+static fila_amostras_t fila;
+static volatile uint32_t amostras_perdidas = 0;
+static decimador_t decimador;
+
+// Amostras acumuladas enquanto o cartão está fora do soquete
+static amostra_t reserva_buf[RESERVA_AMOSTRAS];
+static fila_amostras_t reserva;
+static bool gravacao_pausada = false;
+static uint32_t cartao_estavel_ms; // Última tentativa de retomar, ou último instante sem o cartão
+static uint32_t cartao_espera_ms;  // Intervalo até a próxima tentativa
+static amostra_t diario_buf[DIARIO_AMOSTRAS];
+static fila_amostras_t diario;     // Amostras gravadas após o último sync
+static uint32_t diario_descartes;  // Amostras que não couberam no diário
+// Custo das falhas, para dimensionar a reserva
+static uint32_t falha_inicio_ms;
+static uint32_t falha_tentativas;
+static uint32_t falhas_sd;
+static uint32_t falha_max_ms;
+static uint32_t falha_total_ms;
+static uint32_t reserva_pico;
+
+#if LOG_ORIENTACAO
+// O núcleo 1 lê o sensor e executa a fusão; o núcleo 0 só grava os quaternions
+static fusao_t fusao;
+static volatile bool fusao_ativa = false;
+static bool nucleo1_iniciado = false;
+#endif
+
+#if ESPECTRO_ATIVO
+static int16_t espectro_buf[2 * ESPECTRO_N];
+static espectro_t espectro;
+static uint32_t espectro_subamostra;
+static FIL arquivo_espectro;
+static const char *arquivo_espectro_nome = "mpu_spec.csv";
+#endif
+
+#if RESUMO_ATIVO
+static resumo_t resumo;
+static resumo_registro_t resumo_pendente; // Registro cuja escrita falhou, regravado na retomada
+static bool resumo_tem_pendente = false;
+#if RESUMO_GRAVA_BRUTO
+static FIL arquivo_resumo;
+static const char *arquivo_resumo_nome = "mpu_resumo.csv";
+#endif
+#endif
+
+#if MODO_EVENTO
+static amostra_t evento_buf[EVENTO_CAPACIDADE];
+static evento_t evento;
+#endif
+
+// Offsets subtraídos de cada leitura bruta do sensor
+static calibracao_t calibracao;
+
+// Linha recebida pelo terminal USB
+static char comando[32];
+static uint8_t comando_len = 0;
+static int formatar_pendente = -1; // Cartão de um "formatar" ainda por confirmar
+
+// Estado e custo da política de sync
+static FSIZE_t sync_ultimo_tam;
+static uint32_t sync_ultimo_ms;
+static uint32_t sync_contagem;
+static uint64_t sync_total_us;
+static uint32_t sync_max_us;
+static bool sync_auxiliares; // Espectro ou resumo gravados em arquivo próprio desde o último sync
 
 // Flags acionadas pelos botões
 static volatile bool gravacao_req = false;
@@ -92,8 +355,44 @@ static volatile bool mudanca_display = false;
 
 // Definições iniciais do arquivo CSV
 static FIL file;
+#if RESUMO_ATIVO && !RESUMO_GRAVA_BRUTO
+static char filename[20] = "mpu_resumo.csv";
+#elif FORMATO_BINARIO
+static char filename[20] = "mpu_data.imu";
+static compressor_t compressor;
+#if RAID_MODO == 1
+#define RAID_BUF_SETORES (RAID_MEMBERS * RAID_FAIXA_SETORES) // Uma linha de faixas
+#elif RAID_MODO == 2
+#define RAID_BUF_SETORES RAID_FILA_SETORES                    // Anel das filas do espelho
+#endif
+#if RAID_MODO
+static raid_t raid;
+static uint8_t raid_buf[RAID_BUF_SETORES * FF_MAX_SS];
+#endif
+#else
 static char filename[20] = "mpu_data.csv";
+#endif
+#if INDICE_GRAVA
+static indice_t indice;
+static char indice_arquivo[24];
+#endif
+#if !RAID_MODO
+static DWORD mapa_clusters_memoria[MAPA_CLUSTERS_PALAVRAS];
+static mapa_clusters_t mapa_clusters;
+#endif
+#if RESUMO_ATIVO
+// Por eixo: média, mínimo, máximo, RMS e pico em g ou °/s, e fator de crista
+static const char *const resumo_eixos[RESUMO_EIXOS] = {"accel_x", "accel_y", "accel_z", "giro_x", "giro_y", "giro_z"};
+#endif
+#if RESUMO_ATIVO && !RESUMO_GRAVA_BRUTO
+const char *cabecalho = NULL; // Gerado por write_summary_header()
+#elif LOG_ORIENTACAO
+const char *cabecalho = "time_ms,q_w,q_x,q_y,q_z\n";
+#elif IMU_SENSORES > 1
+const char *cabecalho = "time_ms,sensor,accel_x,accel_y,accel_z,giro_x,giro_y,giro_z\n";
+#else
 const char *cabecalho = "time_ms,accel_x,accel_y,accel_z,giro_x,giro_y,giro_z\n";
+#endif
 
 // ------------------------------------ Protótipos ---------------------------------------
 
@@ -102,22 +401,62 @@ static void init_leds();
 static void init_buttons();
 static void init_buzzer_pwm();
 
-// Inicialização e leitura do sensor MPU6050
-static void mpu6050_reset();
-static void mpu6050_read_raw(int16_t accel[3], int16_t gyro[3]);
-static void mpu6050_read_process(float *ax, float *ay, float *az, float *gx, float *gy, float *gz);
+// Inicialização e leitura dos sensores MPU6050
+static void init_imus();
+static bool ler_sensor_principal(int16_t accel[3], int16_t gyro[3]);
+static bool imu_no_barramento(i2c_inst_t *i2c);
+static uint32_t imu_barramentos_travados();
+static void recuperar_imus(uint32_t barramentos);
+static void recuperar_display();
+static void run_calibration();
 
 // Leitura e escrita no cartão SD
 static sd_card_t *sd_get_by_name(const char *const name);
 static FATFS *sd_get_fs_by_name(const char *name);
 static uint8_t run_mount();
 static uint8_t run_unmount();
+static void format_card(size_t n);
 static void capture_mpu_data_and_save();
+static bool save_sample(const amostra_t *a);
+static bool save_pending();
+static bool sync_if_due();
+static FSIZE_t bytes_gravados();
+static FRESULT close_main_file();
+#if !RAID_MODO
+static bool cartao_disponivel();
+static void pausar_gravacao(const char *motivo);
+static bool retomar_gravacao();
+static bool repetir_diario();
+#endif
+static bool gravar_amostra(const amostra_t *a);
+static void start_capture();
+static void stop_capture();
+#if ESPECTRO_ATIVO
+static bool save_spectrum();
+#endif
+#if RESUMO_ATIVO
+static bool write_summary_header(FIL *f);
+static bool save_summary(const resumo_registro_t *r);
+#endif
 static void read_file(const char *filename);
+#if !RAID_MODO
+static void read_range(const char *filename, uint32_t de_ms, uint32_t ate_ms);
+static void read_tail(const char *filename, uint32_t ms);
+static void export_chunk(const char *filename, FSIZE_t offset, uint32_t tam);
+static FRESULT open_for_reading(const char *filename, bool *com_tabela);
+#endif
+#if FORMATO_BINARIO
+static void print_sample(const amostra_t *a);
+static void recover_session();
+#endif
+#if INDICE_GRAVA
+static bool indexar(FSIZE_t offset, const amostra_t *a);
+#endif
 
 // Processamento de eventos e atualização de estados dos periféricos
 void gpio_irq_handler(uint gpio, uint32_t events);
 static void processar_botoes();
+static void processar_comandos();
 static void set_led_state();
 static char *get_state_name(Sistema estado);
 static void display_upd();
@@ -126,21 +465,24 @@ static void handle_error(Sistema tipo, uint32_t duracao);
 // Temporizadores
 bool led_blink_callback(struct repeating_timer *t);
 bool buzzer_beep_callback(struct repeating_timer *t);
+bool amostragem_callback(struct repeating_timer *t);
+
+#if LOG_ORIENTACAO
+static void nucleo1_fusao();
+#endif
 
 // --------------------------------------------------------------------------------------
 
 int main()
 {
     stdio_init_all();
+    time_init(); // RTC e carimbo de data dos arquivos
 
     // Inicialização dos LEDs e I2C do Display OLED
     init_leds();
 
-    i2c_init(I2C_PORT_DISP, 400 * 1000);
-    gpio_set_function(I2C_SDA_DISP, GPIO_FUNC_I2C);
-    gpio_set_function(I2C_SCL_DISP, GPIO_FUNC_I2C);
-    gpio_pull_up(I2C_SDA_DISP);
-    gpio_pull_up(I2C_SCL_DISP);
+    barramento_i2c_init(&barramento[i2c_hw_index(I2C_PORT_DISP)], I2C_PORT_DISP, I2C_SDA_DISP, I2C_SCL_DISP,
+                        400 * 1000);
 
     ssd1306_init(&ssd, WIDTH, HEIGHT, false, ENDERECO_DISP, I2C_PORT_DISP);
     ssd1306_config(&ssd);
@@ -155,16 +497,31 @@ int main()
 
     init_buttons();
 
+#if !RAID_MODO
+    mapa_clusters_iniciar(&mapa_clusters, mapa_clusters_memoria, MAPA_CLUSTERS_PALAVRAS);
+#endif
+
     // Inicialização da I2C do MPU6050
-    i2c_init(I2C_PORT, 400 * 1000);
-    gpio_set_function(I2C_SDA, GPIO_FUNC_I2C);
-    gpio_set_function(I2C_SCL, GPIO_FUNC_I2C);
-    gpio_pull_up(I2C_SDA);
-    gpio_pull_up(I2C_SCL);
+    barramento_i2c_init(&barramento[i2c_hw_index(I2C_PORT)], I2C_PORT, I2C_SDA, I2C_SCL, 400 * 1000);
 
     // Declara os pinos como I2C na Binary Info
     bi_decl(bi_2pins_with_func(I2C_SDA, I2C_SCL, GPIO_FUNC_I2C));
-    mpu6050_reset();
+    init_imus();
+
+    if (calibracao_carregar(&calibracao))
+    {
+        printf("Calibração carregada da flash\n");
+    }
+    else
+    {
+        printf("Sem calibração gravada. Mantenha o sensor parado...\n");
+        run_calibration();
+    }
+
+#if LOG_ORIENTACAO
+    multicore_launch_core1(nucleo1_fusao);
+    nucleo1_iniciado = true;
+#endif
 
     // Monta o cartão MicroSD
     uint8_t falha = run_mount();
@@ -174,6 +531,22 @@ int main()
         handle_error(SD_NOT_FOUND, 1000);
         reset_usb_boot(0, 0);
     }
+#if RAID_MODO
+    // O segundo cartão recebe metade das faixas ou a cópia de cada bloco
+    sd_card_t *pSD1 = sd_get_by_num(1);
+    FRESULT fr1 = f_mount(&pSD1->fatfs, pSD1->pcName, 1);
+    if (fr1 != FR_OK)
+    {
+        printf("Cartão %s não montou (%s); o RAID precisa dos dois cartões\n", pSD1->pcName, FRESULT_str(fr1));
+        handle_error(SD_NOT_FOUND, 1000);
+        reset_usb_boot(0, 0);
+    }
+    pSD1->mounted = true;
+#endif
+
+#if FORMATO_BINARIO
+    recover_session();
+#endif
 
     estado_atual = READY;
     while (true)
@@ -186,14 +559,20 @@ int main()
         }
 
         processar_botoes();
+        processar_comandos();
 
         if (estado_atual == CAPTURA)
         {   
+            if (imu_recuperar)
+            {
+                recuperar_imus(imu_recuperar);
+            }
+            capture_mpu_data_and_save();
+
             absolute_time_t now = get_absolute_time();
-            if (absolute_time_diff_us(last_log_time, now) > intervalo_log * 1000)
+            if (estado_atual == CAPTURA && absolute_time_diff_us(last_display_time, now) > DISPLAY_UPD_MS * 1000)
             {   
-                last_log_time = now;
-                capture_mpu_data_and_save();
+                last_display_time = now;
                 display_upd();
             }
         }
@@ -202,6 +581,12 @@ int main()
             reset_usb_boot(0, 0);
         }
 
+        // Garante que setores sujos não fiquem no cache além do tempo limite
+        disk_cache_task();
+
+        // Imprime as mensagens de depuração adiadas do driver do cartão
+        my_log_drain();
+
         sleep_ms(20);
     }
     return 0;
@@ -250,65 +635,100 @@ static void init_buzzer_pwm()
     pwm_set_enabled(buzzer_slice, true);
 }
 
-// Função para resetar e inicializar o MPU6050
-static void mpu6050_reset()
+// Monta o grupo com os IMU_SENSORES primeiros de imu_config e os reinicia
+static void init_imus()
 {
-    // Dois bytes para reset: primeiro o registrador, segundo o dado
-    uint8_t buf[] = {0x6B, 0x80};
-    i2c_write_blocking(I2C_PORT, addr, buf, 2, false);
-    sleep_ms(100); // Aguarda reset e estabilização
-
-    // Sai do modo sleep (registrador 0x6B, valor 0x00)
-    buf[1] = 0x00;
-    i2c_write_blocking(I2C_PORT, addr, buf, 2, false);
-    sleep_ms(10); // Aguarda estabilização após acordar
+    mpu6050_grupo_init(&imus);
+    for (int i = 0; i < IMU_SENSORES; i++)
+    {
+        mpu6050_grupo_adicionar(&imus, imu_config[i].i2c, imu_config[i].endereco);
+        if (!mpu6050_reset(&imus.sensor[i]))
+        {
+            printf("[AVISO] Sensor %d (0x%02x no i2c%u) não respondeu\n", i, imu_config[i].endereco,
+                   i2c_hw_index(imu_config[i].i2c));
+        }
+    }
+#if IMU_DMA
+    mpu6050_dma_init(&imu_dma, imu_config[0].i2c, imu_config[0].endereco, imu_dma_concluida);
+#endif
 }
 
-// Função para ler dados crus do acelerômetro, giroscópio e temperatura
-static void mpu6050_read_raw(int16_t accel[3], int16_t gyro[3])
+// Leitura usada pela calibração e pela fusão, que tratam um único sensor
+static bool ler_sensor_principal(int16_t accel[3], int16_t gyro[3])
 {
-    uint8_t buffer[6];
-
-    // Lê aceleração a partir do registrador 0x3B (6 bytes)
-    uint8_t val = 0x3B;
-    i2c_write_blocking(I2C_PORT, addr, &val, 1, true);
-    i2c_read_blocking(I2C_PORT, addr, buffer, 6, false);
+    return mpu6050_ler(&imus.sensor[0], accel, gyro);
+}
 
-    for (int i = 0; i < 3; i++)
+// Máscara dos barramentos com algum sensor em IMU_FALHAS_RECUPERAR falhas seguidas
+static uint32_t imu_barramentos_travados()
+{
+    uint32_t travados = 0;
+    for (int i = 0; i < IMU_SENSORES; i++)
     {
-        accel[i] = (buffer[i * 2] << 8) | buffer[(i * 2) + 1];
+        if (imus.seguidas[i] >= IMU_FALHAS_RECUPERAR)
+        {
+            travados |= 1u << i2c_hw_index(imus.sensor[i].i2c);
+        }
     }
-
-    // Lê giroscópio a partir do registrador 0x43 (6 bytes)
-    val = 0x43;
-    i2c_write_blocking(I2C_PORT, addr, &val, 1, true);
-    i2c_read_blocking(I2C_PORT, addr, buffer, 6, false);
-
-    for (int i = 0; i < 3; i++)
+#if IMU_DMA
+    if (imu_dma.seguidas >= IMU_FALHAS_RECUPERAR)
     {
-        gyro[i] = (buffer[i * 2] << 8) | buffer[(i * 2) + 1];
+        travados |= 1u << i2c_hw_index(imu_dma.sensor.i2c);
     }
+#endif
+    return travados;
 }
 
-static void mpu6050_read_process(float *ax, float *ay, float *az, float *gx, float *gy, float *gz)
-{   
-    // Lê valor bruto da aceleração e giroscópio do MPU6050
-    int16_t raw_accel[3];
-    int16_t raw_gyro[3];
-    mpu6050_read_raw(raw_accel, raw_gyro);
-
-    // Processa dados da aceleração
-    const float sensibilidade_accel = 16384.0f;
-    *ax = raw_accel[0] / sensibilidade_accel;
-    *ay = raw_accel[1] / sensibilidade_accel;
-    *az = raw_accel[2] / sensibilidade_accel;
+// Limpa os barramentos da máscara (9 pulsos em SCL e STOP) e reinicia os sensores deles.
+// Roda fora de IRQ: o reset do sensor espera cerca de 110 ms
+static void recuperar_imus(uint32_t barramentos)
+{
+    for (uint b = 0; b < 2; b++)
+    {
+        if (!(barramentos & (1u << b)))
+        {
+            continue;
+        }
+        bool livre = barramento_i2c_limpar(&barramento[b]);
+        for (int i = 0; i < IMU_SENSORES; i++)
+        {
+            if (i2c_hw_index(imus.sensor[i].i2c) == b)
+            {
+                mpu6050_reset(&imus.sensor[i]);
+                imus.seguidas[i] = 0;
+            }
+        }
+#if IMU_DMA
+        if (i2c_hw_index(imu_dma.sensor.i2c) == b)
+        {
+            mpu6050_dma_retomar(&imu_dma);
+        }
+#endif
+        imu_recuperacoes++;
+        printf("[AVISO] Barramento i2c%u reiniciado após falhas seguidas do sensor%s\n", b,
+               livre ? "" : " (SDA continua presa)");
+    }
+    imu_recuperar = 0;
+}
 
-    // Processa dados da aceleração
-    const float sensibilidade_gyro = 131.0f;
-    *gx = raw_gyro[0] / sensibilidade_gyro;
-    *gy = raw_gyro[1] / sensibilidade_gyro;
-    *gz = raw_gyro[2] / sensibilidade_gyro;
+// O display falhou: limpa o seu barramento e refaz a configuração; o quadro volta na
+// próxima atualização
+static void recuperar_display()
+{
+    barramento_i2c_limpar(&barramento[i2c_hw_index(I2C_PORT_DISP)]);
+    ssd1306_config(&ssd);
+}
 
+static bool imu_no_barramento(i2c_inst_t *i2c)
+{
+    for (int i = 0; i < IMU_SENSORES; i++)
+    {
+        if (imu_config[i].i2c == i2c)
+        {
+            return true;
+        }
+    }
+    return false;
 }
 
 static sd_card_t *sd_get_by_name(const char *const name)
@@ -364,6 +784,11 @@ static uint8_t run_unmount()
         printf("Unknown logical drive number: \"%s\"\n", arg1);
         return 1;
     }
+    // Descarrega setores ainda retidos no cache de escrita
+    disk_cache_flush(p_fs->pdrv);
+#if !RAID_MODO
+    mapa_clusters_esquecer(&mapa_clusters, p_fs);
+#endif
     FRESULT fr = f_unmount(arg1);
     if (FR_OK != fr)
     {
@@ -378,235 +803,1788 @@ static uint8_t run_unmount()
     return 0;
 }
 
-// Função para capturar dados do ADC e salvar no arquivo *.txt
-void capture_mpu_data_and_save()
-{   
-    // Lê valores do sensor e atualiza número de amostras
-    float accel_x, accel_y, accel_z;
-    float gyro_x, gyro_y, gyro_z;
-    mpu6050_read_process(&accel_x, &accel_y, &accel_z, &gyro_x, &gyro_y, &gyro_z);
-    curr_amostras++;
-
-    // Escreve no arquivo seguindo a formatação CSV
-    char buffer[100];
-    sprintf(buffer, "%i,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", curr_amostras * intervalo_log, accel_x, accel_y, accel_z, gyro_x, gyro_y, gyro_z);
-    UINT bw;
-    FRESULT res = f_write(&file, buffer, strlen(buffer), &bw);
+// Apaga o cartão n e o formata para gravação sequencial (formatacao.h): área de dados
+// alinhada à unidade de alocação do cartão e clusters grandes. O cartão fica montado
+static void format_card(size_t n)
+{
+    sd_card_t *pSD = sd_get_by_num(n);
+    if (!pSD)
+    {
+        printf("[ERRO] Cartão %u não existe\n", (unsigned)n);
+        return;
+    }
+    if (pSD->mounted)
+    {
+        disk_cache_flush(n);
+#if !RAID_MODO
+        mapa_clusters_esquecer(&mapa_clusters, &pSD->fatfs);
+#endif
+        f_unmount(pSD->pcName);
+        pSD->mounted = false;
+    }
+    printf("Formatando o cartão %s...\n", pSD->pcName);
+    absolute_time_t inicio = get_absolute_time();
+    formatacao_t info;
+    FRESULT res = formatacao_executar(pSD->pcName, n, &pSD->fatfs, &info);
     if (res != FR_OK)
     {
-        printf("[ERRO] Não foi possível escrever no arquivo. Monte o Cartao.\n");
-        f_close(&file);
+        printf("[ERRO] Formatação falhou: %s\n", FRESULT_str(res));
         handle_error(ERROR, 1000);
-        estado_atual = READY; // Parar gravação após erro
         return;
     }
-
-    // Faz um FLASH AZUL rápido para indicar amostragem
-    gpio_put(led_red_pin, 0);
-    gpio_put(led_blue_pin, 1);
-    sleep_ms(20);
-    gpio_put(led_blue_pin, 0);
-    gpio_put(led_red_pin, 1); // Reacende VERMELHO referente ao estado de CAPTURA
+    pSD->mounted = true;
+    static const char *const tipos[] = {"?", "FAT12", "FAT16", "FAT32", "exFAT"};
+    printf("%s: %llu MB, classe %u%s, AU de %lu KB\n", pSD->pcName,
+           (unsigned long long)(info.setores / 2048), pSD->speed_class, pSD->uhs_speed_grade ? " (UHS)" : "",
+           (unsigned long)(info.au_setores / 2));
+    printf("%s com clusters de %lu KB, dados a partir do setor %llu%s; %lld ms\n\n",
+           tipos[info.tipo < count_of(tipos) ? info.tipo : 0], (unsigned long)(info.cluster_bytes / 1024),
+           (unsigned long long)info.inicio_dados, info.au_setores > 1 ? " (início de AU)" : " (AU desconhecida)",
+           absolute_time_diff_us(inicio, get_absolute_time()) / 1000);
 }
 
-// Função para ler o conteúdo de um arquivo e exibir no terminal
-void read_file(const char *filename)
+// Calibra, filtra e enfileira uma rodada de leituras para o laço principal. O canal 0
+// segue o caminho de um sensor só. Roda no temporizador ou na IRQ de fim do DMA
+static void processar_rodada(int16_t accel[][3], int16_t gyro[][3], uint32_t lidos, uint64_t instante_us)
 {
-    FRESULT res = f_open(&file, filename, FA_READ);
-    if (res != FR_OK)
+#if IMU_SENSORES == 1
+    if (!lidos)
     {
-        printf("[ERRO] Não foi possível abrir o arquivo para leitura. Verifique se o Cartão está montado ou se o arquivo existe.\n");
-        handle_error(ERROR, 1000);
+        amostras_perdidas++;
         return;
     }
-
-    char buffer[128];
-    UINT br;
-    printf("Conteúdo do arquivo %s:\n", filename);
-    while (f_read(&file, buffer, sizeof(buffer) - 1, &br) == FR_OK && br > 0)
+#endif
+    amostra_t a;
+    a.tempo_ms = (uint32_t)((instante_us - to_us_since_boot(inicio_gravacao)) / 1000);
+    a.canal = 0;
+    memcpy(a.accel, accel[0], sizeof(a.accel));
+    memcpy(a.gyro, gyro[0], sizeof(a.gyro));
+    calibracao_aplicar(&calibracao, a.accel, a.gyro);
+
+#if ESPECTRO_ATIVO
+    // O espectro usa todas as leituras; a gravação normal só as do seu intervalo
+    espectro_adicionar(&espectro, a.accel[ESPECTRO_EIXO], a.tempo_ms);
+    if (++espectro_subamostra < (uint32_t)intervalo_log * 1000 / FATOR_DECIMACAO / ESPECTRO_PERIODO_US)
     {
-        buffer[br] = '\0';
-        printf("%s", buffer);
+        return;
     }
-    f_close(&file);
-    printf("\nLeitura do arquivo %s concluída.\n\n", filename);
-}
-
-void gpio_irq_handler(uint gpio, uint32_t events)
-{
-    static absolute_time_t last_time_A;
-    static absolute_time_t last_time_B;
-    static absolute_time_t last_time_joy;
+    espectro_subamostra = 0;
+#endif
 
-    absolute_time_t now = get_absolute_time();
-    if (gpio == btn_A_pin)
+    // Só segue para a fila uma amostra filtrada a cada FATOR_DECIMACAO leituras
+    amostra_t saida;
+    if (!decimador_processar(&decimador, &a, &saida))
     {
-        if (absolute_time_diff_us(last_time_A, now) > 200000)
-        {   
-            last_time_A = now;
-            gravacao_req = true;
-        }
+        return;
     }
-    else if (gpio == btn_B_pin)
+#if IMU_SENSORES > 1
+    // A rodada entra inteira ou é descartada inteira, para os canais ficarem juntos
+    if (fila_tamanho(&fila) + IMU_SENSORES > count_of(fila_buf))
     {
-        if (absolute_time_diff_us(last_time_B, now) > 200000)
-        {   
-            last_time_B = now;
-            exit_req = true;
-        }
+        amostras_perdidas += IMU_SENSORES;
+        return;
     }
-    else if (gpio == btn_joy_pin)
+    for (uint8_t c = 0; c < IMU_SENSORES; c++)
     {
-        if (absolute_time_diff_us(last_time_joy, now) > 200000)
-        {   
-            last_time_joy = now;
-            leitura_req = true;
+        if (!(lidos & (1u << c)))
+        {
+            continue; // Sensor sem resposta nesta rodada
+        }
+        if (c > 0)
+        {
+            saida.canal = c;
+            memcpy(saida.accel, accel[c], sizeof(saida.accel));
+            memcpy(saida.gyro, gyro[c], sizeof(saida.gyro));
         }
+        fila_push(&fila, &saida);
+    }
+#else
+    if (!fila_push(&fila, &saida))
+    {
+        amostras_perdidas++;
     }
+#endif
 }
 
-static void processar_botoes()
+// Temporizador de amostragem: lê os sensores (ou dispara a leitura por DMA)
+bool amostragem_callback(struct repeating_timer *t)
 {
-    if (gravacao_req)
-    {   
-        gravacao_req = false;
-        if (estado_atual == READY)
-        {
-            FRESULT res = f_open(&file, filename, FA_WRITE | FA_CREATE_ALWAYS);
-            if (res != FR_OK)
-            {   
-                printf("[ERRO] Não foi possível criar/abrir arquivo para iniciar a gravação\n");
-                handle_error(ERROR, 1000);
-                return;
-            }
-
-            UINT bw;
-            res = f_write(&file, cabecalho, strlen(cabecalho), &bw);
-            if (res != FR_OK)
-            {   
-                printf("[ERRO] Não foi possível escrever o cabeçalho no arquivo para iniciar a gravação\n");
-                f_close(&file);
-                handle_error(ERROR, 1000);
-                return;
-            }
-
-            curr_amostras = 0;
-            buzzer_num_beeps = 1;
-            buzzer_on = true;
-            buzzer_beep_callback(NULL); // Garante primeiro beep imediato
-            add_repeating_timer_ms(BUZZER_BEEP_MS, buzzer_beep_callback, NULL, &buzzer_timer);
-            estado_atual = CAPTURA;
-        }
-        else if (estado_atual == CAPTURA)
-        {   
-            buzzer_num_beeps = 2;
-            buzzer_on = true;
-            buzzer_beep_callback(NULL); // Garante primeiro beep imediato
-            add_repeating_timer_ms(BUZZER_BEEP_MS, buzzer_beep_callback, NULL, &buzzer_timer);
-            f_close(&file);
-            estado_atual = READY;
-        }
+    if (imu_recuperar)
+    {
+        imu_rodadas_puladas++; // Barramento em limpeza pelo laço principal
+        return true;
     }
+#if IMU_DMA
+    mpu6050_dma_disparar(&imu_dma);
+#else
+    int16_t accel[IMU_SENSORES][3] = {0}, gyro[IMU_SENSORES][3] = {0};
+    uint64_t instante_us;
+    uint32_t lidos = mpu6050_grupo_ler(&imus, accel, gyro, &instante_us);
+    processar_rodada(accel, gyro, lidos, instante_us);
+#endif
+    imu_recuperar = imu_barramentos_travados();
+    return true;
+}
 
-    if (leitura_req)
-    {   
-        leitura_req = false;
-        if (estado_atual == READY)
-        {   
-            // Atualiza periféricos e estado momentaneamente para indicar leitura
-            estado_atual = LEITURA_SD;
-            set_led_state();
-            display_upd();
-
-            read_file(filename);
-
-            // Retorna estado do programa ao anterior e atualiza buffer
-            estado_atual = READY;
-            estado_anterior = LEITURA_SD;
-        }
+#if IMU_DMA
+// IRQ de fim do DMA: a leitura já está no anel do leitor
+static void imu_dma_concluida()
+{
+    int16_t accel[1][3], gyro[1][3];
+    uint64_t instante_us;
+    while (mpu6050_dma_retirar(&imu_dma, accel[0], gyro[0], &instante_us))
+    {
+        processar_rodada(accel, gyro, 1u, instante_us);
     }
+}
+#endif
 
-    if (exit_req)
+#if LOG_ORIENTACAO
+// Laço do núcleo 1: aguarda o início da gravação pelo FIFO entre núcleos, lê o sensor a
+// cada FUSAO_PERIODO_US e atualiza a orientação. Ao terminar, confirma pelo FIFO
+static void nucleo1_fusao()
+{
+    const uint32_t leituras_por_registro = intervalo_log * 1000 / FUSAO_PERIODO_US;
+    while (true)
     {
-        exit_req = false;
-        if (estado_atual == READY)
-        {   
-            uint8_t falha = run_unmount();
-            if (!falha)
+        multicore_fifo_pop_blocking();
+        absolute_time_t proxima = get_absolute_time();
+        uint32_t leituras = 0;
+        while (fusao_ativa)
+        {
+            amostra_t a;
+            a.canal = 0;
+            if (!mpu6050_ler(&imus.sensor[0], a.accel, a.gyro))
             {
-                estado_atual = EXIT;
-                return;
+                // O núcleo 1 é o dono do sensor aqui e faz a recuperação ele mesmo
+                imus.falhas++;
+                if (++imus.seguidas[0] >= IMU_FALHAS_RECUPERAR)
+                {
+                    recuperar_imus(imu_barramentos_travados());
+                    proxima = get_absolute_time();
+                }
+                proxima = delayed_by_us(proxima, FUSAO_PERIODO_US);
+                sleep_until(proxima);
+                continue;
             }
-            printf("[ERRO] Falha no desmonte do cartão SD. Tente novamente\n");
-            handle_error(ERROR, 1000);
+            imus.seguidas[0] = 0;
+            calibracao_aplicar(&calibracao, a.accel, a.gyro);
+            fusao_atualizar(&fusao, a.accel, a.gyro);
+
+            if (++leituras >= leituras_por_registro)
+            {
+                leituras = 0;
+                a.tempo_ms = to_ms_since_boot(get_absolute_time()) - to_ms_since_boot(inicio_gravacao);
+                fusao_para_amostra(&fusao, &a);
+                if (!fila_push(&fila, &a))
+                {
+                    amostras_perdidas++;
+                }
+            }
+
+            // Próxima leitura em tempo absoluto, sem acumular atraso
+            proxima = delayed_by_us(proxima, FUSAO_PERIODO_US);
+            sleep_until(proxima);
         }
+        multicore_fifo_push_blocking(0);
     }
 }
+#endif
 
-static void set_led_state()
-{   
-    // Desliga quaisquer LEDs/Rotinas ativas
-    gpio_put(led_red_pin, 0);
-    gpio_put(led_blue_pin, 0);
-    gpio_put(led_green_pin, 0);
-    cancel_repeating_timer(&led_timer);
+static void start_capture()
+{
+#if !RAID_MODO
+    // O log foi recriado; uma tabela guardada da sessão anterior não vale mais
+    mapa_clusters_esquecer(&mapa_clusters, NULL);
+#endif
+    fila_init(&fila, fila_buf, count_of(fila_buf));
+    fila_init(&reserva, reserva_buf, count_of(reserva_buf));
+    fila_init(&diario, diario_buf, count_of(diario_buf));
+    gravacao_pausada = false;
+    diario_descartes = 0;
+    falhas_sd = 0;
+    falha_max_ms = 0;
+    falha_total_ms = 0;
+    reserva_pico = 0;
+    amostras_perdidas = 0;
+    sync_ultimo_tam = bytes_gravados();
+    sync_ultimo_ms = to_ms_since_boot(get_absolute_time());
+    sync_contagem = 0;
+    sync_total_us = 0;
+    sync_max_us = 0;
+    sync_auxiliares = false;
+    imus.desvio_max_us = 0;
+    imus.falhas = 0;
+    imu_recuperacoes = 0;
+    imu_rodadas_puladas = 0;
+#if IMU_DMA
+    imu_dma.perdidas = 0;
+#endif
+#if LOG_ORIENTACAO
+    fusao_init(&fusao, FUSAO_MODO, FUSAO_PERIODO_US, FUSAO_GANHO_MIL);
+    inicio_gravacao = get_absolute_time();
+    fusao_ativa = true;
+    multicore_fifo_push_blocking(1);
+#else
+    decimador_init(&decimador, FATOR_DECIMACAO);
+#if MODO_EVENTO
+    evento_init(&evento, evento_buf, EVENTO_CAPACIDADE, EVENTO_PRE_MS / EVENTO_INTERVALO_MS,
+                EVENTO_POS_MS / EVENTO_INTERVALO_MS, EVENTO_LIMIAR_ACCEL, EVENTO_LIMIAR_GYRO);
+#endif
+    inicio_gravacao = get_absolute_time();
+    // Intervalo negativo: período medido entre inícios de chamada, sem acumular atraso
+#if ESPECTRO_ATIVO
+    espectro_init(&espectro, espectro_buf, ESPECTRO_N, 1000000 / ESPECTRO_PERIODO_US);
+    espectro_subamostra = 0;
+    int64_t periodo_us = ESPECTRO_PERIODO_US;
+#else
+    int64_t periodo_us = (int64_t)intervalo_log * 1000 / FATOR_DECIMACAO;
+#endif
+    add_repeating_timer_us(-periodo_us, amostragem_callback, NULL, &amostragem_timer);
+#endif
+}
 
-    if (estado_atual == INICIALIZACAO) // Cor AMARELA estática
-    {   
-        gpio_put(led_red_pin, 1);
-        gpio_put(led_green_pin, 1);
+static void stop_capture()
+{
+#if LOG_ORIENTACAO
+    // Espera o núcleo 1 sair do laço para não haver escrita na fila depois daqui
+    fusao_ativa = false;
+    multicore_fifo_pop_blocking();
+#else
+    cancel_repeating_timer(&amostragem_timer);
+#endif
+    if (amostras_perdidas)
+    {
+        printf("[AVISO] %lu amostras descartadas por fila cheia\n", (unsigned long)amostras_perdidas);
     }
-    else if (estado_atual == READY) // Cor VERDE estática
+#if MODO_EVENTO
+    printf("Eventos detectados: %lu\n", (unsigned long)evento.disparos);
+#endif
+#if IMU_SENSORES > 1
+    printf("Sensores: desvio máximo de %lu us entre leituras de uma rodada, %lu leituras sem resposta\n",
+           (unsigned long)imus.desvio_max_us, (unsigned long)imus.falhas);
+#else
+    if (imus.falhas)
     {
-        gpio_put(led_green_pin, 1);
+        printf("[AVISO] %lu leituras do sensor sem resposta\n", (unsigned long)imus.falhas);
     }
-    else if (estado_atual == CAPTURA) // Cor VERMELHA estática
+#endif
+    if (imu_recuperacoes)
     {
-        gpio_put(led_red_pin, 1);
+        printf("[AVISO] %lu reinícios de barramento, %lu rodadas de amostragem puladas durante eles\n",
+               (unsigned long)imu_recuperacoes, (unsigned long)imu_rodadas_puladas);
     }
-    else if (estado_atual == LEITURA_SD || estado_atual == ERROR || estado_atual == SD_NOT_FOUND) // Cor piscando de acordo ao estado
+#if IMU_DMA
+    if (imu_dma.perdidas)
     {
-        led_on = true;
-        led_blink_state = estado_atual;
-
-        // Garante uma primeira chamada imediata para que inicie ligado
-        led_blink_callback(NULL);
+        printf("[AVISO] %lu leituras por DMA sem resposta ou sem espaço no anel\n", (unsigned long)imu_dma.perdidas);
+    }
+#endif
+#if ESPECTRO_ATIVO
+    if (espectro.janelas_perdidas)
+    {
+        printf("[AVISO] %lu janelas do espectro descartadas\n", (unsigned long)espectro.janelas_perdidas);
+    }
+#endif
 
-        add_repeating_timer_ms(LED_BLINK_MS, led_blink_callback, NULL, &led_timer);
+    if (falhas_sd)
+    {
+        printf("[AVISO] %lu falhas do cartão: pior recuperação %lu ms, %lu ms no total; reserva chegou a %lu de %d "
+               "amostras\n",
+               (unsigned long)falhas_sd, (unsigned long)falha_max_ms, (unsigned long)falha_total_ms,
+               (unsigned long)reserva_pico, RESERVA_AMOSTRAS);
     }
-    else // Nenhum LED aceso para a saída do programa (EXIT)
+    if (diario_descartes)
     {
-        return;
+        printf("[AVISO] %lu amostras gravadas sem cópia no diário\n", (unsigned long)diario_descartes);
     }
-}
 
-static char *get_state_name(Sistema estado)
-{
-    switch (estado)
+    // Custo da política de sync: fração do tempo de gravação gasta em f_sync
+    uint32_t duracao_ms = to_ms_since_boot(get_absolute_time()) - to_ms_since_boot(inicio_gravacao);
+    if (sync_contagem && duracao_ms)
     {
-        case INICIALIZACAO:
-            return "INICIALIZANDO";
-        case READY:
-            return "READY";
-        case CAPTURA:
-            return "GRAVACAO";
-        case SD_NOT_FOUND:
-            return "SD_NOT_FOUND";
-        case LEITURA_SD:
-            return "LEITURA";
-        case EXIT:
-            return "SAINDO";
+        uint32_t centesimos = (uint32_t)(sync_total_us * 10 / duracao_ms);
+        printf("Sync: %lu chamadas, média %lu us, máx %lu us, %lu.%02lu%% do tempo, %lu bytes/s gravados\n",
+               (unsigned long)sync_contagem, (unsigned long)(sync_total_us / sync_contagem), (unsigned long)sync_max_us,
+               (unsigned long)(centesimos / 100), (unsigned long)(centesimos % 100),
+               (unsigned long)((uint64_t)bytes_gravados() * 1000 / duracao_ms));
     }
 }
 
-static void display_upd()
+// Bytes entregues ao arquivo principal (ou aos cartões do RAID) nesta gravação
+static FSIZE_t bytes_gravados()
 {
-    // Limpa o display
-    ssd1306_fill(&ssd, false);
+#if RAID_MODO
+    return (FSIZE_t)raid_size(&raid) * FF_MAX_SS;
+#else
+    return f_tell(&file);
+#endif
+}
 
-    if (estado_atual != ERROR)
-    {   
-        // Define estado do cartão SD em string
+// No RAID, grava o que ainda está em RAM e ajusta o tamanho dos arquivos nos dois cartões
+static FRESULT close_main_file()
+{
+#if RAID_MODO
+    return raid_close(&raid);
+#else
+    return f_close(&file);
+#endif
+}
+
+// Confirma no cartão os dados gravados (tamanho do arquivo, FAT e cache de setores) quando a
+// janela configurada se esgota. Roda no laço principal: a amostragem continua no temporizador
+// e a fila absorve a latência do sync
+static bool sync_if_due()
+{
+    FSIZE_t tam = bytes_gravados();
+    bool pendente = tam != sync_ultimo_tam || sync_auxiliares;
+#if FORMATO_BINARIO
+    pendente = pendente || compressor.n;
+#endif
+    if (!pendente)
+    {
+        return true;
+    }
+    uint32_t agora = to_ms_since_boot(get_absolute_time());
+    bool por_bytes = SYNC_BYTES && tam - sync_ultimo_tam >= SYNC_BYTES;
+    bool por_tempo = SYNC_MS && agora - sync_ultimo_ms >= SYNC_MS;
+#if RAID_MODO
+    bool por_diario = false;
+#else
+    bool por_diario = fila_tamanho(&diario) >= DIARIO_AMOSTRAS / 4 * 3;
+#endif
+    if (!por_bytes && !por_tempo && !por_diario)
+    {
+        return true;
+    }
+
+#if FORMATO_BINARIO
+    // Com taxas baixas um bloco leva mais que SYNC_MS para encher: ele vai ao cartão como está
+    // (n e tam no cabeçalho dizem o quanto vale) e a próxima amostra abre outro
+    if (!save_pending())
+    {
+        return false;
+    }
+    tam = bytes_gravados();
+#endif
+
+    uint64_t inicio = time_us_64();
+#if RAID_MODO
+    // As linhas do RAID vão direto aos setores; só os arquivos auxiliares passam pelo FatFs
+    FRESULT res = FR_OK;
+#else
+    FRESULT res = f_sync(&file);
+#endif
+#if ESPECTRO_ATIVO
+    if (res == FR_OK)
+    {
+        res = f_sync(&arquivo_espectro);
+    }
+#endif
+#if RESUMO_ATIVO && RESUMO_GRAVA_BRUTO
+    if (res == FR_OK)
+    {
+        res = f_sync(&arquivo_resumo);
+    }
+#endif
+#if INDICE_GRAVA
+    // Depois do log: o índice confirmado nunca aponta além do que o log tem confirmado
+    if (res == FR_OK)
+    {
+        res = indice_sync(&indice);
+    }
+#endif
+    uint32_t latencia = (uint32_t)(time_us_64() - inicio);
+
+    sync_contagem++;
+    sync_total_us += latencia;
+    if (latencia > sync_max_us)
+    {
+        sync_max_us = latencia;
+    }
+    if (res != FR_OK)
+    {
+        return false;
+    }
+    sync_ultimo_tam = tam;
+    sync_ultimo_ms = agora;
+    sync_auxiliares = false;
+#if !RAID_MODO
+    // O que já está no cartão sai do diário
+    amostra_t a;
+    while (fila_pop(&diario, &a))
+    {
+    }
+#endif
+    return true;
+}
+
+#if ESPECTRO_ATIVO
+// Avança uma etapa da FFT pendente e grava uma linha quando a janela termina
+static bool save_spectrum()
+{
+    espectro_resultado_t r;
+    if (!espectro_processar(&espectro, &r))
+    {
+        return true;
+    }
+    char buffer[160];
+    int len = sprintf(buffer, "%lu,%lu.%02lu", (unsigned long)r.tempo_ms, (unsigned long)(r.freq_dominante_ch / 100),
+                      (unsigned long)(r.freq_dominante_ch % 100));
+    for (int b = 0; b < ESPECTRO_BANDAS; b++)
+    {
+        len += sprintf(buffer + len, ",%lu", (unsigned long)r.banda[b]);
+    }
+    buffer[len++] = '\n';
+    UINT bw;
+    sync_auxiliares = true;
+    return f_write(&arquivo_espectro, buffer, len, &bw) == FR_OK && bw == (UINT)len;
+}
+#endif
+
+#if RESUMO_ATIVO
+static bool write_summary_header(FIL *f)
+{
+    char linha[128];
+    UINT bw;
+    if (f_write(f, "time_ms,n", 9, &bw) != FR_OK)
+    {
+        return false;
+    }
+    for (int i = 0; i < RESUMO_EIXOS; i++)
+    {
+        int len = sprintf(linha, ",%s_media,%s_min,%s_max,%s_desvio,%s_rms,%s_pico,%s_crista", resumo_eixos[i],
+                          resumo_eixos[i], resumo_eixos[i], resumo_eixos[i], resumo_eixos[i], resumo_eixos[i],
+                          resumo_eixos[i]);
+        if (f_write(f, linha, len, &bw) != FR_OK)
+        {
+            return false;
+        }
+    }
+    return f_write(f, "\n", 1, &bw) == FR_OK;
+}
+
+// Grava um registro de resumo; os valores em Q8 só viram float na formatação
+static bool save_summary(const resumo_registro_t *r)
+{
+#if RESUMO_GRAVA_BRUTO
+    FIL *destino = &arquivo_resumo;
+    sync_auxiliares = true;
+#else
+    FIL *destino = &file;
+#endif
+    char buffer[512];
+    int len = sprintf(buffer, "%lu,%lu", (unsigned long)r->tempo_ms, (unsigned long)r->n);
+    for (int i = 0; i < RESUMO_EIXOS; i++)
+    {
+        const resumo_eixo_t *e = &r->eixo[i];
+        // accel: 16384 LSB/g; giro: 131 LSB/(°/s)
+        float escala = i < 3 ? 1.0f / 16384.0f : 1.0f / 131.0f;
+        len += sprintf(buffer + len, ",%.4f,%.4f,%.4f,%.4f,%.4f,%.4f,%.2f", e->media / 256.0f * escala,
+                       e->min * escala, e->max * escala, e->desvio / 256.0f * escala, e->rms / 256.0f * escala,
+                       e->pico / 256.0f * escala, e->crista / 256.0f);
+    }
+    buffer[len++] = '\n';
+    UINT bw;
+    if (f_write(destino, buffer, len, &bw) != FR_OK || bw != (UINT)len)
+    {
+        return false;
+    }
+#if !RESUMO_GRAVA_BRUTO
+    curr_amostras++; // Só depois da escrita: um registro regravado na retomada não conta duas vezes
+#endif
+    return true;
+}
+#endif
+
+// Toda amostra entregue ao arquivo principal passa pelo diário antes da escrita, inclusive a
+// que falhar, para ser regravada depois da remontagem
+static void registrar_no_diario(const amostra_t *a)
+{
+    curr_amostras++;
+#if !RAID_MODO
+    if (fila_tamanho(&diario) == DIARIO_AMOSTRAS)
+    {
+        amostra_t antiga;
+        fila_pop(&diario, &antiga);
+        diario_descartes++;
+    }
+    fila_push(&diario, a);
+#endif
+}
+
+#if INDICE_GRAVA
+// Registra no índice o registro (linha ou bloco) da amostra que acabou de entrar no diário
+static bool indexar(FSIZE_t offset, const amostra_t *a)
+{
+    return indice_registrar(&indice, offset, a->tempo_ms, curr_amostras - 1) == FR_OK;
+}
+#endif
+
+#if FORMATO_BINARIO
+static bool write_block(const uint8_t *bloco)
+{
+#if RAID_MODO
+    return raid_write(&raid, bloco) == SD_BLOCK_DEVICE_ERROR_NONE;
+#else
+    UINT bw;
+    return f_write(&file, bloco, BLOCO_TAM, &bw) == FR_OK && bw == BLOCO_TAM;
+#endif
+}
+
+// Comprime a amostra; um setor inteiro é gravado a cada bloco completo
+static bool save_sample(const amostra_t *a)
+{
+    registrar_no_diario(a);
+    const uint8_t *bloco = compressor_adicionar(&compressor, a);
+    if (bloco && !write_block(bloco))
+    {
+        return false;
+    }
+#if INDICE_GRAVA
+    // A amostra abriu um bloco, que vai ocupar a posição seq do arquivo
+    if (compressor.n == 1 && compressor.seq % INDICE_PASSO_BLOCOS == 0 &&
+        !indexar((FSIZE_t)compressor.seq * BLOCO_TAM, a))
+    {
+        return false;
+    }
+#endif
+    return true;
+}
+
+// Grava o bloco parcial, no sync ou ao encerrar a gravação
+static bool save_pending()
+{
+    const uint8_t *bloco = compressor_finalizar(&compressor);
+    if (!bloco)
+    {
+        return true;
+    }
+    return write_block(bloco);
+}
+#else
+static bool save_pending()
+{
+    return true;
+}
+
+// Escreve uma amostra no arquivo seguindo a formatação CSV
+static bool save_sample(const amostra_t *a)
+{
+#if LOG_ORIENTACAO
+    // Quaternion em Q14 (ver fusao_para_amostra); float só na formatação
+    char buffer[64];
+    sprintf(buffer, "%lu,%.4f,%.4f,%.4f,%.4f\n", (unsigned long)a->tempo_ms, a->accel[0] / 16384.0f,
+            a->accel[1] / 16384.0f, a->accel[2] / 16384.0f, a->gyro[0] / 16384.0f);
+    registrar_no_diario(a);
+#if INDICE_GRAVA
+    if ((curr_amostras - 1) % INDICE_PASSO == 0 && !indexar(f_tell(&file), a))
+    {
+        return false;
+    }
+#endif
+    UINT bw;
+    return f_write(&file, buffer, strlen(buffer), &bw) == FR_OK;
+#else
+    float accel_x, accel_y, accel_z;
+    float gyro_x, gyro_y, gyro_z;
+    mpu6050_converter(a->accel, a->gyro, &accel_x, &accel_y, &accel_z, &gyro_x, &gyro_y, &gyro_z);
+
+    char buffer[100];
+#if IMU_SENSORES > 1
+    sprintf(buffer, "%lu,%u,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", (unsigned long)a->tempo_ms, a->canal, accel_x, accel_y, accel_z,
+            gyro_x, gyro_y, gyro_z);
+#else
+    sprintf(buffer, "%lu,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", (unsigned long)a->tempo_ms, accel_x, accel_y, accel_z, gyro_x, gyro_y, gyro_z);
+#endif
+    registrar_no_diario(a);
+#if INDICE_GRAVA
+    // A linha começa na posição atual; o diário já a contou
+    if ((curr_amostras - 1) % INDICE_PASSO == 0 && !indexar(f_tell(&file), a))
+    {
+        return false;
+    }
+#endif
+    UINT bw;
+    return f_write(&file, buffer, strlen(buffer), &bw) == FR_OK;
+#endif
+}
+#endif
+
+#if !RAID_MODO
+// Pausa a gravação quando o cartão sai do soquete ou falha, e a retoma quando ele volta a
+// responder. O estado do cartão é mantido pela interrupção de detecção, então a consulta é só
+// uma leitura de memória. Enquanto pausada, as amostras passam da fila para a reserva em RAM
+static bool cartao_disponivel()
+{
+    sd_card_t *pSD = sd_get_by_num(0);
+    // STA_NOINIT cobre uma retirada e reinserção entre duas passagens do laço
+    bool ausente = pSD->m_Status & (STA_NODISK | STA_NOINIT);
+    if (!gravacao_pausada)
+    {
+        if (!ausente)
+        {
+            return true;
+        }
+        pausar_gravacao("Cartão removido durante a gravação");
+    }
+
+    amostra_t a;
+    while (fila_pop(&fila, &a))
+    {
+        if (!fila_push(&reserva, &a))
+        {
+            amostras_perdidas++;
+        }
+    }
+    if (fila_tamanho(&reserva) > reserva_pico)
+    {
+        reserva_pico = fila_tamanho(&reserva);
+    }
+
+    uint32_t agora = to_ms_since_boot(get_absolute_time());
+    if (pSD->m_Status & STA_NODISK)
+    {
+        // Fora do soquete não há tentativa; a contagem recomeça quando ele voltar
+        cartao_estavel_ms = agora;
+        cartao_espera_ms = CARTAO_ESTAVEL_MS;
+        return false;
+    }
+    if (agora - cartao_estavel_ms < cartao_espera_ms)
+    {
+        return false;
+    }
+    falha_tentativas++;
+    if (!retomar_gravacao())
+    {
+        // A próxima tentativa reinicia o cartão de novo
+        pSD->mounted = false;
+        pSD->m_Status |= STA_NOINIT;
+        cartao_estavel_ms = agora;
+        cartao_espera_ms = MIN(cartao_espera_ms * 2, CARTAO_ESPERA_MAX_MS);
+        return false;
+    }
+
+    uint32_t duracao = to_ms_since_boot(get_absolute_time()) - falha_inicio_ms;
+    falha_total_ms += duracao;
+    if (duracao > falha_max_ms)
+    {
+        falha_max_ms = duracao;
+    }
+    printf("Gravação retomada após %lu ms e %lu tentativas; %lu amostras retidas (reserva de %d)\n",
+           (unsigned long)duracao, (unsigned long)falha_tentativas, (unsigned long)fila_tamanho(&reserva),
+           RESERVA_AMOSTRAS);
+    return true;
+}
+
+// Os FIL abertos deixam de ser usados: o que o FatFs e o cache ainda não tinham gravado se
+// perde com o cartão, e a sessão continua do último sync quando o volume for remontado.
+// STA_NOINIT obriga a remontagem a reiniciar o cartão (sd_init) antes de montar
+static void pausar_gravacao(const char *motivo)
+{
+    sd_card_t *pSD = sd_get_by_num(0);
+    gravacao_pausada = true;
+    pSD->mounted = false;
+    pSD->m_Status |= STA_NOINIT;
+    // Os contadores voltam ao que está confirmado; o diário é regravado na retomada
+    curr_amostras -= fila_tamanho(&diario);
+#if INDICE_GRAVA
+    indice_descartar(&indice);
+#endif
+    falha_inicio_ms = to_ms_since_boot(get_absolute_time());
+    cartao_estavel_ms = falha_inicio_ms;
+    cartao_espera_ms = CARTAO_ESTAVEL_MS;
+    falha_tentativas = 0;
+    falhas_sd++;
+    printf("[AVISO] %s; retendo até %d amostras na RAM\n", motivo, RESERVA_AMOSTRAS);
+}
+
+// Remonta o volume e reabre os arquivos da sessão para acrescentar ao que já estava confirmado
+static bool retomar_gravacao()
+{
+    sd_card_t *pSD = sd_get_by_num(0);
+    FRESULT res = f_mount(&pSD->fatfs, pSD->pcName, 1);
+    if (res != FR_OK)
+    {
+        printf("[AVISO] Montagem do cartão falhou: %s; nova tentativa em %lu ms\n", FRESULT_str(res),
+               (unsigned long)MIN(cartao_espera_ms * 2, CARTAO_ESPERA_MAX_MS));
+        return false;
+    }
+    pSD->mounted = true;
+
+#if FORMATO_BINARIO
+    // O diretório ainda registra o tamanho da pré-alocação; a busca da recuperação encontra o
+    // último bloco válido, corta o arquivo ali e encerra o marcador da sessão
+    recuperacao_t r;
+    res = recuperacao_executar(&r, "");
+    if (res != FR_OK && res != FR_NO_FILE)
+    {
+        printf("[AVISO] Não foi possível localizar o fim da sessão: %s\n", FRESULT_str(res));
+        return false;
+    }
+#endif
+    res = f_open(&file, filename, FA_WRITE | FA_OPEN_APPEND);
+    if (res == FR_OK && f_size(&file) > sync_ultimo_tam)
+    {
+        // Escritas depois do último sync podem ter chegado ao cartão só em parte; o diário as refaz
+        res = f_lseek(&file, sync_ultimo_tam);
+        if (res == FR_OK)
+        {
+            res = f_truncate(&file);
+        }
+    }
+#if FORMATO_BINARIO
+    // A recuperação acima removeu o marcador e a pré-alocação; sem eles uma queda de energia
+    // depois da retomada deixaria o arquivo sem recuperação
+    if (res == FR_OK)
+    {
+        FRESULT rr = recuperacao_retomar(&file, filename, compressor.sessao, (FSIZE_t)PREALOCACAO_MB << 20);
+        if (rr != FR_OK)
+        {
+            printf("[AVISO] Sem pré-alocação após a retomada (%s); a sessão não poderá ser recuperada após "
+                   "queda de energia\n",
+                   FRESULT_str(rr));
+        }
+    }
+#elif RESUMO_ATIVO && !RESUMO_GRAVA_BRUTO
+    if (res == FR_OK && f_size(&file) == 0 && !write_summary_header(&file))
+    {
+        res = FR_DISK_ERR;
+    }
+#else
+    // Outro cartão: o arquivo é novo e recebe o cabeçalho
+    if (res == FR_OK && f_size(&file) == 0)
+    {
+        UINT bw;
+        res = f_write(&file, cabecalho, strlen(cabecalho), &bw);
+    }
+#endif
+#if INDICE_GRAVA
+    if (res == FR_OK)
+    {
+        res = indice_reabrir(&indice, indice_arquivo);
+    }
+#endif
+#if ESPECTRO_ATIVO
+    if (res == FR_OK)
+    {
+        res = f_open(&arquivo_espectro, arquivo_espectro_nome, FA_WRITE | FA_OPEN_APPEND);
+    }
+#endif
+#if RESUMO_ATIVO && RESUMO_GRAVA_BRUTO
+    if (res == FR_OK)
+    {
+        res = f_open(&arquivo_resumo, arquivo_resumo_nome, FA_WRITE | FA_OPEN_APPEND);
+    }
+#endif
+    if (res != FR_OK)
+    {
+        printf("[AVISO] Não foi possível reabrir os arquivos da gravação: %s\n", FRESULT_str(res));
+        return false;
+    }
+
+    sync_ultimo_tam = f_tell(&file);
+    sync_ultimo_ms = to_ms_since_boot(get_absolute_time());
+    if (!repetir_diario())
+    {
+        printf("[AVISO] Falha ao regravar as amostras posteriores ao último sync\n");
+        return false;
+    }
+#if RESUMO_ATIVO
+    if (resumo_tem_pendente)
+    {
+        if (!save_summary(&resumo_pendente))
+        {
+            printf("[AVISO] Falha ao regravar o registro de resumo pendente\n");
+            return false;
+        }
+        resumo_tem_pendente = false;
+    }
+#endif
+    gravacao_pausada = false;
+    return true;
+}
+
+// Regrava, na ordem, as amostras entregues desde o último sync. Se uma escrita falhar, as
+// restantes voltam ao diário atrás das já regravadas, e a ordem se mantém para a próxima vez
+static bool repetir_diario()
+{
+#if FORMATO_BINARIO
+    // O bloco parcial é refeito desde o início; a sequência segue o índice no arquivo, como a
+    // recuperação exige
+    compressor_init(&compressor, compressor.sessao, IMU_SENSORES);
+    compressor.seq = (uint32_t)(f_tell(&file) / BLOCO_TAM);
+#endif
+    bool ok = true;
+    uint32_t n = fila_tamanho(&diario);
+    amostra_t a;
+    for (uint32_t i = 0; i < n && fila_pop(&diario, &a); i++)
+    {
+        if (ok)
+        {
+            ok = save_sample(&a);
+        }
+        else
+        {
+            registrar_no_diario(&a);
+        }
+    }
+    if (!ok)
+    {
+        curr_amostras -= fila_tamanho(&diario);
+    }
+    return ok;
+}
+#endif
+
+// Encaminha uma amostra ao resumo, ao detector de eventos ou direto ao arquivo
+static bool gravar_amostra(const amostra_t *a)
+{
+    bool ok = true;
+#if RESUMO_ATIVO
+    resumo_registro_t r;
+    if (resumo_adicionar(&resumo, a, &r) && !save_summary(&r))
+    {
+        // A janela já foi fechada; o registro fica guardado para a retomada
+        resumo_pendente = r;
+        resumo_tem_pendente = true;
+        ok = false;
+    }
+#endif
+#if RESUMO_ATIVO && !RESUMO_GRAVA_BRUTO
+    // Somente o resumo é gravado
+#elif MODO_EVENTO
+    ok = ok && evento_processar(&evento, a, save_sample);
+#else
+    // Mesmo com o resumo falhando, a amostra passa pelo diário
+    ok = save_sample(a) && ok;
+#endif
+    return ok;
+}
+
+// Função para descarregar as amostras enfileiradas e salvar no arquivo CSV
+void capture_mpu_data_and_save()
+{   
+    uint anteriores = curr_amostras;
+#if !RAID_MODO
+    if (!cartao_disponivel())
+    {
+        return;
+    }
+#endif
+    amostra_t a;
+    // A reserva tem as amostras mais antigas e é esvaziada antes da fila
+    while (fila_pop(&reserva, &a) || fila_pop(&fila, &a))
+    {
+        if (!gravar_amostra(&a))
+        {
+#if !RAID_MODO
+            // A amostra em curso já está no diário, e um registro de resumo que falhou fica pendente
+            pausar_gravacao(sd_get_by_num(0)->m_Status & STA_NODISK ? "Cartão removido durante a escrita"
+                                                                    : "Falha de escrita no cartão");
+#else
+            printf("[ERRO] Não foi possível escrever no arquivo. Monte o Cartao.\n");
+            stop_capture();
+            close_main_file();
+#if RESUMO_ATIVO && RESUMO_GRAVA_BRUTO
+            f_close(&arquivo_resumo);
+#endif
+#if ESPECTRO_ATIVO
+            f_close(&arquivo_espectro);
+#endif
+            handle_error(ERROR, 1000);
+            estado_atual = READY; // Parar gravação após erro
+#endif
+            return;
+        }
+    }
+#if RAID_MODO == 2
+    // Um cartão que estava ocupado alcança o outro entre as amostras
+    raid_task(&raid);
+#endif
+#if ESPECTRO_ATIVO
+    if (!save_spectrum())
+    {
+        printf("[ERRO] Não foi possível escrever no arquivo do espectro\n");
+    }
+#endif
+    if (!sync_if_due())
+    {
+#if RAID_MODO
+        printf("[ERRO] Falha no f_sync; dados desde o último sync podem se perder\n");
+#else
+        pausar_gravacao("Falha no f_sync");
+        return;
+#endif
+    }
+    if (curr_amostras == anteriores)
+    {
+        return;
+    }
+
+    // Faz um FLASH AZUL rápido para indicar gravação
+    gpio_put(led_red_pin, 0);
+    gpio_put(led_blue_pin, 1);
+    sleep_ms(20);
+    gpio_put(led_blue_pin, 0);
+    gpio_put(led_red_pin, 1); // Reacende VERMELHO referente ao estado de CAPTURA
+}
+
+// Mede os offsets com o sensor parado e grava na flash; mantém os anteriores se falhar
+static void run_calibration()
+{
+    calibracao_t nova;
+    if (!calibracao_medir(&nova, ler_sensor_principal, CALIBRACAO_AMOSTRAS, CALIBRACAO_INTERVALO_US))
+    {
+        printf("[ERRO] Calibração falhou: sensor em movimento, fora de nível ou sem resposta\n");
+        handle_error(ERROR, 1000);
+        return;
+    }
+    calibracao = nova;
+    printf("Offsets accel: %d %d %d | giro: %d %d %d\n", nova.accel[0], nova.accel[1], nova.accel[2],
+           nova.gyro[0], nova.gyro[1], nova.gyro[2]);
+
+#if LOG_ORIENTACAO
+    // O núcleo 1 executa da flash; fora da gravação ele está parado no FIFO e pode ser
+    // reiniciado com segurança enquanto a flash é apagada
+    if (nucleo1_iniciado)
+    {
+        multicore_reset_core1();
+    }
+#endif
+    bool gravado = calibracao_salvar(&nova);
+#if LOG_ORIENTACAO
+    if (nucleo1_iniciado)
+    {
+        multicore_launch_core1(nucleo1_fusao);
+    }
+#endif
+    if (!gravado)
+    {
+        printf("[ERRO] Não foi possível gravar a calibração na flash\n");
+    }
+}
+
+// Lê comandos do terminal USB sem bloquear; cada linha é um comando
+static void processar_comandos()
+{
+    int c;
+    while ((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT)
+    {
+        if (c != '\r' && c != '\n')
+        {
+            if (comando_len < sizeof(comando) - 1)
+            {
+                comando[comando_len++] = (char)c;
+            }
+            continue;
+        }
+        if (comando_len == 0)
+        {
+            continue;
+        }
+        comando[comando_len] = '\0';
+        comando_len = 0;
+        // A confirmação de "formatar" tem de ser o comando seguinte
+        int pendente = formatar_pendente;
+        formatar_pendente = -1;
+
+        if (strcmp(comando, "cal") == 0)
+        {
+            if (estado_atual != READY)
+            {
+                printf("[AVISO] Calibração disponível apenas com a gravação parada\n");
+                continue;
+            }
+            printf("Calibrando. Mantenha o sensor parado...\n");
+            run_calibration();
+        }
+        else if (strncmp(comando, "data ", 5) == 0)
+        {
+            // Acerta o RTC para que os arquivos da sessão tenham data real
+            int ano, mes, dia, hora, min, seg;
+            if (sscanf(comando + 5, "%d-%d-%d %d:%d:%d", &ano, &mes, &dia, &hora, &min, &seg) == 6 &&
+                time_set(ano, mes, dia, hora, min, seg))
+            {
+                printf("RTC ajustado para %04d-%02d-%02d %02d:%02d:%02d\n", ano, mes, dia, hora, min, seg);
+            }
+            else
+            {
+                printf("[ERRO] Data inválida. Use: data AAAA-MM-DD HH:MM:SS\n");
+            }
+        }
+        else if (strncmp(comando, "ver ", 4) == 0)
+        {
+            unsigned long de, ate;
+            if (estado_atual != READY)
+            {
+                printf("[AVISO] Leitura disponível apenas com a gravação parada\n");
+            }
+            else if (sscanf(comando + 4, "%lu %lu", &de, &ate) != 2 || de > ate)
+            {
+                printf("[ERRO] Intervalo inválido. Use: ver INICIO_MS FIM_MS\n");
+            }
+            else
+            {
+#if RAID_MODO
+                printf("[AVISO] Sem índice de tempo no RAID; use a leitura completa\n");
+#else
+                read_range(filename, de, ate);
+#endif
+            }
+        }
+        else if (strncmp(comando, "cauda ", 6) == 0)
+        {
+            unsigned long ms;
+            if (estado_atual != READY)
+            {
+                printf("[AVISO] Leitura disponível apenas com a gravação parada\n");
+            }
+            else if (sscanf(comando + 6, "%lu", &ms) != 1)
+            {
+                printf("[ERRO] Use: cauda MS\n");
+            }
+            else
+            {
+#if RAID_MODO
+                printf("[AVISO] Sem índice de tempo no RAID; use a leitura completa\n");
+#else
+                read_tail(filename, ms);
+#endif
+            }
+        }
+        else if (strncmp(comando, "formatar ", 9) == 0)
+        {
+            // Apaga o cartão inteiro: só com "formatar N sim" logo depois de "formatar N"
+            unsigned n;
+            char confirmacao[4] = "";
+            int campos = sscanf(comando + 9, "%u %3s", &n, confirmacao);
+            if (estado_atual != READY)
+            {
+                printf("[AVISO] Formatação disponível apenas com a gravação parada\n");
+            }
+            else if (campos < 1 || n >= sd_get_num())
+            {
+                printf("[ERRO] Use: formatar CARTAO (0 a %u)\n", (unsigned)sd_get_num() - 1);
+            }
+            else if (campos == 2 && strcmp(confirmacao, "sim") == 0 && pendente == (int)n)
+            {
+                format_card(n);
+            }
+            else
+            {
+                formatar_pendente = (int)n;
+                printf("[AVISO] Tudo no cartão %s será apagado. Para confirmar: formatar %u sim\n",
+                       sd_get_by_num(n)->pcName, n);
+            }
+        }
+        else if (strncmp(comando, "trecho ", 7) == 0)
+        {
+            unsigned long long offset;
+            unsigned long tam;
+            if (estado_atual != READY)
+            {
+                printf("[AVISO] Leitura disponível apenas com a gravação parada\n");
+            }
+            else if (sscanf(comando + 7, "%llu %lu", &offset, &tam) != 2 || tam == 0 || tam > TRECHO_MAX)
+            {
+                printf("[ERRO] Use: trecho OFFSET BYTES (até %d bytes)\n", TRECHO_MAX);
+            }
+            else
+            {
+#if RAID_MODO
+                printf("[AVISO] No RAID cada cartão tem só parte do log; use a leitura completa\n");
+#else
+                export_chunk(filename, offset, tam);
+#endif
+            }
+        }
+        else
+        {
+            printf("Comandos: cal (calibra o bias do sensor), data AAAA-MM-DD HH:MM:SS (acerta o relógio),\n"
+                   "          ver INICIO_MS FIM_MS (mostra as amostras do intervalo),\n"
+                   "          cauda MS (mostra os últimos MS milissegundos),\n"
+                   "          trecho OFFSET BYTES (envia parte do log em hexadecimal),\n"
+                   "          formatar CARTAO (apaga o cartão e o formata para gravação; pede confirmação)\n");
+        }
+    }
+}
+
+#if FORMATO_BINARIO
+// Restaura o tamanho de uma sessão que não foi fechada por queda de energia
+static void recover_session()
+{
+    // No RAID cada cartão tem o marcador do seu arquivo
+    for (size_t i = 0; i < sd_get_num(); i++)
+    {
+        recuperacao_t r;
+        absolute_time_t inicio = get_absolute_time();
+        FRESULT res = recuperacao_executar(&r, sd_get_by_num(i)->pcName);
+        if (res == FR_NO_FILE)
+        {
+            continue;
+        }
+        if (res != FR_OK)
+        {
+            printf("[ERRO] Recuperação da sessão em %s falhou: %s\n", sd_get_by_num(i)->pcName, FRESULT_str(res));
+            continue;
+        }
+        printf("Sessão %lu recuperada em %s: %lu blocos (%llu bytes), %lu leituras em %lld ms\n",
+               (unsigned long)r.sessao, r.arquivo, (unsigned long)r.blocos, (unsigned long long)r.tamanho,
+               (unsigned long)r.leituras, absolute_time_diff_us(inicio, get_absolute_time()) / 1000);
+    }
+}
+#endif
+
+#if FORMATO_BINARIO
+// Exibe uma amostra decodificada no mesmo formato do CSV
+static void print_sample(const amostra_t *a)
+{
+    float ax, ay, az, gx, gy, gz;
+    mpu6050_converter(a->accel, a->gyro, &ax, &ay, &az, &gx, &gy, &gz);
+#if IMU_SENSORES > 1
+    printf("%lu,%u,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", (unsigned long)a->tempo_ms, a->canal, ax, ay, az, gx, gy, gz);
+#else
+    printf("%lu,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", (unsigned long)a->tempo_ms, ax, ay, az, gx, gy, gz);
+#endif
+}
+#endif
+
+// Função para ler o conteúdo de um arquivo e exibir no terminal
+void read_file(const char *filename)
+{
+    FRESULT res = f_open(&file, filename, FA_READ);
+    if (res != FR_OK)
+    {
+        printf("[ERRO] Não foi possível abrir o arquivo para leitura. Verifique se o Cartão está montado ou se o arquivo existe.\n");
+        handle_error(ERROR, 1000);
+        return;
+    }
+
+    printf("Conteúdo do arquivo %s:\n", filename);
+#if FORMATO_BINARIO
+    // Decodifica os blocos e exibe no mesmo formato do CSV
+    static uint8_t bloco[BLOCO_TAM];
+    static amostra_t amostras[BLOCO_MAX_AMOSTRAS];
+    UINT br;
+#if RAID_MODO == 1
+    // As faixas se alternam entre os cartões; a leitura segue a mesma ordem
+    static FIL membro1;
+    char caminho[32];
+    snprintf(caminho, sizeof(caminho), "%s%s", sd_get_by_num(1)->pcName, filename);
+    if (f_open(&membro1, caminho, FA_READ) != FR_OK)
+    {
+        printf("[ERRO] Não foi possível abrir %s\n", caminho);
+        f_close(&file);
+        handle_error(ERROR, 1000);
+        return;
+    }
+    FIL *membros[RAID_MEMBERS] = {&file, &membro1};
+    uint32_t lidos = 0;
+#endif
+    printf("%s", cabecalho);
+    while (true)
+    {
+#if RAID_MODO == 1
+        FIL *origem = membros[lidos++ / RAID_FAIXA_SETORES % RAID_MEMBERS];
+#else
+        FIL *origem = &file;
+#endif
+        if (f_read(origem, bloco, BLOCO_TAM, &br) != FR_OK || br != BLOCO_TAM)
+        {
+            break;
+        }
+        if (!bloco_valido(bloco, bloco_sessao(bloco)))
+        {
+            printf("[AVISO] Bloco inválido, leitura interrompida\n");
+            break;
+        }
+        int n = bloco_decodificar(bloco, amostras, count_of(amostras));
+        for (int i = 0; i < n; i++)
+        {
+            print_sample(&amostras[i]);
+        }
+    }
+#if RAID_MODO == 1
+    f_close(&membro1);
+#endif
+#else
+    char buffer[128];
+    UINT br;
+    while (f_read(&file, buffer, sizeof(buffer) - 1, &br) == FR_OK && br > 0)
+    {
+        buffer[br] = '\0';
+        printf("%s", buffer);
+    }
+#endif
+    f_close(&file);
+    printf("\nLeitura do arquivo %s concluída.\n", filename);
+
+    // Eficiência do cache de setores de FAT/diretório
+    disk_cache_stats_t stats;
+    disk_cache_get_stats(&stats);
+    printf("Cache de leitura: %lu acertos, %lu falhas; %lu leituras do cache de escrita\n\n",
+           (unsigned long)stats.read_hits, (unsigned long)stats.read_misses, (unsigned long)stats.write_hits);
+}
+
+#if !RAID_MODO
+// Abre o log em `file` para leitura com a tabela de busca rápida da cache: um f_lseek para
+// qualquer ponto do arquivo sai da tabela em RAM, sem percorrer a cadeia de clusters na FAT
+static FRESULT open_for_reading(const char *filename, bool *com_tabela)
+{
+    FRESULT res = f_open(&file, filename, FA_READ);
+    if (res != FR_OK)
+    {
+        printf("[ERRO] Não foi possível abrir %s: %s\n", filename, FRESULT_str(res));
+        return res;
+    }
+    *com_tabela = mapa_clusters_usar(&mapa_clusters, &file);
+    return FR_OK;
+}
+
+// Exibe as amostras de [de_ms, ate_ms]. O índice dá a posição do último registro anterior a
+// de_ms, o f_lseek vai até ali pela tabela de busca rápida e a leitura para no primeiro
+// registro depois de ate_ms. Sem índice, lê desde o início
+static void read_range(const char *filename, uint32_t de_ms, uint32_t ate_ms)
+{
+    absolute_time_t inicio = get_absolute_time();
+    bool com_tabela;
+    FRESULT res = open_for_reading(filename, &com_tabela);
+    if (res != FR_OK)
+    {
+        return;
+    }
+
+    uint32_t mostradas = 0;
+    bool fim = false;
+    UINT br;
+    uint32_t sessao = 0;
+#if FORMATO_BINARIO
+    // A sessão do primeiro bloco identifica a gravação, para o índice e para os blocos
+    static uint8_t bloco[BLOCO_TAM];
+    static amostra_t amostras[BLOCO_MAX_AMOSTRAS];
+    if (f_read(&file, bloco, BLOCO_TAM, &br) == FR_OK && br == BLOCO_TAM)
+    {
+        sessao = bloco_sessao(bloco);
+    }
+    const uint32_t passo = INDICE_PASSO_BLOCOS;
+#else
+    const uint32_t passo = INDICE_PASSO;
+#endif
+
+    char nome[24];
+    indice_nome(filename, nome, sizeof(nome));
+    indice_entrada_t e;
+    uint32_t leituras;
+    if (indice_buscar(nome, FORMATO_BINARIO, passo, sessao, de_ms, f_size(&file), &e, &leituras) != FR_OK)
+    {
+        printf("[AVISO] %s não encontrado ou de outra gravação; lendo desde o início\n", nome);
+    }
+
+#if FORMATO_BINARIO
+    printf("%s", cabecalho);
+    res = f_lseek(&file, e.offset);
+    while (!fim && res == FR_OK && f_read(&file, bloco, BLOCO_TAM, &br) == FR_OK && br == BLOCO_TAM)
+    {
+        if (!bloco_valido(bloco, sessao))
+        {
+            break;
+        }
+        int n = bloco_decodificar(bloco, amostras, count_of(amostras));
+        for (int i = 0; i < n && !fim; i++)
+        {
+            fim = amostras[i].tempo_ms > ate_ms;
+            if (!fim && amostras[i].tempo_ms >= de_ms)
+            {
+                print_sample(&amostras[i]);
+                mostradas++;
+            }
+        }
+    }
+#else
+    // O cabeçalho vem do próprio arquivo; as linhas seguintes são lidas a partir do índice
+    char buffer[128];
+    char linha[128];
+    size_t len = 0;
+    bool cabecalho_lido = false;
+    while (!fim && f_read(&file, buffer, sizeof(buffer), &br) == FR_OK && br > 0)
+    {
+        for (UINT i = 0; i < br && !fim; i++)
+        {
+            if (buffer[i] != '\n')
+            {
+                if (len < sizeof(linha) - 1)
+                {
+                    linha[len++] = buffer[i];
+                }
+                continue;
+            }
+            linha[len] = '\0';
+            len = 0;
+            if (!cabecalho_lido)
+            {
+                printf("%s\n", linha);
+                cabecalho_lido = true;
+                if (f_tell(&file) - br + i + 1 < e.offset && f_lseek(&file, e.offset) == FR_OK)
+                {
+                    break; // Descarta o resto do buffer e continua na posição do índice
+                }
+                continue;
+            }
+            uint32_t t = strtoul(linha, NULL, 10);
+            fim = t > ate_ms;
+            if (!fim && t >= de_ms)
+            {
+                printf("%s\n", linha);
+                mostradas++;
+            }
+        }
+    }
+#endif
+    f_close(&file);
+    printf("%lu amostras de %lu a %lu ms; índice: %lu leituras, início no byte %llu; %lld ms\n",
+           (unsigned long)mostradas, (unsigned long)de_ms, (unsigned long)ate_ms, (unsigned long)leituras,
+           (unsigned long long)e.offset, absolute_time_diff_us(inicio, get_absolute_time()) / 1000);
+    printf("Busca rápida: %s (tabelas: %lu reaproveitadas, %lu construídas, %lu sem memória)\n\n",
+           com_tabela ? "sim" : "não, seguindo a FAT", (unsigned long)mapa_clusters.acertos,
+           (unsigned long)mapa_clusters.construcoes, (unsigned long)mapa_clusters.sem_memoria);
+}
+
+// Exibe os últimos `ms` milissegundos da gravação: o tempo final sai do último registro,
+// lido no fim do arquivo, e o resto é uma leitura por intervalo. A tabela de busca rápida
+// construída aqui é reaproveitada por read_range()
+static void read_tail(const char *filename, uint32_t ms)
+{
+    bool com_tabela;
+    if (open_for_reading(filename, &com_tabela) != FR_OK)
+    {
+        return;
+    }
+    FSIZE_t tam = f_size(&file);
+    bool achou = false;
+    uint32_t fim_ms = 0;
+    UINT br;
+#if FORMATO_BINARIO
+    static uint8_t bloco[BLOCO_TAM];
+    static amostra_t amostras[BLOCO_MAX_AMOSTRAS];
+    if (tam >= BLOCO_TAM && f_lseek(&file, (tam / BLOCO_TAM - 1) * BLOCO_TAM) == FR_OK &&
+        f_read(&file, bloco, BLOCO_TAM, &br) == FR_OK && br == BLOCO_TAM &&
+        bloco_valido(bloco, bloco_sessao(bloco)))
+    {
+        int n = bloco_decodificar(bloco, amostras, count_of(amostras));
+        achou = n > 0;
+        fim_ms = achou ? amostras[n - 1].tempo_ms : 0;
+    }
+#else
+    // Última linha completa nos bytes finais do arquivo
+    char buffer[129];
+    FSIZE_t pos = tam > sizeof(buffer) - 1 ? tam - (sizeof(buffer) - 1) : 0;
+    if (f_lseek(&file, pos) == FR_OK && f_read(&file, buffer, sizeof(buffer) - 1, &br) == FR_OK)
+    {
+        buffer[br] = '\0';
+        while (br > 0 && (buffer[br - 1] == '\n' || buffer[br - 1] == '\r'))
+        {
+            buffer[--br] = '\0';
+        }
+        char *linha = strrchr(buffer, '\n');
+        achou = linha && isdigit((unsigned char)linha[1]);
+        fim_ms = achou ? strtoul(linha + 1, NULL, 10) : 0;
+    }
+#endif
+    f_close(&file);
+    if (!achou)
+    {
+        printf("[AVISO] %s não tem amostras\n", filename);
+        return;
+    }
+    read_range(filename, fim_ms > ms ? fim_ms - ms : 0, fim_ms);
+}
+
+// Envia bytes [offset, offset + tam) do log em hexadecimal, 32 por linha precedidos do
+// offset, terminando em "fim BYTES". Com a tabela de busca rápida, cada pedido de um
+// programa que copia o log em trechos custa o mesmo no início ou no fim do arquivo
+static void export_chunk(const char *filename, FSIZE_t offset, uint32_t tam)
+{
+    bool com_tabela;
+    if (open_for_reading(filename, &com_tabela) != FR_OK)
+    {
+        return;
+    }
+    static uint8_t buffer[32];
+    uint32_t enviados = 0;
+    UINT br;
+    FRESULT res = f_lseek(&file, offset);
+    while (res == FR_OK && enviados < tam)
+    {
+        UINT n = tam - enviados < sizeof(buffer) ? tam - enviados : sizeof(buffer);
+        res = f_read(&file, buffer, n, &br);
+        if (res != FR_OK || br == 0)
+        {
+            break;
+        }
+        printf("%010llx ", (unsigned long long)(offset + enviados));
+        for (UINT i = 0; i < br; i++)
+        {
+            printf("%02x", buffer[i]);
+        }
+        printf("\n");
+        enviados += br;
+    }
+    if (res != FR_OK)
+    {
+        printf("[ERRO] Leitura de %s falhou: %s\n", filename, FRESULT_str(res));
+    }
+    printf("fim %lu de %llu\n", (unsigned long)enviados, (unsigned long long)f_size(&file));
+    f_close(&file);
+}
+#endif
+
+void gpio_irq_handler(uint gpio, uint32_t events)
+{
+    static absolute_time_t last_time_A;
+    static absolute_time_t last_time_B;
+    static absolute_time_t last_time_joy;
+
+    absolute_time_t now = get_absolute_time();
+    if (gpio == btn_A_pin)
+    {
+        if (absolute_time_diff_us(last_time_A, now) > 200000)
+        {   
+            last_time_A = now;
+            gravacao_req = true;
+        }
+    }
+    else if (gpio == btn_B_pin)
+    {
+        if (absolute_time_diff_us(last_time_B, now) > 200000)
+        {   
+            last_time_B = now;
+            exit_req = true;
+        }
+    }
+    else if (gpio == btn_joy_pin)
+    {
+        if (absolute_time_diff_us(last_time_joy, now) > 200000)
+        {   
+            last_time_joy = now;
+            leitura_req = true;
+        }
+    }
+}
+
+static void processar_botoes()
+{
+    if (gravacao_req)
+    {   
+        gravacao_req = false;
+        if (estado_atual == READY)
+        {
+#if FORMATO_BINARIO
+            // Uma gravação encerrada sem o cartão, ou um cartão descartado do espelho, deixa o
+            // marcador; se ficasse, apontaria a sessão antiga para o arquivo novo
+            recover_session();
+#endif
+#if RAID_MODO
+            FRESULT res = raid_open(&raid, filename, RAID_MODO == 1 ? RAID_STRIPE : RAID_MIRROR,
+                                    (FSIZE_t)PREALOCACAO_MB << 20, RAID_FAIXA_SETORES,
+                                    raid_buf, RAID_BUF_SETORES);
+#else
+            FRESULT res = f_open(&file, filename, FA_WRITE | FA_CREATE_ALWAYS);
+#endif
+            if (res != FR_OK)
+            {   
+                printf("[ERRO] Não foi possível criar/abrir arquivo para iniciar a gravação\n");
+                handle_error(ERROR, 1000);
+                return;
+            }
+
+#if FORMATO_BINARIO
+            // Identificador da sessão distingue blocos desta gravação de restos antigos no cartão
+            uint32_t sessao = time_us_32();
+            compressor_init(&compressor, sessao, IMU_SENSORES);
+#if RAID_MODO
+            // raid_open já pré-alocou os arquivos; cada cartão recebe o marcador do seu
+            for (size_t m = 0; m < RAID_MEMBERS; m++)
+            {
+                char caminho[32];
+                snprintf(caminho, sizeof(caminho), "%s%s", sd_get_by_num(m)->pcName, filename);
+                res = recuperacao_marcar(sd_get_by_num(m)->pcName, caminho, sessao, RAID_MODO == 1 ? RAID_MEMBERS : 1,
+                                         RAID_MODO == 1 ? m : 0, RAID_FAIXA_SETORES);
+                if (res != FR_OK)
+                {
+                    printf("[AVISO] Sem marcador em %s (%s); o cartão não poderá ser recuperado após queda de "
+                           "energia\n",
+                           sd_get_by_num(m)->pcName, FRESULT_str(res));
+                }
+            }
+#else
+            res = recuperacao_iniciar(&file, filename, sessao, (FSIZE_t)PREALOCACAO_MB << 20);
+            if (res != FR_OK)
+            {
+                printf("[AVISO] Sem pré-alocação (%s); a sessão não poderá ser recuperada após queda de energia\n",
+                       FRESULT_str(res));
+            }
+#endif
+#elif RESUMO_ATIVO && !RESUMO_GRAVA_BRUTO
+            res = write_summary_header(&file) ? FR_OK : FR_DISK_ERR;
+            if (res != FR_OK)
+            {
+                printf("[ERRO] Não foi possível escrever o cabeçalho no arquivo para iniciar a gravação\n");
+                f_close(&file);
+                handle_error(ERROR, 1000);
+                return;
+            }
+#else
+            UINT bw;
+            res = f_write(&file, cabecalho, strlen(cabecalho), &bw);
+            if (res != FR_OK)
+            {   
+                printf("[ERRO] Não foi possível escrever o cabeçalho no arquivo para iniciar a gravação\n");
+                f_close(&file);
+                handle_error(ERROR, 1000);
+                return;
+            }
+#endif
+
+#if ESPECTRO_ATIVO
+            // Potência de cada faixa em LSB^2; faixas iguais de 0 até metade da taxa
+            res = f_open(&arquivo_espectro, arquivo_espectro_nome, FA_WRITE | FA_CREATE_ALWAYS);
+            if (res == FR_OK)
+            {
+                char linha[120];
+                int len = sprintf(linha, "time_ms,freq_dominante_hz");
+                for (int b = 0; b < ESPECTRO_BANDAS; b++)
+                {
+                    len += sprintf(linha + len, ",banda_%d", b);
+                }
+                linha[len++] = '\n';
+                UINT bw_espectro;
+                res = f_write(&arquivo_espectro, linha, len, &bw_espectro);
+            }
+            if (res != FR_OK)
+            {
+                printf("[ERRO] Não foi possível criar o arquivo do espectro\n");
+                close_main_file();
+                handle_error(ERROR, 1000);
+                return;
+            }
+#endif
+
+#if RESUMO_ATIVO && RESUMO_GRAVA_BRUTO
+            res = f_open(&arquivo_resumo, arquivo_resumo_nome, FA_WRITE | FA_CREATE_ALWAYS);
+            if (res != FR_OK || !write_summary_header(&arquivo_resumo))
+            {
+                printf("[ERRO] Não foi possível criar o arquivo de resumo\n");
+                if (res == FR_OK)
+                {
+                    f_close(&arquivo_resumo);
+                }
+                close_main_file();
+                handle_error(ERROR, 1000);
+                return;
+            }
+#endif
+#if RESUMO_ATIVO
+            resumo_init(&resumo, RESUMO_JANELA_MS);
+            resumo_tem_pendente = false;
+#endif
+#if INDICE_GRAVA
+            indice_nome(filename, indice_arquivo, sizeof(indice_arquivo));
+#if FORMATO_BINARIO
+            res = indice_criar(&indice, indice_arquivo, 1, INDICE_PASSO_BLOCOS, compressor.sessao);
+#else
+            res = indice_criar(&indice, indice_arquivo, 0, INDICE_PASSO, 0);
+#endif
+            if (res != FR_OK)
+            {
+                printf("[AVISO] Sem índice de tempo (%s); a gravação segue sem ele\n", FRESULT_str(res));
+            }
+#endif
+
+            curr_amostras = 0;
+            start_capture();
+            buzzer_num_beeps = 1;
+            buzzer_on = true;
+            buzzer_beep_callback(NULL); // Garante primeiro beep imediato
+            add_repeating_timer_ms(BUZZER_BEEP_MS, buzzer_beep_callback, NULL, &buzzer_timer);
+            estado_atual = CAPTURA;
+        }
+        else if (estado_atual == CAPTURA)
+        {   
+            buzzer_num_beeps = 2;
+            buzzer_on = true;
+            buzzer_beep_callback(NULL); // Garante primeiro beep imediato
+            add_repeating_timer_ms(BUZZER_BEEP_MS, buzzer_beep_callback, NULL, &buzzer_timer);
+            stop_capture();
+            if (gravacao_pausada)
+            {
+                // Os FIL ainda apontam para o volume que falhou: nada é gravado nem fechado. O
+                // arquivo fica como no último sync e, no binário, o marcador deixado no cartão
+                // permite à recuperação cortá-lo no último bloco válido
+                printf("[AVISO] Gravação encerrada sem o cartão; %lu amostras retidas descartadas\n",
+                       (unsigned long)(fila_tamanho(&reserva) + fila_tamanho(&fila)));
+                estado_atual = READY;
+                return;
+            }
+            capture_mpu_data_and_save(); // Grava o que ainda estiver na fila
+            if (!save_pending())
+            {
+                printf("[ERRO] Não foi possível gravar o último bloco\n");
+            }
+#if RESUMO_ATIVO
+            resumo_registro_t r;
+            if (resumo_finalizar(&resumo, &r) && !save_summary(&r))
+            {
+                printf("[ERRO] Não foi possível gravar o último resumo\n");
+            }
+#if RESUMO_GRAVA_BRUTO
+            f_close(&arquivo_resumo);
+#endif
+#endif
+#if INDICE_GRAVA
+            if (indice_fechar(&indice) != FR_OK)
+            {
+                printf("[ERRO] Não foi possível fechar o índice de tempo\n");
+            }
+#endif
+#if FORMATO_BINARIO && !RAID_MODO
+            // Corta a pré-alocação não usada e marca a sessão como fechada
+            if (recuperacao_encerrar(&file) != FR_OK)
+            {
+                printf("[ERRO] Não foi possível ajustar o tamanho final do arquivo\n");
+            }
+#endif
+            if (close_main_file() != FR_OK)
+            {
+                printf("[ERRO] Não foi possível fechar o arquivo da gravação\n");
+            }
+#if RAID_MODO
+            else
+            {
+                // Um cartão descartado do espelho fica com a pré-alocação e o marcador, para a
+                // recuperação cortá-lo no último bloco válido
+                for (size_t m = 0; m < RAID_MEMBERS; m++)
+                {
+                    if (!raid.failed[m] && recuperacao_desmarcar(sd_get_by_num(m)->pcName) != FR_OK)
+                    {
+                        printf("[ERRO] Não foi possível remover o marcador da sessão em %s\n",
+                               sd_get_by_num(m)->pcName);
+                    }
+                }
+            }
+#endif
+#if ESPECTRO_ATIVO
+            f_close(&arquivo_espectro);
+#endif
+            estado_atual = READY;
+        }
+    }
+
+    if (leitura_req)
+    {   
+        leitura_req = false;
+        if (estado_atual == READY)
+        {   
+            // Atualiza periféricos e estado momentaneamente para indicar leitura
+            estado_atual = LEITURA_SD;
+            set_led_state();
+            display_upd();
+
+            read_file(filename);
+
+            // Retorna estado do programa ao anterior e atualiza buffer
+            estado_atual = READY;
+            estado_anterior = LEITURA_SD;
+        }
+    }
+
+    if (exit_req)
+    {
+        exit_req = false;
+        if (estado_atual == READY)
+        {   
+            uint8_t falha = run_unmount();
+            if (!falha)
+            {
+                estado_atual = EXIT;
+                return;
+            }
+            printf("[ERRO] Falha no desmonte do cartão SD. Tente novamente\n");
+            handle_error(ERROR, 1000);
+        }
+    }
+}
+
+static void set_led_state()
+{   
+    // Desliga quaisquer LEDs/Rotinas ativas
+    gpio_put(led_red_pin, 0);
+    gpio_put(led_blue_pin, 0);
+    gpio_put(led_green_pin, 0);
+    cancel_repeating_timer(&led_timer);
+
+    if (estado_atual == INICIALIZACAO) // Cor AMARELA estática
+    {   
+        gpio_put(led_red_pin, 1);
+        gpio_put(led_green_pin, 1);
+    }
+    else if (estado_atual == READY) // Cor VERDE estática
+    {
+        gpio_put(led_green_pin, 1);
+    }
+    else if (estado_atual == CAPTURA) // Cor VERMELHA estática
+    {
+        gpio_put(led_red_pin, 1);
+    }
+    else if (estado_atual == LEITURA_SD || estado_atual == ERROR || estado_atual == SD_NOT_FOUND) // Cor piscando de acordo ao estado
+    {
+        led_on = true;
+        led_blink_state = estado_atual;
+
+        // Garante uma primeira chamada imediata para que inicie ligado
+        led_blink_callback(NULL);
+
+        add_repeating_timer_ms(LED_BLINK_MS, led_blink_callback, NULL, &led_timer);
+    }
+    else // Nenhum LED aceso para a saída do programa (EXIT)
+    {
+        return;
+    }
+}
+
+static char *get_state_name(Sistema estado)
+{
+    switch (estado)
+    {
+        case INICIALIZACAO:
+            return "INICIALIZANDO";
+        case READY:
+            return "READY";
+        case CAPTURA:
+            return "GRAVACAO";
+        case SD_NOT_FOUND:
+            return "SD_NOT_FOUND";
+        case LEITURA_SD:
+            return "LEITURA";
+        case EXIT:
+            return "SAINDO";
+    }
+}
+
+static void display_upd()
+{
+    // Durante a gravação o temporizador de amostragem pode usar o barramento do display
+    if (estado_atual == CAPTURA && imu_no_barramento(I2C_PORT_DISP))
+    {
+        return;
+    }
+
+    // Limpa o display
+    ssd1306_fill(&ssd, false);
+
+    if (estado_atual != ERROR)
+    {   
+        // Define estado do cartão SD em string
         char *str_sd_state;
         if (estado_atual == SD_NOT_FOUND)
         {
@@ -616,6 +2594,16 @@ static void display_upd()
         {
             str_sd_state = "SD: LOADING";
         }
+        else if (estado_atual == CAPTURA && gravacao_pausada)
+        {
+            str_sd_state = sd_get_by_num(0)->m_Status & STA_NODISK ? "SD: AUSENTE" : "SD: FALHA";
+        }
+#if RAID_MODO == 2
+        else if (estado_atual == CAPTURA && raid_members_active(&raid) < RAID_MEMBERS)
+        {
+            str_sd_state = "SD: 1 DE 2";
+        }
+#endif
         else
         {
             str_sd_state = "SD: OK";
@@ -644,7 +2632,10 @@ static void display_upd()
         ssd1306_draw_string(&ssd, "ERRO!", 48, 24);
     }
 
-    ssd1306_send_data(&ssd);
+    if (!ssd1306_send_data(&ssd))
+    {
+        recuperar_display();
+    }
 }
 
 static void handle_error(Sistema tipo, uint32_t duracao)
@@ -693,4 +2684,4 @@ bool buzzer_beep_callback(struct repeating_timer *t)
         return false;
     }
     return true;
-}
\ No newline at end of file
+}
@@ -0,0 +1,75 @@
+#include "imulog.h"
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64)
+#define IMULOG_X86 1
+#include <immintrin.h>
+#endif
+
+namespace imulog
+{
+
+static void converter_escalar(const int16_t *entrada, float *saida, size_t n, float sensibilidade)
+{
+  for (size_t i = 0; i < n; i++)
+    saida[i] = entrada[i] / sensibilidade;
+}
+
+#ifdef IMULOG_X86
+// 16 amostras por iteração: int16 -> int32 -> float e uma divisão (a mesma operação do
+// caminho escalar, então os dois dão resultados idênticos)
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("avx2")))
+#endif
+static void converter_avx2(const int16_t *entrada, float *saida, size_t n, float sensibilidade)
+{
+  const __m256 s = _mm256_set1_ps(sensibilidade);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+  {
+    __m256i v = _mm256_loadu_si256((const __m256i *)(entrada + i));
+    __m256i baixo = _mm256_cvtepi16_epi32(_mm256_castsi256_si128(v));
+    __m256i alto = _mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1));
+    _mm256_storeu_ps(saida + i, _mm256_div_ps(_mm256_cvtepi32_ps(baixo), s));
+    _mm256_storeu_ps(saida + i + 8, _mm256_div_ps(_mm256_cvtepi32_ps(alto), s));
+  }
+  converter_escalar(entrada + i, saida + i, n - i, sensibilidade);
+}
+
+static bool cpu_tem_avx2()
+{
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+#endif
+
+static bool avx2_ativo =
+#ifdef IMULOG_X86
+    cpu_tem_avx2();
+#else
+    false;
+#endif
+
+bool usar_avx2(bool permitir)
+{
+#ifdef IMULOG_X86
+  avx2_ativo = permitir && cpu_tem_avx2();
+#endif
+  return avx2_ativo;
+}
+
+void converter(const int16_t *entrada, float *saida, size_t n, float sensibilidade)
+{
+#ifdef IMULOG_X86
+  if (avx2_ativo)
+  {
+    converter_avx2(entrada, saida, n, sensibilidade);
+    return;
+  }
+#endif
+  converter_escalar(entrada, saida, n, sensibilidade);
+}
+
+} // namespace imulog
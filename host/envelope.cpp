@@ -0,0 +1,411 @@
+#include "envelope.h"
+#include "paralelo.h"
+
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef _WIN32
+#define fseek64 _fseeki64
+#define ftell64 _ftelli64
+#else
+#define fseek64 fseeko
+#define ftell64 ftello
+#endif
+
+namespace imulog
+{
+
+// Intervalos guardados por nível antes de ir para o arquivo temporário
+constexpr size_t ENVELOPE_BUFFER = 4096;
+
+static void gravar_le(uint8_t *p, uint64_t v, int bytes)
+{
+  for (int i = 0; i < bytes; i++)
+    p[i] = (uint8_t)(v >> (8 * i));
+}
+
+static uint64_t ler_le(const uint8_t *p, int bytes)
+{
+  uint64_t v = 0;
+  for (int i = 0; i < bytes; i++)
+    v |= (uint64_t)p[i] << (8 * i);
+  return v;
+}
+
+// Redução de uma série (um eixo ou o tempo) de todos os sensores. Os níveis são criados
+// conforme o de baixo completa intervalos; o tempo guarda só o mínimo (início do intervalo)
+template <class T>
+class Serie
+{
+public:
+  Serie(const std::string &caminho_tmp, bool so_min) : caminho_(caminho_tmp), so_min_(so_min)
+  {
+    tmp_ = fopen(caminho_.c_str(), "w+b");
+    if (!tmp_)
+      throw std::runtime_error("não foi possível criar " + caminho_);
+  }
+
+  ~Serie()
+  {
+    fclose(tmp_);
+    remove(caminho_.c_str());
+  }
+
+  void adicionar(int sensor, T v)
+  {
+    Nivel &n = nivel(sensor, 0);
+    acumular(n, v, v);
+    if (n.n == ENVELOPE_BASE)
+      emitir(sensor, 0, true);
+  }
+
+  // Fecha os intervalos incompletos de baixo para cima e descarta os níveis acima do
+  // primeiro que resume a gravação inteira num intervalo
+  void finalizar()
+  {
+    for (int s = 0; s < ENVELOPE_MAX_SENSORES; s++)
+    {
+      auto &niveis = sensores_[s];
+      for (size_t k = 0; k < niveis.size(); k++)
+      {
+        if (niveis[k].n > 0 && niveis[k].intervalos == 0)
+        {
+          emitir(s, (int)k, false);
+          niveis.resize(k + 1);
+        }
+        else if (niveis[k].n > 0)
+          emitir(s, (int)k, true);
+        else if (niveis[k].intervalos <= 1)
+          niveis.resize(niveis[k].intervalos ? k + 1 : k);
+      }
+      for (size_t k = 0; k < niveis.size(); k++)
+        descarregar(s, (int)k);
+    }
+    fflush(tmp_);
+  }
+
+  int niveis(int sensor) const { return (int)sensores_[sensor].size(); }
+  uint64_t intervalos(int sensor, int k) const { return sensores_[sensor][k].intervalos; }
+
+  // Copia os intervalos do nível k do sensor, na ordem, para o arquivo de saída
+  void copiar(int sensor, int k, FILE *saida, std::vector<uint8_t> &buffer) const
+  {
+    for (auto &p : pedacos_)
+    {
+      if (p.sensor != sensor || p.nivel != k)
+        continue;
+      buffer.resize(p.bytes);
+      if (fseek64(tmp_, p.off, SEEK_SET) != 0 || fread(buffer.data(), 1, p.bytes, tmp_) != p.bytes ||
+          fwrite(buffer.data(), 1, p.bytes, saida) != p.bytes)
+        throw std::runtime_error("falha ao copiar " + caminho_);
+    }
+  }
+
+private:
+  struct Nivel
+  {
+    T min{}, max{};
+    uint32_t n = 0;          // Intervalos (ou amostras) acumulados no intervalo atual
+    uint64_t intervalos = 0; // Intervalos completos emitidos
+    std::vector<T> buffer;
+  };
+
+  struct Pedaco
+  {
+    int sensor, nivel;
+    int64_t off;
+    size_t bytes;
+  };
+
+  Nivel &nivel(int sensor, int k)
+  {
+    if (sensor >= ENVELOPE_MAX_SENSORES)
+      throw std::runtime_error("sensor " + std::to_string(sensor) + " fora do limite");
+    auto &niveis = sensores_[sensor];
+    if ((size_t)k == niveis.size())
+      niveis.emplace_back();
+    return niveis[k];
+  }
+
+  static void acumular(Nivel &n, T min, T max)
+  {
+    if (n.n == 0 || min < n.min)
+      n.min = min;
+    if (n.n == 0 || max > n.max)
+      n.max = max;
+    n.n++;
+  }
+
+  void emitir(int sensor, int k, bool subir)
+  {
+    Nivel &n = sensores_[sensor][k];
+    T min = n.min, max = n.max;
+    n.buffer.push_back(min);
+    if (!so_min_)
+      n.buffer.push_back(max);
+    n.intervalos++;
+    n.n = 0;
+    if (n.buffer.size() >= ENVELOPE_BUFFER)
+      descarregar(sensor, k);
+    if (!subir)
+      return;
+    Nivel &acima = nivel(sensor, k + 1); // Pode realocar: não usar `n` daqui em diante
+    acumular(acima, min, max);
+    if (acima.n == ENVELOPE_FATOR)
+      emitir(sensor, k + 1, true);
+  }
+
+  void descarregar(int sensor, int k)
+  {
+    auto &b = sensores_[sensor][k].buffer;
+    if (b.empty())
+      return;
+    // Os valores vão em little-endian, como no arquivo final
+    std::vector<uint8_t> bytes(b.size() * sizeof(T));
+    for (size_t i = 0; i < b.size(); i++)
+      gravar_le(&bytes[i * sizeof(T)], (uint64_t)b[i], sizeof(T));
+    int64_t off = ftell64(tmp_);
+    if (fwrite(bytes.data(), 1, bytes.size(), tmp_) != bytes.size())
+      throw std::runtime_error("falha ao gravar " + caminho_);
+    pedacos_.push_back({sensor, k, off, bytes.size()});
+    b.clear();
+  }
+
+  std::string caminho_;
+  bool so_min_;
+  FILE *tmp_;
+  std::vector<Nivel> sensores_[ENVELOPE_MAX_SENSORES];
+  std::vector<Pedaco> pedacos_;
+};
+
+// Volta de unidades para contagens; de um CSV com duas casas, só aproximadamente
+static int16_t quantizar(float v, float sensibilidade)
+{
+  long q = lroundf(v * sensibilidade);
+  return (int16_t)std::min(std::max(q, -32768L), 32767L);
+}
+
+void gerar_envelope(Leitor &leitor, const std::string &saida, unsigned threads)
+{
+  std::vector<std::unique_ptr<Serie<int16_t>>> eixos;
+  for (int e = 0; e < EIXOS; e++)
+    eixos.push_back(std::make_unique<Serie<int16_t>>(saida + ".tmp" + std::to_string(e), false));
+  Serie<uint32_t> tempo(saida + ".tmpt", true);
+
+  Lote lote;
+  int sensores = 1;
+  while (leitor.ler(lote, LOTE_PADRAO))
+  {
+    size_t n = lote.tamanho();
+    bool bruto = lote.bruto[0].size() == n;
+    for (size_t i = 0; i < n; i++)
+      sensores = std::max(sensores, lote.sensor[i] + 1);
+    // Uma série por tarefa: as séries não compartilham nada, cada uma percorre o lote todo
+    paralelo(EIXOS + 1, threads, [&](size_t t0, size_t t1) {
+      for (size_t t = t0; t < t1; t++)
+      {
+        if (t == EIXOS)
+        {
+          for (size_t i = 0; i < n; i++)
+            tempo.adicionar(lote.sensor[i], lote.tempo_ms[i]);
+          continue;
+        }
+        Serie<int16_t> &s = *eixos[t];
+        float sens = t < 3 ? SENSIBILIDADE_ACCEL : SENSIBILIDADE_GYRO;
+        for (size_t i = 0; i < n; i++)
+          s.adicionar(lote.sensor[i], bruto ? lote.bruto[t][i] : quantizar(lote.eixo[t][i], sens));
+      }
+    });
+  }
+  paralelo(EIXOS + 1, threads, [&](size_t t0, size_t t1) {
+    for (size_t t = t0; t < t1; t++)
+    {
+      if (t == EIXOS)
+        tempo.finalizar();
+      else
+        eixos[t]->finalizar();
+    }
+  });
+
+  int niveis = 0;
+  for (int s = 0; s < sensores; s++)
+    niveis = std::max(niveis, tempo.niveis(s));
+
+  std::vector<uint8_t> cabecalho(ENVELOPE_CABECALHO + (size_t)sensores * niveis * 24);
+  uint8_t *c = cabecalho.data();
+  gravar_le(c, ENVELOPE_MAGICO, 4);
+  gravar_le(c + 4, 1, 2);
+  c[6] = (uint8_t)sensores;
+  c[7] = EIXOS;
+  gravar_le(c + 8, ENVELOPE_BASE, 4);
+  gravar_le(c + 12, ENVELOPE_FATOR, 4);
+  gravar_le(c + 16, niveis, 4);
+  gravar_le(c + 24, leitor.total(), 8);
+  float sens[2] = {SENSIBILIDADE_ACCEL, SENSIBILIDADE_GYRO};
+  memcpy(c + 32, sens, sizeof(sens));
+
+  uint64_t off = cabecalho.size();
+  for (int s = 0; s < sensores; s++)
+  {
+    for (int k = 0; k < tempo.niveis(s); k++)
+    {
+      uint8_t *entrada = c + ENVELOPE_CABECALHO + (s * niveis + k) * 24;
+      uint64_t n = tempo.intervalos(s, k);
+      gravar_le(entrada, n, 8);
+      gravar_le(entrada + 8, off, 8);
+      off += n * 4;
+      gravar_le(entrada + 16, off, 8);
+      off += n * 4 * EIXOS;
+    }
+  }
+
+  FILE *f = fopen(saida.c_str(), "wb");
+  if (!f)
+    throw std::runtime_error("não foi possível criar " + saida);
+  try
+  {
+    std::vector<uint8_t> buffer;
+    if (fwrite(cabecalho.data(), 1, cabecalho.size(), f) != cabecalho.size())
+      throw std::runtime_error("falha ao gravar " + saida);
+    for (int s = 0; s < sensores; s++)
+    {
+      for (int k = 0; k < tempo.niveis(s); k++)
+      {
+        tempo.copiar(s, k, f, buffer);
+        for (auto &e : eixos)
+          e->copiar(s, k, f, buffer);
+      }
+    }
+  }
+  catch (...)
+  {
+    fclose(f);
+    throw;
+  }
+  if (fclose(f) != 0)
+    throw std::runtime_error("falha ao gravar " + saida);
+}
+
+std::string caminho_envelope(const std::string &gravacao)
+{
+  size_t barra = gravacao.find_last_of("/\\");
+  size_t ponto = gravacao.find_last_of('.');
+  if (ponto == std::string::npos || (barra != std::string::npos && ponto < barra))
+    return gravacao + ".env";
+  return gravacao.substr(0, ponto) + ".env";
+}
+
+// ---------------------------------------------------------------------------------------
+// Consulta
+
+Envelope::Envelope(const std::string &caminho) : caminho_(caminho)
+{
+  f_ = fopen(caminho.c_str(), "rb");
+  if (!f_)
+    throw std::runtime_error("não foi possível abrir " + caminho);
+  try
+  {
+    uint8_t c[ENVELOPE_CABECALHO];
+    ler(0, c, sizeof(c));
+    if (ler_le(c, 4) != ENVELOPE_MAGICO || ler_le(c + 4, 2) != 1 || c[7] != EIXOS)
+      throw std::runtime_error(caminho + " não é um envelope reconhecido");
+    sensores_ = c[6];
+    base_ = (uint32_t)ler_le(c + 8, 4);
+    fator_ = (uint32_t)ler_le(c + 12, 4);
+    niveis_ = (int)ler_le(c + 16, 4);
+    total_ = ler_le(c + 24, 8);
+    memcpy(&sens_accel_, c + 32, 4);
+    memcpy(&sens_gyro_, c + 36, 4);
+    if (sensores_ < 1 || sensores_ > ENVELOPE_MAX_SENSORES || niveis_ > 64 || base_ == 0 || fator_ < 2)
+      throw std::runtime_error(caminho + ": cabeçalho inválido");
+
+    std::vector<uint8_t> t((size_t)sensores_ * niveis_ * 24);
+    ler(ENVELOPE_CABECALHO, t.data(), t.size());
+    for (size_t i = 0; i < t.size(); i += 24)
+      tabela_.push_back({ler_le(&t[i], 8), ler_le(&t[i + 8], 8), ler_le(&t[i + 16], 8)});
+  }
+  catch (...)
+  {
+    fclose(f_);
+    throw;
+  }
+  bytes_lidos_ = 0;
+}
+
+Envelope::~Envelope()
+{
+  fclose(f_);
+}
+
+void Envelope::ler(uint64_t off, void *dados, size_t n) const
+{
+  if (n == 0)
+    return;
+  if (fseek64(f_, (int64_t)off, SEEK_SET) != 0 || fread(dados, 1, n, f_) != n)
+    throw std::runtime_error(caminho_ + ": leitura além do fim");
+  bytes_lidos_ += n;
+}
+
+uint64_t Envelope::amostras_por_intervalo(int n) const
+{
+  uint64_t a = base_;
+  for (int i = 0; i < n; i++)
+    a *= fator_;
+  return a;
+}
+
+uint64_t Envelope::localizar(int sensor, int n, uint32_t tempo_ms) const
+{
+  const NivelEnvelope &nv = nivel(sensor, n);
+  // Último intervalo que começa em ou antes de tempo_ms
+  uint64_t lo = 0, hi = nv.intervalos;
+  while (hi - lo > 1)
+  {
+    uint64_t meio = lo + (hi - lo) / 2;
+    uint8_t b[4];
+    ler(nv.off_tempo + meio * 4, b, 4);
+    if (ler_le(b, 4) <= tempo_ms)
+      lo = meio;
+    else
+      hi = meio;
+  }
+  return lo;
+}
+
+int Envelope::escolher_nivel(int sensor, uint32_t de_ms, uint32_t ate_ms, unsigned pixels) const
+{
+  for (int n = niveis_ - 1; n > 0; n--)
+  {
+    if (nivel(sensor, n).intervalos == 0)
+      continue;
+    if (localizar(sensor, n, ate_ms) - localizar(sensor, n, de_ms) + 1 >= pixels)
+      return n;
+  }
+  return 0;
+}
+
+void Envelope::ler_tempo(int sensor, int n, uint64_t primeiro, size_t quantos, std::vector<uint32_t> &tempo) const
+{
+  const NivelEnvelope &nv = nivel(sensor, n);
+  quantos = (size_t)std::min<uint64_t>(quantos, nv.intervalos - std::min(primeiro, nv.intervalos));
+  std::vector<uint8_t> b(quantos * 4);
+  ler(nv.off_tempo + primeiro * 4, b.data(), b.size());
+  tempo.resize(quantos);
+  for (size_t i = 0; i < quantos; i++)
+    tempo[i] = (uint32_t)ler_le(&b[i * 4], 4);
+}
+
+void Envelope::ler_eixo(int sensor, int n, int eixo, uint64_t primeiro, size_t quantos,
+                        std::vector<int16_t> &min_max) const
+{
+  const NivelEnvelope &nv = nivel(sensor, n);
+  quantos = (size_t)std::min<uint64_t>(quantos, nv.intervalos - std::min(primeiro, nv.intervalos));
+  std::vector<uint8_t> b(quantos * 4);
+  ler(nv.off_eixos + (eixo * nv.intervalos + primeiro) * 4, b.data(), b.size());
+  min_max.resize(quantos * 2);
+  for (size_t i = 0; i < quantos * 2; i++)
+    min_max[i] = (int16_t)ler_le(&b[i * 2], 2);
+}
+
+} // namespace imulog
@@ -0,0 +1,112 @@
+#ifndef ENVELOPE_H
+#define ENVELOPE_H
+
+#include "imulog.h"
+
+#include <cstdio>
+
+// Envelope mínimo/máximo em vários níveis de resolução, gravado num arquivo à parte
+// (mpu_data.imu -> mpu_data.env), para desenhar gravações longas em qualquer zoom lendo
+// só alguns KB. No nível 0 cada intervalo resume ENVELOPE_BASE amostras de um sensor; a
+// cada nível acima, ENVELOPE_FATOR intervalos do nível de baixo. O último nível tem um
+// único intervalo com a gravação inteira.
+//
+//   off  tam  campo
+//     0    4  magico (ENVELOPE_MAGICO)
+//     4    2  versao (1)
+//     6    1  sensores
+//     7    1  eixos (6)
+//     8    4  base    amostras por intervalo no nível 0
+//    12    4  fator   intervalos por intervalo do nível de cima
+//    16    4  niveis  níveis por sensor (os sensores com menos amostras têm intervalos = 0)
+//    20    4  reservado
+//    24    8  total   amostras na gravação, todos os sensores
+//    32    4  sensibilidade do acelerômetro (float, LSB/g)
+//    36    4  sensibilidade do giroscópio (float, LSB/(°/s))
+//    40   24  reservado
+//    64  ...  tabela, sensores x niveis entradas de 24 bytes:
+//               intervalos (u64), off_tempo (u64), off_eixos (u64)
+//
+// Em off_tempo ficam `intervalos` u32 com o tempo_ms da primeira amostra de cada
+// intervalo; em off_eixos, um vetor por eixo (eixo e em off_eixos + e * intervalos * 4)
+// com pares int16 mínimo, máximo em valores brutos do sensor. Cada eixo de cada nível é
+// contíguo, então uma janela de N pixels lê cerca de N x 4 bytes por eixo. Todos os
+// campos são little-endian; em numpy:
+//   numpy.memmap(arq, "<i2", "r", off_eixos + e * intervalos * 4, (intervalos, 2))
+
+namespace imulog
+{
+
+constexpr uint32_t ENVELOPE_MAGICO = 0x45554D49u; // "IMUE"
+constexpr uint32_t ENVELOPE_BASE = 64;
+constexpr uint32_t ENVELOPE_FATOR = 4;
+constexpr size_t ENVELOPE_CABECALHO = 64;
+constexpr int ENVELOPE_MAX_SENSORES = 4;
+
+struct NivelEnvelope
+{
+  uint64_t intervalos = 0;
+  uint64_t off_tempo = 0;
+  uint64_t off_eixos = 0;
+};
+
+// Lê o leitor até o fim e grava o envelope em `saida`. Cada eixo (e o tempo) é reduzido
+// numa thread; os níveis prontos vão para arquivos temporários ao lado da saída em blocos
+// de tamanho fixo, então a memória usada não depende do tamanho da gravação.
+// Só uma gravação binária dá os valores brutos exatos. O CSV do datalogger traz g e °/s
+// com duas casas, e voltar disso para contagens é uma aproximação: o envelope de um CSV
+// pode diferir do da gravação binária em até ~82 LSB no acelerômetro (0,005 g) e 1 LSB
+// no giroscópio
+void gerar_envelope(Leitor &leitor, const std::string &saida, unsigned threads);
+
+// Caminho padrão do envelope de uma gravação: troca a extensão por .env
+std::string caminho_envelope(const std::string &gravacao);
+
+// Consulta a um envelope gravado; só o cabeçalho e a tabela ficam em memória
+class Envelope
+{
+public:
+  explicit Envelope(const std::string &caminho);
+  ~Envelope();
+  Envelope(const Envelope &) = delete;
+  Envelope &operator=(const Envelope &) = delete;
+
+  int sensores() const { return sensores_; }
+  int niveis() const { return niveis_; }
+  uint64_t total() const { return total_; }
+  float sensibilidade(int eixo) const { return eixo < 3 ? sens_accel_ : sens_gyro_; }
+  const NivelEnvelope &nivel(int sensor, int n) const { return tabela_[sensor * niveis_ + n]; }
+  uint64_t amostras_por_intervalo(int n) const;
+
+  // Intervalo do nível n que contém tempo_ms (busca binária no vetor de tempos)
+  uint64_t localizar(int sensor, int n, uint32_t tempo_ms) const;
+
+  // Nível mais grosso que ainda tem ao menos `pixels` intervalos em [de_ms, ate_ms]
+  int escolher_nivel(int sensor, uint32_t de_ms, uint32_t ate_ms, unsigned pixels) const;
+
+  // Intervalos [primeiro, primeiro + n) do nível: tempos e pares mínimo/máximo brutos
+  void ler_tempo(int sensor, int nivel, uint64_t primeiro, size_t n, std::vector<uint32_t> &tempo) const;
+  void ler_eixo(int sensor, int nivel, int eixo, uint64_t primeiro, size_t n, std::vector<int16_t> &min_max) const;
+
+  // Bytes lidos do arquivo pelas consultas até agora
+  uint64_t bytes_lidos() const { return bytes_lidos_; }
+
+private:
+  void ler(uint64_t off, void *dados, size_t n) const;
+
+  FILE *f_ = nullptr;
+  std::string caminho_;
+  int sensores_ = 0;
+  int niveis_ = 0;
+  uint32_t base_ = 0;
+  uint32_t fator_ = 0;
+  uint64_t total_ = 0;
+  float sens_accel_ = 0;
+  float sens_gyro_ = 0;
+  std::vector<NivelEnvelope> tabela_;
+  mutable uint64_t bytes_lidos_ = 0;
+};
+
+} // namespace imulog
+
+#endif
@@ -0,0 +1,128 @@
+#include "envelope.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+// Gera o envelope mínimo/máximo de uma gravação ou consulta uma janela de tempo nele.
+// Uso: imulog_envelope entrada.imu [entrada_cartao1.imu] [-o saida.env] [--faixa=N] [--threads=N]
+//      imulog_envelope --consultar saida.env --de=MS --ate=MS [--pixels=N] [--sensor=S]
+
+static void uso()
+{
+  fprintf(stderr, "Uso: imulog_envelope entrada.imu [entrada_cartao1.imu] [-o saida.env] [--faixa=N] [--threads=N]\n"
+                  "     imulog_envelope --consultar saida.env --de=MS --ate=MS [--pixels=N] [--sensor=S]\n"
+                  "  A consulta escreve em CSV o mínimo e o máximo de cada eixo por intervalo, no nível\n"
+                  "  mais grosso com ao menos N intervalos na janela (padrão 1000)\n"
+                  "  Uma entrada CSV dá um envelope aproximado: o CSV só tem duas casas decimais\n");
+}
+
+static bool comeca(const char *a, const char *prefixo)
+{
+  return strncmp(a, prefixo, strlen(prefixo)) == 0;
+}
+
+static int consultar(const std::string &caminho, uint32_t de, uint32_t ate, unsigned pixels, int sensor)
+{
+  imulog::Envelope env(caminho);
+  if (sensor >= env.sensores() || env.niveis() == 0)
+    throw std::runtime_error("sensor " + std::to_string(sensor) + " sem dados em " + caminho);
+  int n = env.escolher_nivel(sensor, de, ate, pixels);
+  uint64_t primeiro = env.localizar(sensor, n, de);
+  size_t quantos = (size_t)(env.localizar(sensor, n, ate) - primeiro + 1);
+
+  std::vector<uint32_t> tempo;
+  std::vector<int16_t> eixos[imulog::EIXOS];
+  env.ler_tempo(sensor, n, primeiro, quantos, tempo);
+  for (int e = 0; e < imulog::EIXOS; e++)
+    env.ler_eixo(sensor, n, e, primeiro, quantos, eixos[e]);
+
+  printf("time_ms");
+  for (int e = 0; e < imulog::EIXOS; e++)
+    printf(",%s_min,%s_max", imulog::NOMES_EIXOS[e], imulog::NOMES_EIXOS[e]);
+  printf("\n");
+  for (size_t i = 0; i < tempo.size(); i++)
+  {
+    printf("%u", tempo[i]);
+    for (int e = 0; e < imulog::EIXOS; e++)
+    {
+      float s = env.sensibilidade(e);
+      printf(e < 3 ? ",%.5f,%.5f" : ",%.3f,%.3f", eixos[e][2 * i] / s, eixos[e][2 * i + 1] / s);
+    }
+    printf("\n");
+  }
+  fprintf(stderr, "Nível %d (%llu amostras por intervalo): %zu intervalos, %llu bytes lidos\n", n,
+          (unsigned long long)env.amostras_por_intervalo(n), tempo.size(), (unsigned long long)env.bytes_lidos());
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<std::string> entradas;
+  std::string saida, consulta;
+  unsigned faixa = imulog::FAIXA_PADRAO;
+  unsigned threads = std::max(std::thread::hardware_concurrency(), 1u);
+  uint32_t de = 0, ate = UINT32_MAX;
+  unsigned pixels = 1000;
+  int sensor = 0;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    if (!strcmp(a, "-o") && i + 1 < argc)
+      saida = argv[++i];
+    else if (!strcmp(a, "--consultar") && i + 1 < argc)
+      consulta = argv[++i];
+    else if (comeca(a, "--faixa="))
+      faixa = (unsigned)atoi(a + 8);
+    else if (comeca(a, "--threads="))
+      threads = std::max(atoi(a + 10), 1);
+    else if (comeca(a, "--de="))
+      de = (uint32_t)strtoul(a + 5, nullptr, 10);
+    else if (comeca(a, "--ate="))
+      ate = (uint32_t)strtoul(a + 6, nullptr, 10);
+    else if (comeca(a, "--pixels="))
+      pixels = (unsigned)std::max(atoi(a + 9), 1);
+    else if (comeca(a, "--sensor="))
+      sensor = atoi(a + 9);
+    else if (a[0] == '-')
+    {
+      uso();
+      return 1;
+    }
+    else
+      entradas.push_back(a);
+  }
+
+  try
+  {
+    if (!consulta.empty())
+      return consultar(consulta, de, ate, pixels, sensor);
+    if (entradas.empty())
+    {
+      uso();
+      return 1;
+    }
+    if (saida.empty())
+      saida = imulog::caminho_envelope(entradas[0]);
+
+    auto inicio = std::chrono::steady_clock::now();
+    auto leitor = imulog::abrir(entradas, faixa, threads);
+    imulog::gerar_envelope(*leitor, saida, threads);
+    for (auto &a : leitor->avisos())
+      printf("%s\n", a.c_str());
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+    printf("%llu amostras em %s: %.2f s, %.1f MB/s de entrada (%u threads)\n", (unsigned long long)leitor->total(),
+           saida.c_str(), s, leitor->bytes() / 1e6 / (s > 0 ? s : 1), threads);
+  }
+  catch (const std::exception &e)
+  {
+    fprintf(stderr, "Erro: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
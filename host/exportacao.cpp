@@ -0,0 +1,273 @@
+#include "imulog.h"
+#include "paralelo.h"
+
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace imulog
+{
+
+// Casas decimais por eixo no CSV, as mesmas do DecodificaDados.py
+static const int CASAS[EIXOS] = {5, 5, 5, 3, 3, 3};
+
+// Escreve bruto / sensibilidade com `casas` decimais direto do valor inteiro, sem passar
+// por float: q = bruto * 10^casas / sensibilidade arredondado ao par mais próximo, o mesmo
+// resultado do "%.5f" / "%.3f" do Python sobre o quociente exato. É bem mais rápido que
+// formatar o float e é o que limita a exportação para CSV
+static char *fixo(char *p, int16_t bruto, int64_t escala, int64_t sensibilidade, int casas)
+{
+  int64_t num = (int64_t)(bruto < 0 ? -bruto : bruto) * escala;
+  int64_t q = num / sensibilidade, r = num % sensibilidade;
+  if (2 * r > sensibilidade || (2 * r == sensibilidade && (q & 1)))
+    q++;
+  if (bruto < 0)
+    *p++ = '-';
+  char dig[24];
+  int n = 0;
+  for (; q || n <= casas; q /= 10)
+    dig[n++] = (char)('0' + q % 10);
+  while (n > casas)
+    *p++ = dig[--n];
+  *p++ = '.';
+  while (n > 0)
+    *p++ = dig[--n];
+  return p;
+}
+
+static FILE *criar(const std::string &caminho)
+{
+  FILE *f = fopen(caminho.c_str(), "wb");
+  if (!f)
+    throw std::runtime_error("não foi possível criar " + caminho);
+  setvbuf(f, nullptr, _IOFBF, 1 << 20);
+  return f;
+}
+
+static void gravar(FILE *f, const void *dados, size_t n, const std::string &nome)
+{
+  if (n && fwrite(dados, 1, n, f) != n)
+    throw std::runtime_error("falha ao gravar " + nome);
+}
+
+class ExportadorCsv : public Exportador
+{
+public:
+  ExportadorCsv(const std::string &caminho, bool varios, bool bruto, unsigned threads)
+      : caminho_(caminho), varios_(varios), bruto_(bruto), threads_(threads), partes_(std::max(threads, 1u))
+  {
+    f_ = criar(caminho);
+    std::string cabecalho = varios ? "time_ms,sensor," : "time_ms,";
+    for (int e = 0; e < EIXOS; e++)
+      cabecalho += std::string(NOMES_EIXOS[e]) + (e < EIXOS - 1 ? "," : "\n");
+    gravar(f_, cabecalho.data(), cabecalho.size(), caminho_);
+  }
+
+  ~ExportadorCsv() override
+  {
+    if (f_)
+      fclose(f_);
+  }
+
+  void escrever(const Lote &lote) override
+  {
+    if (bruto_ && lote.bruto[0].size() != lote.tamanho())
+      throw std::runtime_error("valores brutos só existem na leitura do binário");
+    // Cada thread formata um intervalo contíguo de linhas no seu buffer; os buffers são
+    // gravados na ordem, então o arquivo sai igual ao da versão sequencial
+    paralelo(partes_.size(), threads_, [&](size_t p0, size_t p1) {
+      for (size_t p = p0; p < p1; p++)
+        formatar(lote, lote.tamanho() * p / partes_.size(), lote.tamanho() * (p + 1) / partes_.size(), partes_[p]);
+    });
+    for (auto &parte : partes_)
+      gravar(f_, parte.data(), parte.size(), caminho_);
+  }
+
+  void finalizar() override
+  {
+    if (fclose(f_) != 0)
+    {
+      f_ = nullptr;
+      throw std::runtime_error("falha ao gravar " + caminho_);
+    }
+    f_ = nullptr;
+  }
+
+private:
+  void formatar(const Lote &lote, size_t inicio, size_t fim, std::string &saida) const
+  {
+    // Pior caso por linha: 10 + 1 + 3 + 6 x (sinal + 5 dígitos + ponto + 5 casas) + vírgulas
+    constexpr size_t MAX_LINHA = 128;
+    saida.resize((fim - inicio) * MAX_LINHA);
+    bool tem_bruto = lote.bruto[0].size() == lote.tamanho();
+    char *p = saida.data();
+    for (size_t i = inicio; i < fim; i++)
+    {
+      char *lim = p + MAX_LINHA;
+      p = std::to_chars(p, lim, lote.tempo_ms[i]).ptr;
+      *p++ = ',';
+      if (varios_)
+      {
+        p = std::to_chars(p, lim, lote.sensor[i]).ptr;
+        *p++ = ',';
+      }
+      for (int e = 0; e < EIXOS; e++)
+      {
+        if (bruto_)
+          p = std::to_chars(p, lim, lote.bruto[e][i]).ptr;
+        else if (tem_bruto)
+          p = fixo(p, lote.bruto[e][i], CASAS[e] == 5 ? 100000 : 1000,
+                   e < 3 ? (int64_t)SENSIBILIDADE_ACCEL : (int64_t)SENSIBILIDADE_GYRO, CASAS[e]);
+        else
+          p = std::to_chars(p, lim, lote.eixo[e][i], std::chars_format::fixed, CASAS[e]).ptr;
+        *p++ = e < EIXOS - 1 ? ',' : '\n';
+      }
+    }
+    saida.resize(p - saida.data());
+  }
+
+  std::string caminho_;
+  bool varios_, bruto_;
+  unsigned threads_;
+  std::vector<std::string> partes_;
+  FILE *f_ = nullptr;
+};
+
+std::unique_ptr<Exportador> exportar_csv(const std::string &caminho, bool varios, bool bruto, unsigned threads)
+{
+  return std::make_unique<ExportadorCsv>(caminho, varios, bruto, threads);
+}
+
+// Formato .npy versão 1.0: mágico, versão, tamanho do cabeçalho e um dicionário Python em
+// texto, completado com espaços até múltiplo de 64 bytes. O cabeçalho tem tamanho fixo
+// para o número de linhas poder ser corrigido no fim
+class ExportadorNpy : public Exportador
+{
+public:
+  ExportadorNpy(const std::string &diretorio, uint64_t total, bool varios, bool bruto, unsigned threads)
+      : bruto_(bruto), threads_(threads), total_(total)
+  {
+    std::error_code erro;
+    std::filesystem::create_directories(diretorio, erro);
+    std::string base = diretorio.empty() || diretorio.back() == '/' ? diretorio : diretorio + "/";
+    colunas_.push_back({base + "time_ms.npy", "<u4", nullptr});
+    if (varios)
+      colunas_.push_back({base + "sensor.npy", "|u1", nullptr});
+    for (int e = 0; e < EIXOS; e++)
+      colunas_.push_back({base + NOMES_EIXOS[e] + ".npy", bruto ? "<i2" : "<f4", nullptr});
+    for (auto &c : colunas_)
+    {
+      c.f = criar(c.caminho);
+      cabecalho(c, total_);
+    }
+  }
+
+  ~ExportadorNpy() override
+  {
+    for (auto &c : colunas_)
+    {
+      if (c.f)
+        fclose(c.f);
+    }
+  }
+
+  void escrever(const Lote &lote) override
+  {
+    if (bruto_ && lote.bruto[0].size() != lote.tamanho())
+      throw std::runtime_error("valores brutos só existem na leitura do binário");
+    size_t n = lote.tamanho();
+    paralelo(colunas_.size(), threads_, [&](size_t c0, size_t c1) {
+      for (size_t c = c0; c < c1; c++)
+      {
+        const void *dados;
+        size_t tam;
+        coluna(lote, c, &dados, &tam);
+        gravar(colunas_[c].f, dados, n * tam, colunas_[c].caminho);
+      }
+    });
+    escritas_ += n;
+  }
+
+  void finalizar() override
+  {
+    for (auto &c : colunas_)
+    {
+      // A leitura pode ter parado antes do total anunciado
+      if (escritas_ != total_)
+      {
+        fseek(c.f, 0, SEEK_SET);
+        cabecalho(c, escritas_);
+      }
+      FILE *f = c.f;
+      c.f = nullptr;
+      if (fclose(f) != 0)
+        throw std::runtime_error("falha ao gravar " + c.caminho);
+    }
+  }
+
+private:
+  struct Coluna
+  {
+    std::string caminho;
+    const char *tipo;
+    FILE *f;
+  };
+
+  static constexpr size_t CABECALHO = 128;
+
+  static void cabecalho(const Coluna &c, uint64_t linhas)
+  {
+    char texto[CABECALHO];
+    int n = snprintf(texto + 10, CABECALHO - 10, "{'descr': '%s', 'fortran_order': False, 'shape': (%llu,), }",
+                     c.tipo, (unsigned long long)linhas);
+    memset(texto + 10 + n, ' ', CABECALHO - 10 - n);
+    texto[CABECALHO - 1] = '\n';
+    memcpy(texto, "\x93NUMPY\x01\x00", 8);
+    texto[8] = (char)((CABECALHO - 10) & 0xFF);
+    texto[9] = (char)((CABECALHO - 10) >> 8);
+    gravar(c.f, texto, CABECALHO, c.caminho);
+  }
+
+  void coluna(const Lote &lote, size_t c, const void **dados, size_t *tam) const
+  {
+    if (c == 0)
+    {
+      *dados = lote.tempo_ms.data();
+      *tam = sizeof(uint32_t);
+      return;
+    }
+    if (colunas_.size() > EIXOS + 1 && c == 1)
+    {
+      *dados = lote.sensor.data();
+      *tam = sizeof(uint8_t);
+      return;
+    }
+    int e = (int)(c - (colunas_.size() - EIXOS));
+    if (bruto_)
+    {
+      *dados = lote.bruto[e].data();
+      *tam = sizeof(int16_t);
+    }
+    else
+    {
+      *dados = lote.eixo[e].data();
+      *tam = sizeof(float);
+    }
+  }
+
+  bool bruto_;
+  unsigned threads_;
+  uint64_t total_;
+  uint64_t escritas_ = 0;
+  std::vector<Coluna> colunas_;
+};
+
+std::unique_ptr<Exportador> exportar_npy(const std::string &diretorio, uint64_t total, bool varios, bool bruto,
+                                         unsigned threads)
+{
+  return std::make_unique<ExportadorNpy>(diretorio, total, varios, bruto, threads);
+}
+
+} // namespace imulog
@@ -0,0 +1,159 @@
+#ifndef IMULOG_H
+#define IMULOG_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Leitura das gravações do datalogger no computador, para sessões grandes demais para o
+// pandas. Os arquivos são mapeados em memória e lidos em lotes de tamanho limitado, então
+// a memória usada não depende do tamanho da gravação:
+//
+//   auto leitor = imulog::abrir({"mpu_data.imu"}, imulog::FAIXA_PADRAO, threads);
+//   imulog::Lote lote;
+//   while (leitor->ler(lote, imulog::LOTE_PADRAO))
+//     ... lote.tempo_ms, lote.sensor, lote.eixo[0..5] em g e °/s ...
+//
+// No binário (.imu, formato em lib/compressao.h) os blocos são independentes e cada
+// lote é decodificado em paralelo, um intervalo de blocos por thread; a conversão dos
+// valores brutos int16 para unidades físicas usa AVX2 quando o processador tem. O CSV
+// gravado pelo dispositivo é dividido em trechos alinhados a linhas e também lido em
+// paralelo. Erros de abertura ou de formato lançam std::runtime_error.
+//
+// Com uma janela de tempo e o índice gravado pelo dispositivo ao lado do log (.idx,
+// formato em lib/indice.h), só os bytes do log que cobrem a janela são lidos.
+
+namespace imulog
+{
+
+constexpr size_t BLOCO_TAM = 512;
+constexpr uint32_t BLOCO_MAGICO = 0x42554D49u; // "IMUB"
+constexpr unsigned FAIXA_PADRAO = 8;           // RAID_FAIXA_SETORES em datalogger.c
+constexpr size_t LOTE_PADRAO = 1 << 20;        // Amostras por lote
+constexpr float SENSIBILIDADE_ACCEL = 16384.0f; // LSB/g em ±2 g
+constexpr float SENSIBILIDADE_GYRO = 131.0f;    // LSB/(°/s) em ±250 °/s
+constexpr int EIXOS = 6;
+
+// Nomes das colunas dos eixos, na ordem do CSV do dispositivo
+extern const char *const NOMES_EIXOS[EIXOS];
+
+// Arquivo somente leitura mapeado em memória
+class Mapa
+{
+public:
+  explicit Mapa(const std::string &caminho);
+  ~Mapa();
+  Mapa(const Mapa &) = delete;
+  Mapa &operator=(const Mapa &) = delete;
+
+  const uint8_t *dados() const { return dados_; }
+  size_t tamanho() const { return tamanho_; }
+
+private:
+  const uint8_t *dados_ = nullptr;
+  size_t tamanho_ = 0;
+#ifdef _WIN32
+  void *arquivo_ = nullptr;
+  void *mapeamento_ = nullptr;
+#endif
+};
+
+// Amostras em colunas. `bruto` só é preenchido na leitura do binário
+struct Lote
+{
+  std::vector<uint32_t> tempo_ms;
+  std::vector<uint8_t> sensor;
+  std::array<std::vector<int16_t>, EIXOS> bruto;
+  std::array<std::vector<float>, EIXOS> eixo; // accel em g, giro em °/s
+
+  size_t tamanho() const { return tempo_ms.size(); }
+  void redimensionar(size_t n, bool com_bruto);
+};
+
+class Leitor
+{
+public:
+  virtual ~Leitor() = default;
+
+  // Preenche o lote com até `max` amostras (ao menos um bloco ou trecho inteiro);
+  // retorna false quando não há mais nada
+  virtual bool ler(Lote &lote, size_t max) = 0;
+
+  uint64_t total() const { return total_; }     // Amostras na gravação
+  uint64_t bytes() const { return bytes_; }     // Bytes de entrada usados
+  bool varios_sensores() const { return varios_; }
+  bool tem_bruto() const { return bruto_; }
+  const std::vector<std::string> &avisos() const { return avisos_; }
+
+protected:
+  uint64_t total_ = 0;
+  uint64_t bytes_ = 0;
+  bool varios_ = false;
+  bool bruto_ = false;
+  std::vector<std::string> avisos_;
+};
+
+// Janela de tempo da leitura, inclusiva nas duas pontas
+struct Janela
+{
+  uint32_t de_ms = 0;
+  uint32_t ate_ms = UINT32_MAX;
+
+  bool inteira() const { return de_ms == 0 && ate_ms == UINT32_MAX; }
+};
+
+// Caminho do índice de um log: troca a extensão por .idx, como indice_nome() no firmware
+std::string caminho_indice(const std::string &log);
+
+// Bytes [*inicio, *fim) do log que contêm todas as amostras da janela, pelo índice;
+// false se o índice não existir, não for reconhecido ou for de outro formato de log ou de
+// outra gravação
+bool consultar_indice(const std::string &log, uint64_t tamanho_log, bool binario, const Janela &janela,
+                      uint64_t *inicio, uint64_t *fim);
+
+// Abre uma gravação binária; vários arquivos são os cartões de um RAID-0, na ordem, com
+// faixas de `faixa` blocos. A leitura para no primeiro bloco inválido ou de outra sessão
+std::unique_ptr<Leitor> abrir_imu(const std::vector<std::string> &arquivos, unsigned faixa, unsigned threads);
+
+// Abre o CSV gravado pelo dispositivo (time_ms,[sensor,]accel_x,...,giro_z)
+std::unique_ptr<Leitor> abrir_csv(const std::string &arquivo, unsigned threads);
+
+// Escolhe pelo sufixo: .csv para CSV, qualquer outro como binário
+std::unique_ptr<Leitor> abrir(const std::vector<std::string> &arquivos, unsigned faixa, unsigned threads);
+
+// Idem, só as amostras da janela. Num arquivo com índice a leitura começa e termina nos
+// offsets dados por ele; sem índice (ou no RAID-0) a gravação é lida e filtrada. total()
+// conta as amostras do trecho lido, não só as da janela
+std::unique_ptr<Leitor> abrir(const std::vector<std::string> &arquivos, unsigned faixa, unsigned threads,
+                              const Janela &janela);
+
+// saida[i] = entrada[i] / sensibilidade, com AVX2 quando disponível
+void converter(const int16_t *entrada, float *saida, size_t n, float sensibilidade);
+
+// Indica se converter() usa AVX2; `permitir` = false força o caminho escalar
+bool usar_avx2(bool permitir = true);
+
+class Exportador
+{
+public:
+  virtual ~Exportador() = default;
+  virtual void escrever(const Lote &lote) = 0;
+  virtual void finalizar() = 0;
+};
+
+// CSV no formato do DecodificaDados.py (5 casas para accel, 3 para giro, ou os valores
+// brutos). As linhas de cada lote são formatadas em paralelo e gravadas em ordem
+std::unique_ptr<Exportador> exportar_csv(const std::string &caminho, bool varios, bool bruto, unsigned threads);
+
+// Uma matriz .npy por coluna no diretório (numpy.load(..., mmap_mode="r")): time_ms,
+// sensor (se houver vários), os seis eixos em float32 ou int16 brutos. As colunas de cada
+// lote são gravadas em paralelo
+std::unique_ptr<Exportador> exportar_npy(const std::string &diretorio, uint64_t total, bool varios, bool bruto,
+                                         unsigned threads);
+
+} // namespace imulog
+
+#endif
@@ -0,0 +1,96 @@
+#include "imulog.h"
+
+#include <cstdio>
+#include <filesystem>
+
+namespace imulog
+{
+
+constexpr uint32_t INDICE_MAGICO = 0x58554D49u; // "IMUX", lib/indice.h
+constexpr size_t INDICE_CABECALHO = 16;
+constexpr size_t INDICE_ENTRADA = 16;
+
+static uint32_t ler_u32(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t ler_u64(const uint8_t *p)
+{
+  return ler_u32(p) | ((uint64_t)ler_u32(p + 4) << 32);
+}
+
+// Sessão do primeiro bloco de um log binário; 0 se ele não começar com um bloco
+static uint32_t sessao_do_log(const std::string &log)
+{
+  uint8_t c[8] = {0};
+  FILE *f = fopen(log.c_str(), "rb");
+  if (!f)
+    return 0;
+  size_t lidos = fread(c, 1, sizeof(c), f);
+  fclose(f);
+  return lidos == sizeof(c) && ler_u32(c) == BLOCO_MAGICO ? ler_u32(c + 4) : 0;
+}
+
+std::string caminho_indice(const std::string &log)
+{
+  size_t ponto = log.find_last_of('.');
+  size_t barra = log.find_last_of("/\\");
+  if (ponto == std::string::npos || (barra != std::string::npos && ponto < barra))
+    return log + ".idx";
+  return log.substr(0, ponto) + ".idx";
+}
+
+bool consultar_indice(const std::string &log, uint64_t tamanho_log, bool binario, const Janela &janela,
+                      uint64_t *inicio, uint64_t *fim)
+{
+  std::error_code erro;
+  std::string caminho = caminho_indice(log);
+  if (!std::filesystem::is_regular_file(caminho, erro) || std::filesystem::file_size(caminho, erro) < INDICE_CABECALHO)
+    return false;
+  Mapa mapa(caminho);
+  const uint8_t *d = mapa.dados();
+  if (ler_u32(d) != INDICE_MAGICO || d[4] != 1 || d[5] != 0 || d[6] != (binario ? 1 : 0) || d[7] != 0)
+    return false;
+  // Um índice que sobrou de outra gravação apontaria para posições sem sentido neste log:
+  // no binário a sessão tem de ser a do primeiro bloco; no CSV, que não tem sessão, as
+  // entradas têm de cair nos múltiplos do passo
+  uint32_t passo = ler_u32(d + 8);
+  uint32_t sessao = ler_u32(d + 12);
+  if (passo == 0 || sessao != (binario ? sessao_do_log(log) : 0))
+    return false;
+
+  // Entradas além do fim do log (cortado na recuperação) não valem
+  size_t n = (mapa.tamanho() - INDICE_CABECALHO) / INDICE_ENTRADA;
+  auto entrada = [&](size_t i) { return d + INDICE_CABECALHO + i * INDICE_ENTRADA; };
+  while (n > 0 && ler_u64(entrada(n - 1)) >= tamanho_log)
+    n--;
+  auto no_passo = [&](size_t i) {
+    return binario ? ler_u64(entrada(i)) % ((uint64_t)passo * BLOCO_TAM) == 0 : ler_u32(entrada(i) + 12) % passo == 0;
+  };
+  if (n > 0 && (!no_passo(0) || !no_passo(n - 1)))
+    return false;
+
+  // Primeira entrada com tempo >= x (os tempos crescem ao longo do índice)
+  auto primeira = [&](uint64_t x) {
+    size_t lo = 0, hi = n;
+    while (lo < hi)
+    {
+      size_t meio = lo + (hi - lo) / 2;
+      if (ler_u32(entrada(meio) + 8) < x)
+        lo = meio + 1;
+      else
+        hi = meio;
+    }
+    return lo;
+  };
+  // Começa na última entrada antes de de_ms e termina na primeira depois de ate_ms: as
+  // amostras entre duas entradas têm tempos entre os delas
+  size_t i = primeira(janela.de_ms);
+  *inicio = i > 0 ? ler_u64(entrada(i - 1)) : 0;
+  size_t j = primeira((uint64_t)janela.ate_ms + 1);
+  *fim = j < n ? ler_u64(entrada(j)) : tamanho_log;
+  return true;
+}
+
+} // namespace imulog
@@ -0,0 +1,532 @@
+#include "imulog.h"
+#include "paralelo.h"
+
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+namespace imulog
+{
+
+const char *const NOMES_EIXOS[EIXOS] = {"accel_x", "accel_y", "accel_z", "giro_x", "giro_y", "giro_z"};
+
+void Lote::redimensionar(size_t n, bool com_bruto)
+{
+  tempo_ms.resize(n);
+  sensor.resize(n);
+  for (int e = 0; e < EIXOS; e++)
+  {
+    bruto[e].resize(com_bruto ? n : 0);
+    eixo[e].resize(n);
+  }
+}
+
+// Converte as colunas brutas de [inicio, fim) para unidades físicas
+static void converter_lote(Lote &lote, size_t inicio, size_t fim)
+{
+  for (int e = 0; e < EIXOS; e++)
+  {
+    converter(lote.bruto[e].data() + inicio, lote.eixo[e].data() + inicio, fim - inicio,
+              e < 3 ? SENSIBILIDADE_ACCEL : SENSIBILIDADE_GYRO);
+  }
+}
+
+// ---------------------------------------------------------------------------------------
+// Binário
+
+static uint16_t ler_u16(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t ler_u32(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// CRC-16/XMODEM (polinômio 0x1021, início 0), o mesmo de crc16() no firmware
+static uint16_t crc16(const uint8_t *p, size_t n, uint16_t crc)
+{
+  static const auto tabela = [] {
+    std::array<uint16_t, 256> t{};
+    for (int i = 0; i < 256; i++)
+    {
+      uint16_t c = i << 8;
+      for (int b = 0; b < 8; b++)
+        c = c & 0x8000 ? (c << 1) ^ 0x1021 : c << 1;
+      t[i] = c;
+    }
+    return t;
+  }();
+  for (size_t i = 0; i < n; i++)
+    crc = (crc << 8) ^ tabela[((crc >> 8) ^ p[i]) & 0xFF];
+  return crc;
+}
+
+// Mesmas verificações de bloco_valido(), sem a sessão
+static bool bloco_integro(const uint8_t *b)
+{
+  uint16_t n = ler_u16(b + 12), tam = ler_u16(b + 14);
+  uint8_t canais = b[18] ? b[18] : 1;
+  if (ler_u32(b) != BLOCO_MAGICO || n == 0 || tam < 16 || tam > BLOCO_TAM - 20 || canais > 4 || b[19] >= canais)
+    return false;
+  static const uint8_t zero[2] = {0, 0};
+  uint16_t crc = crc16(b, 16, 0);
+  crc = crc16(zero, 2, crc);
+  crc = crc16(b + 18, BLOCO_TAM - 18, crc);
+  return crc == ler_u16(b + 16);
+}
+
+// Retorna bytes consumidos ou 0 se o varint ultrapassar o fim dos dados
+static int ler_varint(const uint8_t *p, const uint8_t *fim, uint32_t *v)
+{
+  uint32_t valor = 0;
+  for (int n = 0; n < 5 && p + n < fim; n++)
+  {
+    valor |= (uint32_t)(p[n] & 0x7F) << (7 * n);
+    if (!(p[n] & 0x80))
+    {
+      *v = valor;
+      return n + 1;
+    }
+  }
+  return 0;
+}
+
+// Decodifica um bloco íntegro nas posições [pos, pos + n) do lote, como bloco_decodificar().
+// Retorna false se os dados acabarem antes das n amostras; as restantes repetem a última
+static bool decodificar_bloco(const uint8_t *b, Lote &lote, size_t pos)
+{
+  int n = ler_u16(b + 12);
+  const uint8_t *p = b + 20;
+  const uint8_t *fim = p + ler_u16(b + 14);
+  uint8_t canais = b[18] ? b[18] : 1;
+
+  int16_t chave[EIXOS];
+  uint32_t tempo = ler_u32(p);
+  for (int e = 0; e < EIXOS; e++)
+    chave[e] = (int16_t)ler_u16(p + 4 + 2 * e);
+  p += 16;
+
+  int16_t anterior[4][EIXOS];
+  uint8_t vistos = 1u << b[19];
+  memcpy(anterior[b[19]], chave, sizeof(chave));
+  lote.tempo_ms[pos] = tempo;
+  lote.sensor[pos] = b[19];
+  for (int e = 0; e < EIXOS; e++)
+    lote.bruto[e][pos] = chave[e];
+
+  bool ok = true;
+  for (int k = 1; k < n; k++)
+  {
+    uint32_t v;
+    int usados = ok ? ler_varint(p, fim, &v) : 0;
+    uint8_t canal = usados ? v % canais : lote.sensor[pos + k - 1];
+    int16_t *a = anterior[canal];
+    if (usados)
+    {
+      p += usados;
+      if (!((vistos >> canal) & 1))
+        memcpy(a, chave, sizeof(chave));
+      tempo += v / canais;
+      for (int e = 0; e < EIXOS && usados; e++)
+      {
+        usados = ler_varint(p, fim, &v);
+        p += usados;
+        if (usados)
+          a[e] = (int16_t)(a[e] + (int32_t)((v >> 1) ^ -(int32_t)(v & 1)));
+      }
+      vistos |= 1u << canal;
+    }
+    ok = ok && usados;
+    lote.tempo_ms[pos + k] = tempo;
+    lote.sensor[pos + k] = canal;
+    for (int e = 0; e < EIXOS; e++)
+      lote.bruto[e][pos + k] = a[e];
+  }
+  return ok;
+}
+
+class LeitorImu : public Leitor
+{
+public:
+  // [inicio, fim): bytes do arquivo lidos, com um arquivo só (janela pelo índice)
+  LeitorImu(const std::vector<std::string> &arquivos, unsigned faixa, unsigned threads, uint64_t inicio = 0,
+            uint64_t fim = UINT64_MAX)
+      : threads_(threads)
+  {
+    for (auto &a : arquivos)
+      mapas_.push_back(std::make_unique<Mapa>(a));
+    listar_blocos(faixa, inicio, fim);
+
+    // Integridade em paralelo; a gravação termina no primeiro bloco que falhar
+    std::vector<uint8_t> integro(blocos_.size());
+    paralelo(blocos_.size(), threads_, [&](size_t i0, size_t i1) {
+      for (size_t i = i0; i < i1; i++)
+        integro[i] = bloco_integro(blocos_[i]);
+    });
+    size_t validos = 0;
+    uint32_t seq_esperada = 0;
+    for (; validos < blocos_.size(); validos++)
+    {
+      const uint8_t *b = blocos_[validos];
+      if (!integro[validos])
+      {
+        avisos_.push_back("Bloco " + std::to_string(validos) + " inválido, decodificação encerrada");
+        break;
+      }
+      if (validos == 0)
+      {
+        sessao_ = ler_u32(b + 4);
+        varios_ = b[18] > 1;
+        if (inicio > 0)
+          seq_esperada = ler_u32(b + 8);
+      }
+      else if (ler_u32(b + 4) != sessao_)
+      {
+        avisos_.push_back("Bloco " + std::to_string(ler_u32(b + 8)) +
+                          " pertence a outra sessão, decodificação encerrada");
+        break;
+      }
+      uint32_t seq = ler_u32(b + 8);
+      if (seq != seq_esperada)
+      {
+        avisos_.push_back("Aviso: esperado bloco " + std::to_string(seq_esperada) + ", lido " + std::to_string(seq));
+      }
+      seq_esperada = seq + 1;
+      inicio_.push_back(total_);
+      total_ += ler_u16(b + 12);
+    }
+    blocos_.resize(validos);
+    inicio_.push_back(total_);
+    bytes_ = (uint64_t)validos * BLOCO_TAM;
+    bruto_ = true;
+  }
+
+  bool ler(Lote &lote, size_t max) override
+  {
+    if (proximo_ == blocos_.size())
+      return false;
+    // Blocos inteiros até `max` amostras, ao menos um
+    size_t fim = std::upper_bound(inicio_.begin() + proximo_ + 1, inicio_.end(), inicio_[proximo_] + max) -
+                 inicio_.begin() - 1;
+    fim = std::max(fim, proximo_ + 1);
+    uint64_t base = inicio_[proximo_];
+    lote.redimensionar(inicio_[fim] - base, true);
+
+    std::atomic<size_t> corrompidos{0};
+    paralelo(fim - proximo_, threads_, [&](size_t i0, size_t i1) {
+      for (size_t i = proximo_ + i0; i < proximo_ + i1; i++)
+      {
+        if (!decodificar_bloco(blocos_[i], lote, inicio_[i] - base))
+          corrompidos++;
+      }
+      converter_lote(lote, inicio_[proximo_ + i0] - base, inicio_[proximo_ + i1] - base);
+    });
+    if (corrompidos)
+      avisos_.push_back(std::to_string(corrompidos.load()) + " blocos com dados truncados");
+    proximo_ = fim;
+    return true;
+  }
+
+private:
+  // Ordem dos blocos na gravação. Com vários cartões as faixas se alternam entre eles e a
+  // gravação termina na primeira faixa incompleta, como em DecodificaDados.py
+  void listar_blocos(unsigned faixa, uint64_t inicio, uint64_t fim)
+  {
+    if (mapas_.size() == 1)
+    {
+      size_t tam = (size_t)std::min<uint64_t>(fim, mapas_[0]->tamanho());
+      for (size_t off = (size_t)inicio; off + BLOCO_TAM <= tam; off += BLOCO_TAM)
+        blocos_.push_back(mapas_[0]->dados() + off);
+      return;
+    }
+    for (size_t linha = 0;; linha++)
+    {
+      for (auto &m : mapas_)
+      {
+        size_t off = linha * faixa * BLOCO_TAM;
+        size_t n = m->tamanho() > off ? std::min<size_t>(faixa, (m->tamanho() - off) / BLOCO_TAM) : 0;
+        for (size_t i = 0; i < n; i++)
+          blocos_.push_back(m->dados() + off + i * BLOCO_TAM);
+        if (n < faixa)
+          return;
+      }
+    }
+  }
+
+  unsigned threads_;
+  std::vector<std::unique_ptr<Mapa>> mapas_;
+  std::vector<const uint8_t *> blocos_;
+  std::vector<uint64_t> inicio_; // Índice da primeira amostra de cada bloco (+ total no fim)
+  size_t proximo_ = 0;
+  uint32_t sessao_ = 0;
+};
+
+std::unique_ptr<Leitor> abrir_imu(const std::vector<std::string> &arquivos, unsigned faixa, unsigned threads)
+{
+  if (arquivos.empty())
+    throw std::runtime_error("nenhum arquivo de entrada");
+  return std::make_unique<LeitorImu>(arquivos, faixa ? faixa : FAIXA_PADRAO, threads);
+}
+
+// ---------------------------------------------------------------------------------------
+// CSV
+
+constexpr size_t TRECHO_CSV = 4 << 20; // Bytes por trecho, ajustados ao fim de linha
+
+class LeitorCsv : public Leitor
+{
+public:
+  // [inicio, fim): bytes do arquivo lidos depois do cabeçalho, em inícios de linha
+  LeitorCsv(const std::string &arquivo, unsigned threads, uint64_t inicio = 0, uint64_t fim_bytes = UINT64_MAX)
+      : mapa_(arquivo), threads_(threads)
+  {
+    const char *p = (const char *)mapa_.dados();
+    const char *fim = p + mapa_.tamanho();
+    const char *nl = (const char *)memchr(p, '\n', fim - p);
+    std::string cabecalho(p, nl ? nl : fim);
+    if (!cabecalho.empty() && cabecalho.back() == '\r')
+      cabecalho.pop_back();
+    std::string esperado = "time_ms,";
+    for (int e = 0; e < EIXOS; e++)
+      esperado += std::string(NOMES_EIXOS[e]) + (e < EIXOS - 1 ? "," : "");
+    if (cabecalho == esperado)
+      varios_ = false;
+    else if (cabecalho == "time_ms,sensor," + esperado.substr(8))
+      varios_ = true;
+    else
+      throw std::runtime_error(arquivo + ": cabeçalho não reconhecido: " + cabecalho);
+
+    // Trechos terminados em fim de linha; as linhas de cada um são contadas em paralelo
+    const char *t = nl ? nl + 1 : fim;
+    t = std::max(t, p + std::min<uint64_t>(inicio, mapa_.tamanho()));
+    fim = std::min(fim, p + std::min<uint64_t>(fim_bytes, mapa_.tamanho()));
+    bytes_ = (nl ? nl + 1 - p : 0) + (t < fim ? fim - t : 0);
+    while (t < fim)
+    {
+      const char *q = std::min(t + TRECHO_CSV, fim);
+      if (q < fim)
+      {
+        const char *n2 = (const char *)memchr(q, '\n', fim - q);
+        q = n2 ? n2 + 1 : fim;
+      }
+      trechos_.push_back({t, q});
+      t = q;
+    }
+    std::vector<uint64_t> linhas(trechos_.size());
+    paralelo(trechos_.size(), threads_, [&](size_t i0, size_t i1) {
+      for (size_t i = i0; i < i1; i++)
+        linhas[i] = contar_linhas(trechos_[i].first, trechos_[i].second);
+    });
+    for (size_t i = 0; i < trechos_.size(); i++)
+    {
+      inicio_.push_back(total_);
+      total_ += linhas[i];
+    }
+    inicio_.push_back(total_);
+  }
+
+  bool ler(Lote &lote, size_t max) override
+  {
+    if (proximo_ == trechos_.size())
+      return false;
+    size_t fim = std::upper_bound(inicio_.begin() + proximo_ + 1, inicio_.end(), inicio_[proximo_] + max) -
+                 inicio_.begin() - 1;
+    fim = std::max(fim, proximo_ + 1);
+    uint64_t base = inicio_[proximo_];
+    lote.redimensionar(inicio_[fim] - base, false);
+
+    std::atomic<size_t> ruins{0};
+    paralelo(fim - proximo_, threads_, [&](size_t i0, size_t i1) {
+      for (size_t i = proximo_ + i0; i < proximo_ + i1; i++)
+        ruins += interpretar(trechos_[i].first, trechos_[i].second, lote, inicio_[i] - base);
+    });
+    if (ruins)
+      avisos_.push_back(std::to_string(ruins.load()) + " linhas mal formadas (gravadas como zero)");
+    proximo_ = fim;
+    return true;
+  }
+
+private:
+  // Linhas não vazias (a última pode não ter '\n')
+  static uint64_t contar_linhas(const char *p, const char *fim)
+  {
+    uint64_t n = 0;
+    while (p < fim)
+    {
+      const char *nl = (const char *)memchr(p, '\n', fim - p);
+      const char *q = nl ? nl : fim;
+      if (q > p && !(q == p + 1 && *p == '\r'))
+        n++;
+      p = q + 1;
+    }
+    return n;
+  }
+
+  // Retorna o número de linhas mal formadas
+  size_t interpretar(const char *p, const char *fim, Lote &lote, size_t pos) const
+  {
+    size_t ruins = 0;
+    while (p < fim)
+    {
+      const char *nl = (const char *)memchr(p, '\n', fim - p);
+      const char *q = nl ? nl : fim;
+      if (q > p && q[-1] == '\r')
+        q--;
+      if (q > p)
+      {
+        ruins += !interpretar_linha(p, q, lote, pos);
+        pos++;
+      }
+      p = (nl ? nl : fim) + 1;
+    }
+    return ruins;
+  }
+
+  bool interpretar_linha(const char *p, const char *fim, Lote &lote, size_t pos) const
+  {
+    auto campo = [&](auto &valor) {
+      auto r = std::from_chars(p, fim, valor);
+      if (r.ec != std::errc())
+        return false;
+      p = r.ptr;
+      if (p < fim && *p == ',')
+        p++;
+      return true;
+    };
+    uint32_t tempo = 0;
+    unsigned sensor = 0;
+    bool ok = campo(tempo) && (!varios_ || campo(sensor));
+    lote.tempo_ms[pos] = tempo;
+    lote.sensor[pos] = (uint8_t)sensor;
+    for (int e = 0; e < EIXOS; e++)
+    {
+      float v = 0;
+      ok = ok && campo(v);
+      lote.eixo[e][pos] = ok ? v : 0;
+    }
+    return ok;
+  }
+
+  Mapa mapa_;
+  unsigned threads_;
+  std::vector<std::pair<const char *, const char *>> trechos_;
+  std::vector<uint64_t> inicio_;
+  size_t proximo_ = 0;
+};
+
+std::unique_ptr<Leitor> abrir_csv(const std::string &arquivo, unsigned threads)
+{
+  return std::make_unique<LeitorCsv>(arquivo, threads);
+}
+
+static bool eh_csv(const std::vector<std::string> &arquivos)
+{
+  const std::string &a = arquivos[0];
+  return arquivos.size() == 1 && a.size() >= 4 &&
+         (a.compare(a.size() - 4, 4, ".csv") == 0 || a.compare(a.size() - 4, 4, ".CSV") == 0);
+}
+
+std::unique_ptr<Leitor> abrir(const std::vector<std::string> &arquivos, unsigned faixa, unsigned threads)
+{
+  if (!arquivos.empty() && eh_csv(arquivos))
+    return abrir_csv(arquivos[0], threads);
+  return abrir_imu(arquivos, faixa, threads);
+}
+
+// ---------------------------------------------------------------------------------------
+// Janela de tempo
+
+// Deixa passar só as amostras da janela; para na primeira depois dela, já que os tempos
+// crescem ao longo da gravação
+class LeitorJanela : public Leitor
+{
+public:
+  LeitorJanela(std::unique_ptr<Leitor> leitor, const Janela &janela) : leitor_(std::move(leitor)), janela_(janela)
+  {
+    total_ = leitor_->total();
+    bytes_ = leitor_->bytes();
+    varios_ = leitor_->varios_sensores();
+    bruto_ = leitor_->tem_bruto();
+    avisos_ = leitor_->avisos();
+  }
+
+  bool ler(Lote &lote, size_t max) override
+  {
+    while (!terminado_)
+    {
+      bool ok = leitor_->ler(lote, max);
+      avisos_ = leitor_->avisos();
+      if (!ok)
+        break;
+      if (filtrar(lote))
+        return true;
+    }
+    return false;
+  }
+
+private:
+  // Compacta o lote nas amostras da janela; retorna se sobrou alguma
+  bool filtrar(Lote &lote)
+  {
+    size_t n = 0;
+    bool bruto = !lote.bruto[0].empty();
+    for (size_t i = 0; i < lote.tamanho(); i++)
+    {
+      uint32_t t = lote.tempo_ms[i];
+      if (t > janela_.ate_ms)
+      {
+        terminado_ = true;
+        break;
+      }
+      if (t < janela_.de_ms)
+        continue;
+      if (n != i)
+      {
+        lote.tempo_ms[n] = t;
+        lote.sensor[n] = lote.sensor[i];
+        for (int e = 0; e < EIXOS; e++)
+        {
+          if (bruto)
+            lote.bruto[e][n] = lote.bruto[e][i];
+          lote.eixo[e][n] = lote.eixo[e][i];
+        }
+      }
+      n++;
+    }
+    lote.redimensionar(n, bruto);
+    return n > 0;
+  }
+
+  std::unique_ptr<Leitor> leitor_;
+  Janela janela_;
+  bool terminado_ = false;
+};
+
+std::unique_ptr<Leitor> abrir(const std::vector<std::string> &arquivos, unsigned faixa, unsigned threads,
+                              const Janela &janela)
+{
+  if (janela.inteira())
+    return abrir(arquivos, faixa, threads);
+  std::unique_ptr<Leitor> leitor;
+  uint64_t inicio, fim;
+  std::error_code erro;
+  uint64_t tamanho = arquivos.size() == 1 ? std::filesystem::file_size(arquivos[0], erro) : 0;
+  bool csv = !arquivos.empty() && eh_csv(arquivos);
+  if (arquivos.size() == 1 && !erro && consultar_indice(arquivos[0], tamanho, !csv, janela, &inicio, &fim))
+  {
+    if (csv)
+      leitor = std::make_unique<LeitorCsv>(arquivos[0], threads, inicio, fim);
+    else
+      leitor = std::make_unique<LeitorImu>(arquivos, faixa ? faixa : FAIXA_PADRAO, threads, inicio, fim);
+  }
+  else
+    leitor = abrir(arquivos, faixa, threads);
+  return std::make_unique<LeitorJanela>(std::move(leitor), janela);
+}
+
+} // namespace imulog
@@ -0,0 +1,119 @@
+#include "imulog.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+// Converte gravações do datalogger (.imu ou .csv) para CSV ou matrizes .npy.
+// Uso: imulog entrada.imu [entrada_cartao1.imu] [-o saida.csv | --npy diretorio]
+//             [--bruto] [--de=MS] [--ate=MS] [--faixa=N] [--threads=N] [--escalar]
+
+static void uso()
+{
+  fprintf(stderr, "Uso: imulog entrada.imu [entrada_cartao1.imu] [-o saida.csv | --npy diretorio]\n"
+                  "              [--bruto] [--de=MS] [--ate=MS] [--faixa=N] [--threads=N] [--escalar]\n"
+                  "  --bruto      valores int16 do sensor em vez de g e °/s (só do binário)\n"
+                  "  --de, --ate  só as amostras nessa janela de tempo; com o índice .idx gravado\n"
+                  "               pelo dispositivo, só o trecho do log que a cobre é lido\n"
+                  "  --faixa=N    setores por faixa no RAID-0 (padrão %u)\n"
+                  "  --threads=N  threads de decodificação e formatação (padrão: núcleos)\n"
+                  "  --escalar    desativa a conversão com AVX2\n",
+          imulog::FAIXA_PADRAO);
+}
+
+static bool comeca(const char *a, const char *prefixo)
+{
+  return strncmp(a, prefixo, strlen(prefixo)) == 0;
+}
+
+int main(int argc, char **argv)
+{
+  std::vector<std::string> entradas;
+  std::string saida, npy;
+  bool bruto = false, escalar = false;
+  unsigned faixa = imulog::FAIXA_PADRAO;
+  unsigned threads = std::max(std::thread::hardware_concurrency(), 1u);
+  imulog::Janela janela;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char *a = argv[i];
+    if (!strcmp(a, "-o") && i + 1 < argc)
+      saida = argv[++i];
+    else if (!strcmp(a, "--npy") && i + 1 < argc)
+      npy = argv[++i];
+    else if (!strcmp(a, "--bruto"))
+      bruto = true;
+    else if (comeca(a, "--faixa="))
+      faixa = (unsigned)atoi(a + 8);
+    else if (comeca(a, "--threads="))
+      threads = std::max(atoi(a + 10), 1);
+    else if (comeca(a, "--de="))
+      janela.de_ms = (uint32_t)strtoul(a + 5, nullptr, 10);
+    else if (comeca(a, "--ate="))
+      janela.ate_ms = (uint32_t)strtoul(a + 6, nullptr, 10);
+    else if (!strcmp(a, "--escalar"))
+      escalar = true;
+    else if (a[0] == '-')
+    {
+      uso();
+      return 1;
+    }
+    else
+      entradas.push_back(a);
+  }
+  if (entradas.empty())
+  {
+    uso();
+    return 1;
+  }
+  if (saida.empty() && npy.empty())
+  {
+    const std::string &e = entradas[0];
+    size_t ponto = e.find_last_of('.');
+    saida = (ponto == std::string::npos || ponto < e.find_last_of('/') + 1 ? e : e.substr(0, ponto)) + ".csv";
+    if (saida == e)
+      saida += ".csv";
+  }
+
+  bool avx2 = imulog::usar_avx2(!escalar);
+  try
+  {
+    auto inicio = std::chrono::steady_clock::now();
+    auto leitor = imulog::abrir(entradas, faixa, threads, janela);
+    if (bruto && !leitor->tem_bruto())
+      throw std::runtime_error("--bruto só vale para gravações binárias");
+    auto exportador = npy.empty()
+                          ? imulog::exportar_csv(saida, leitor->varios_sensores(), bruto, threads)
+                          : imulog::exportar_npy(npy, leitor->total(), leitor->varios_sensores(), bruto, threads);
+
+    imulog::Lote lote;
+    uint64_t amostras = 0;
+    size_t avisos = 0;
+    while (leitor->ler(lote, imulog::LOTE_PADRAO))
+    {
+      exportador->escrever(lote);
+      amostras += lote.tamanho();
+      for (; avisos < leitor->avisos().size(); avisos++)
+        printf("%s\n", leitor->avisos()[avisos].c_str());
+    }
+    exportador->finalizar();
+    for (; avisos < leitor->avisos().size(); avisos++)
+      printf("%s\n", leitor->avisos()[avisos].c_str());
+
+    double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - inicio).count();
+    printf("%llu amostras em %s: %.2f s, %.1f MB/s de entrada (%u threads, conversão %s)\n",
+           (unsigned long long)amostras, npy.empty() ? saida.c_str() : npy.c_str(), s,
+           leitor->bytes() / 1e6 / (s > 0 ? s : 1), threads, avx2 ? "AVX2" : "escalar");
+  }
+  catch (const std::exception &e)
+  {
+    fprintf(stderr, "Erro: %s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,85 @@
+#include "imulog.h"
+
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace imulog
+{
+
+#ifdef _WIN32
+Mapa::Mapa(const std::string &caminho)
+{
+  arquivo_ = CreateFileA(caminho.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                         FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+  if (arquivo_ == INVALID_HANDLE_VALUE)
+    throw std::runtime_error("não foi possível abrir " + caminho);
+  LARGE_INTEGER tam;
+  GetFileSizeEx(arquivo_, &tam);
+  tamanho_ = (size_t)tam.QuadPart;
+  if (tamanho_ == 0)
+    return;
+  mapeamento_ = CreateFileMappingA(arquivo_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapeamento_)
+    dados_ = (const uint8_t *)MapViewOfFile(mapeamento_, FILE_MAP_READ, 0, 0, 0);
+  if (!dados_)
+  {
+    if (mapeamento_)
+      CloseHandle(mapeamento_);
+    CloseHandle(arquivo_);
+    throw std::runtime_error("não foi possível mapear " + caminho);
+  }
+}
+
+Mapa::~Mapa()
+{
+  if (dados_)
+    UnmapViewOfFile(dados_);
+  if (mapeamento_)
+    CloseHandle(mapeamento_);
+  if (arquivo_ && arquivo_ != INVALID_HANDLE_VALUE)
+    CloseHandle(arquivo_);
+}
+#else
+Mapa::Mapa(const std::string &caminho)
+{
+  int fd = open(caminho.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("não foi possível abrir " + caminho);
+  struct stat st;
+  if (fstat(fd, &st) != 0)
+  {
+    close(fd);
+    throw std::runtime_error("não foi possível consultar " + caminho);
+  }
+  tamanho_ = (size_t)st.st_size;
+  if (tamanho_)
+  {
+    void *p = mmap(nullptr, tamanho_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED)
+    {
+      close(fd);
+      throw std::runtime_error("não foi possível mapear " + caminho);
+    }
+    // A leitura é sequencial: o kernel lê adiante e descarta as páginas já usadas
+    madvise(p, tamanho_, MADV_SEQUENTIAL);
+    dados_ = (const uint8_t *)p;
+  }
+  close(fd); // O mapeamento continua válido sem o descritor
+}
+
+Mapa::~Mapa()
+{
+  if (dados_)
+    munmap((void *)dados_, tamanho_);
+}
+#endif
+
+} // namespace imulog
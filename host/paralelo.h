@@ -0,0 +1,52 @@
+#ifndef PARALELO_H
+#define PARALELO_H
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace imulog
+{
+
+// Divide [0, n) em até `threads` intervalos contíguos e chama f(inicio, fim) em cada um,
+// em paralelo. Os lotes são grandes, então criar as threads a cada chamada custa pouco.
+// Uma exceção lançada em qualquer intervalo é repassada a quem chamou
+template <class F>
+void paralelo(size_t n, unsigned threads, F &&f)
+{
+  size_t partes = std::min<size_t>(std::max(threads, 1u), n);
+  if (partes <= 1)
+  {
+    if (n)
+      f(size_t(0), n);
+    return;
+  }
+  std::vector<std::thread> ts;
+  std::vector<std::exception_ptr> erros(partes);
+  for (size_t p = 0; p < partes; p++)
+  {
+    ts.emplace_back([&, p] {
+      try
+      {
+        f(n * p / partes, n * (p + 1) / partes);
+      }
+      catch (...)
+      {
+        erros[p] = std::current_exception();
+      }
+    });
+  }
+  for (auto &t : ts)
+    t.join();
+  for (auto &e : erros)
+  {
+    if (e)
+      std::rethrow_exception(e);
+  }
+}
+
+} // namespace imulog
+
+#endif
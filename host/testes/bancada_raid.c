@@ -0,0 +1,232 @@
+// raid.c sobre dois cartões emulados (cartao_emulado.c), com glue.c e FatFs
+// reais. Cada sessão grava amostras sintéticas comprimidas e confere, lendo os
+// arquivos pelo FatFs setor a setor, que todas as amostras voltam iguais:
+//   - faixas (RAID-0): os dois arquivos intercalados reconstituem a gravação;
+//   - espelho com cartões iguais: vazão perto da de um cartão só;
+//   - espelho com um cartão que para 120 ms a cada 16 escritas, a 250 KB/s:
+//     atraso máximo do produtor com anel de 64 setores contra 8;
+//   - falha no CMD13 e um cartão travado por 3 s: o cartão é descartado e a
+//     cópia que sobra tem a gravação inteira.
+// Antes de cada sessão um arquivo é gravado e apagado nos mesmos setores, e o
+// cache de glue.c fica com cópias deles: sem a invalidação de raid.c a leitura
+// devolveria os dados antigos.
+#include <stdio.h>
+#include <string.h>
+
+#include "cartao_emulado.h"
+#include "compressao.h"
+#include "ff.h"
+#include "raid.h"
+
+#define SETORES_CARTAO (64u * 1024 * 2) // 64 MB
+#define MEMBRO_BYTES (8u << 20)
+#define FAIXA 8
+#define AMOSTRAS 200000
+#define SESSAO 0x5eed
+
+static const perfil_cartao_t NORMAL = {410, 30, 900, 0, 0, 0};
+static const perfil_cartao_t COM_GC = {410, 60, 2500, 16, 120000, 0};
+static const perfil_cartao_t TRAVADO = {410, 60, 2500, 16, 3000000, 0};
+static const perfil_cartao_t FALHA = {410, 30, 900, 0, 0, 40};
+
+static FATFS volumes[RAID_MEMBERS];
+static uint8_t anel[64 * FF_MAX_SS];
+
+typedef struct
+{
+  uint32_t blocos;
+  double kb_s;
+  double atraso_max_ms;
+  size_t ativos;
+  FRESULT fechamento;
+} resultado_t;
+
+static amostra_t amostra(uint32_t i)
+{
+  amostra_t a = {i * 2, {(int16_t)(i % 300), -5, 16000}, {(int16_t)(i * 3), 1, -2}, 0};
+  return a;
+}
+
+static int iguais(const amostra_t *a, const amostra_t *b)
+{
+  return a->tempo_ms == b->tempo_ms && !memcmp(a->accel, b->accel, sizeof a->accel) &&
+         !memcmp(a->gyro, b->gyro, sizeof a->gyro);
+}
+
+// Cartões novos, formatados, com um arquivo apagado ainda no cache de glue.c
+static int preparar(const perfil_cartao_t *p0, const perfil_cartao_t *p1)
+{
+  static BYTE trabalho[4096];
+  // Clusters de 32 KB: a FAT de um arquivo ocupa poucos setores e não tira do
+  // cache os do arquivo apagado
+  MKFS_PARM opcoes = {FM_ANY, 0, 0, 0, 32768};
+  const perfil_cartao_t *perfis[RAID_MEMBERS] = {p0, p1};
+  for (size_t m = 0; m < RAID_MEMBERS; m++)
+    cartao_emulado_criar(m, SETORES_CARTAO, 8192, 10, 1, perfis[m]);
+  for (size_t m = 0; m < RAID_MEMBERS; m++)
+  {
+    char vol[4], nome[16];
+    snprintf(vol, sizeof vol, "%u:", (unsigned)m);
+    snprintf(nome, sizeof nome, "%svelho.bin", vol);
+    if (f_mkfs(vol, &opcoes, trabalho, sizeof trabalho) != FR_OK ||
+        f_mount(&volumes[m], vol, 1) != FR_OK)
+      return 0;
+    FIL f;
+    uint8_t setor[FF_MAX_SS];
+    memset(setor, 0xA5, sizeof setor);
+    if (f_open(&f, nome, FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+      return 0;
+    for (int i = 0; i < 8; i++)
+    {
+      UINT bw;
+      f_write(&f, setor, sizeof setor, &bw);
+    }
+    // Remontado, o FatFs volta a alocar do começo, sobre o arquivo apagado
+    if (f_close(&f) != FR_OK || f_unlink(nome) != FR_OK || f_mount(&volumes[m], vol, 1) != FR_OK)
+      return 0;
+  }
+  return 1;
+}
+
+// Grava AMOSTRAS, um bloco a cada periodo_us (0: o mais rápido possível),
+// chamando raid_task() enquanto espera, como o laço principal
+static int gravar(raid_mode_t modo, uint32_t anel_setores, uint32_t periodo_us,
+                  resultado_t *res)
+{
+  raid_t r;
+  memset(res, 0, sizeof *res);
+  if (raid_open(&r, "mpu_data.imu", modo, MEMBRO_BYTES, FAIXA, anel, anel_setores) != FR_OK)
+    return 0;
+  compressor_t c;
+  compressor_init(&c, SESSAO, 1);
+  uint64_t inicio = relogio_us;
+  int64_t atraso_max = 0;
+  for (uint32_t i = 0; i <= AMOSTRAS; i++)
+  {
+    amostra_t a = amostra(i);
+    const uint8_t *bloco = i < AMOSTRAS ? compressor_adicionar(&c, &a) : compressor_finalizar(&c);
+    if (!bloco)
+      continue;
+    uint64_t previsto = inicio + (uint64_t)res->blocos * periodo_us;
+    while (relogio_us < previsto)
+    {
+      raid_task(&r);
+      relogio_us += 50;
+    }
+    if ((int64_t)(relogio_us - previsto) > atraso_max)
+      atraso_max = (int64_t)(relogio_us - previsto);
+    if (raid_write(&r, bloco) != SD_BLOCK_DEVICE_ERROR_NONE)
+      return 0;
+    res->blocos++;
+  }
+  uint64_t fim = relogio_us;
+  res->fechamento = raid_close(&r);
+  res->ativos = raid_members_active(&r);
+  res->kb_s = res->blocos * (double)BLOCO_TAM / 1024 / ((fim - inicio) / 1e6);
+  res->atraso_max_ms = atraso_max / 1000.0;
+  return 1;
+}
+
+// Confere os blocos de membros arquivos intercalados em faixas de FAIXA
+// setores (um arquivo só: uma cópia do espelho). Devolve as amostras que
+// conferem, em ordem, desde a primeira.
+static uint32_t conferir(const char *const *caminhos, size_t membros)
+{
+  FIL f[RAID_MEMBERS];
+  for (size_t m = 0; m < membros; m++)
+    if (f_open(&f[m], caminhos[m], FA_READ) != FR_OK)
+      return 0;
+  uint32_t conferidas = 0, seq = 0;
+  int fim = 0;
+  while (!fim)
+  {
+    for (size_t m = 0; m < membros && !fim; m++)
+      for (int s = 0; s < FAIXA && !fim; s++)
+      {
+        uint8_t bloco[BLOCO_TAM];
+        amostra_t saida[BLOCO_MAX_AMOSTRAS];
+        UINT lidos;
+        if (f_read(&f[m], bloco, sizeof bloco, &lidos) != FR_OK || lidos != sizeof bloco ||
+            !bloco_valido(bloco, SESSAO) || bloco_seq(bloco) != seq++)
+        {
+          fim = 1;
+          break;
+        }
+        int n = bloco_decodificar(bloco, saida, BLOCO_MAX_AMOSTRAS);
+        for (int k = 0; k < n; k++)
+        {
+          amostra_t esperada = amostra(conferidas);
+          if (!iguais(&saida[k], &esperada))
+          {
+            fim = 1;
+            break;
+          }
+          conferidas++;
+        }
+      }
+  }
+  for (size_t m = 0; m < membros; m++)
+    f_close(&f[m]);
+  return conferidas;
+}
+
+static const char *const MEMBRO_0[] = {"0:mpu_data.imu"};
+static const char *const MEMBRO_1[] = {"1:mpu_data.imu"};
+static const char *const FAIXAS[] = {"0:mpu_data.imu", "1:mpu_data.imu"};
+
+static int falhas;
+
+static void verificar(int ok, const char *o_que)
+{
+  if (!ok)
+  {
+    printf("  FALHOU: %s\n", o_que);
+    falhas++;
+  }
+}
+
+int main(void)
+{
+  resultado_t faixas, unico, espelho, anel_64, anel_8, falha, travado;
+
+  verificar(preparar(&NORMAL, &NORMAL) && gravar(RAID_STRIPE, 2 * FAIXA, 0, &faixas),
+            "gravação em faixas");
+  uint32_t n = conferir(FAIXAS, 2);
+  printf("faixas: %u blocos, %.0f KB/s, %u blocos sobrepostos, %u amostras conferidas\n",
+         faixas.blocos, faixas.kb_s, cartao_emulado_sobrepostos(), n);
+  verificar(faixas.fechamento == FR_OK && n == AMOSTRAS, "faixas reconstituídas");
+  verificar(cartao_emulado_sobrepostos() > faixas.blocos / 4, "blocos sobrepostos nos dois SPIs");
+
+  // Um cartão instantâneo ao lado dá a vazão de um cartão só
+  verificar(preparar(&NORMAL, NULL) && gravar(RAID_MIRROR, 64, 0, &unico), "um cartão");
+  verificar(preparar(&NORMAL, &NORMAL) && gravar(RAID_MIRROR, 64, 0, &espelho), "espelho");
+  uint32_t n0 = conferir(MEMBRO_0, 1), n1 = conferir(MEMBRO_1, 1);
+  printf("espelho: %.0f KB/s, um cartão: %.0f KB/s, %u e %u amostras conferidas\n",
+         espelho.kb_s, unico.kb_s, n0, n1);
+  verificar(espelho.kb_s > 0.95 * unico.kb_s, "vazão do espelho");
+  verificar(espelho.ativos == 2 && n0 == AMOSTRAS && n1 == AMOSTRAS, "cópias do espelho");
+
+  // 250 KB/s: um bloco a cada 2048 µs
+  verificar(preparar(&NORMAL, &COM_GC) && gravar(RAID_MIRROR, 64, 2048, &anel_64), "anel de 64");
+  n1 = conferir(MEMBRO_1, 1);
+  verificar(preparar(&NORMAL, &COM_GC) && gravar(RAID_MIRROR, 8, 2048, &anel_8), "anel de 8");
+  printf("coleta de lixo de 120 ms: atraso máximo %.1f ms com anel de 64, %.1f ms com 8\n",
+         anel_64.atraso_max_ms, anel_8.atraso_max_ms);
+  verificar(anel_64.atraso_max_ms < 20 && anel_8.atraso_max_ms > 60, "atraso com coleta de lixo");
+  verificar(anel_64.ativos == 2 && n1 == AMOSTRAS, "cartão lento acompanha");
+
+  verificar(preparar(&NORMAL, &FALHA) && gravar(RAID_MIRROR, 64, 2048, &falha), "falha no CMD13");
+  n0 = conferir(MEMBRO_0, 1);
+  printf("falha no CMD13: %zu cartão ativo, %u amostras conferidas\n", falha.ativos, n0);
+  verificar(falha.ativos == 1 && falha.fechamento == FR_OK && n0 == AMOSTRAS,
+            "descarte por falha");
+
+  verificar(preparar(&NORMAL, &TRAVADO) && gravar(RAID_MIRROR, 64, 2048, &travado),
+            "cartão travado");
+  n0 = conferir(MEMBRO_0, 1);
+  printf("cartão travado 3 s: %zu cartão ativo, %u amostras conferidas\n", travado.ativos, n0);
+  verificar(travado.ativos == 1 && travado.fechamento == FR_OK && n0 == AMOSTRAS,
+            "descarte por travamento");
+
+  return falhas ? 1 : 0;
+}
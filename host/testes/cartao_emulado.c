@@ -0,0 +1,249 @@
+#define _FILE_OFFSET_BITS 64
+#include "cartao_emulado.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "pico/stdlib.h"
+
+#include "diskio.h"
+#include "hw_config.h"
+#include "my_debug.h"
+
+uint64_t relogio_us;
+
+typedef struct
+{
+  FILE *imagem;
+  perfil_cartao_t perfil;
+  uint64_t ocupado_ate; // Programando até este instante
+  uint64_t dma_ate;     // Bloco em voo no SPI até este instante
+  uint64_t setor;       // Próximo setor da escrita em stream
+  const uint8_t *em_voo;
+  uint32_t escritas;
+} emulado_t;
+
+static emulado_t emulados[CARTOES_EMULADOS];
+static sd_card_t cartoes[CARTOES_EMULADOS] = {{.pcName = "0:"}, {.pcName = "1:"}};
+static size_t usados;
+static uint32_t sobrepostos;
+
+static emulado_t *de(sd_card_t *p)
+{
+  return &emulados[p - cartoes];
+}
+
+static void esperar(emulado_t *e)
+{
+  if (relogio_us < e->ocupado_ate)
+    relogio_us = e->ocupado_ate;
+}
+
+static int iniciar(sd_card_t *p)
+{
+  p->m_Status = de(p)->imagem ? 0 : STA_NOINIT | STA_NODISK;
+  return p->m_Status;
+}
+
+static int ler(sd_card_t *p, uint8_t *buf, uint64_t setor, uint32_t n)
+{
+  emulado_t *e = de(p);
+  if (setor + n > p->sectors || fseeko(e->imagem, (off_t)setor * 512, SEEK_SET) ||
+      fread(buf, 512, n, e->imagem) != n)
+    return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+  return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+
+static int gravar(sd_card_t *p, const uint8_t *buf, uint64_t setor, uint32_t n)
+{
+  emulado_t *e = de(p);
+  if (setor + n > p->sectors || fseeko(e->imagem, (off_t)setor * 512, SEEK_SET) ||
+      fwrite(buf, 512, n, e->imagem) != n)
+    return SD_BLOCK_DEVICE_ERROR_WRITE;
+  return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+
+void cartao_emulado_criar(size_t n, uint64_t setores, uint32_t au_setores,
+                          uint8_t classe, uint8_t uhs, const perfil_cartao_t *perfil)
+{
+  emulado_t *e = &emulados[n];
+  if (e->imagem)
+    fclose(e->imagem);
+  memset(e, 0, sizeof *e);
+  e->imagem = tmpfile();
+  if (!e->imagem || ftruncate(fileno(e->imagem), (off_t)setores * 512))
+  {
+    perror("cartao_emulado_criar");
+    exit(1);
+  }
+  if (perfil)
+    e->perfil = *perfil;
+
+  sd_card_t *p = &cartoes[n];
+  p->m_Status = STA_NOINIT;
+  p->sectors = setores;
+  p->au_sectors = au_setores;
+  p->speed_class = classe;
+  p->uhs_speed_grade = uhs;
+  p->mounted = false;
+  p->stream_blocks = 0;
+  p->init = iniciar;
+  p->read_blocks = ler;
+  p->write_blocks = gravar;
+  if (n >= usados)
+    usados = n + 1;
+}
+
+uint32_t cartao_emulado_escritas(size_t n)
+{
+  return emulados[n].escritas;
+}
+
+uint32_t cartao_emulado_sobrepostos(void)
+{
+  return sobrepostos;
+}
+
+// hw_config.h
+
+size_t sd_get_num()
+{
+  return usados;
+}
+
+sd_card_t *sd_get_by_num(size_t num)
+{
+  return num < usados ? &cartoes[num] : NULL;
+}
+
+// sd_card.h
+
+bool sd_init_driver()
+{
+  return true;
+}
+
+uint64_t sd_sectors(sd_card_t *pSD)
+{
+  return pSD->sectors;
+}
+
+int sd_read_status(sd_card_t *pSD, uint8_t status[64])
+{
+  (void)pSD;
+  (void)status;
+  return SD_BLOCK_DEVICE_ERROR_UNSUPPORTED; // Os campos já estão em sd_card_t
+}
+
+bool sd_card_ready(sd_card_t *pSD)
+{
+  relogio_us += 3; // Um byte de CMD13 no SPI
+  return relogio_us >= de(pSD)->ocupado_ate;
+}
+
+int sd_write_stream_begin(sd_card_t *pSD, uint64_t ulSectorNumber, uint32_t blockCnt)
+{
+  emulado_t *e = de(pSD);
+  esperar(e);
+  relogio_us += 60; // ACMD23 + CMD25
+  if (ulSectorNumber + blockCnt > pSD->sectors)
+    return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+  e->setor = ulSectorNumber;
+  pSD->stream_blocks = blockCnt;
+  e->escritas++;
+  return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+
+int sd_write_stream_block_start(sd_card_t *pSD, const uint8_t *buffer)
+{
+  emulado_t *e = de(pSD);
+  if (e->em_voo || !pSD->stream_blocks)
+    abort(); // Uso errado da API, como no firmware (myASSERT)
+  esperar(e);
+  relogio_us += 2;
+  for (size_t i = 0; i < usados; i++)
+    if (emulados[i].em_voo)
+    {
+      sobrepostos++;
+      break;
+    }
+  e->em_voo = buffer;
+  e->dma_ate = relogio_us + e->perfil.transferencia_us;
+  return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+
+int sd_write_stream_block_finish(sd_card_t *pSD)
+{
+  emulado_t *e = de(pSD);
+  if (relogio_us < e->dma_ate)
+    relogio_us = e->dma_ate;
+  relogio_us += 5; // Data response
+  int rc = gravar(pSD, e->em_voo, e->setor, 1);
+  e->setor++;
+  e->em_voo = NULL;
+  pSD->stream_blocks--;
+  e->ocupado_ate = relogio_us + e->perfil.bloco_us;
+  return rc;
+}
+
+int sd_write_stream_end(sd_card_t *pSD)
+{
+  int rc = pSD->stream_blocks ? SD_BLOCK_DEVICE_ERROR_WRITE : SD_BLOCK_DEVICE_ERROR_NONE;
+  pSD->stream_blocks = 0;
+  emulado_t *e = de(pSD);
+  relogio_us += 2; // Stop tran token, e espera o cartão
+  e->ocupado_ate = relogio_us + e->perfil.parada_us;
+  esperar(e);
+  return rc;
+}
+
+void sd_write_stream_stop(sd_card_t *pSD)
+{
+  emulado_t *e = de(pSD);
+  relogio_us += 2; // Stop tran token
+  e->ocupado_ate = relogio_us + e->perfil.parada_us;
+  if (e->perfil.gc_cada && e->escritas % e->perfil.gc_cada == 0)
+    e->ocupado_ate += e->perfil.gc_us;
+}
+
+int sd_write_stream_status(sd_card_t *pSD)
+{
+  emulado_t *e = de(pSD);
+  esperar(e);
+  relogio_us += 40; // CMD13
+  if (e->perfil.falha_apos && e->escritas > e->perfil.falha_apos)
+    return SD_BLOCK_DEVICE_ERROR_WRITE;
+  return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+
+// pico/stdlib.h
+
+absolute_time_t get_absolute_time(void)
+{
+  return relogio_us;
+}
+
+absolute_time_t make_timeout_time_ms(uint32_t ms)
+{
+  return relogio_us + ms * 1000ull;
+}
+
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to)
+{
+  return (int64_t)(to - from);
+}
+
+// my_debug.h e rtc.c
+
+void my_printf(const char *pcFormat, ...)
+{
+  (void)pcFormat;
+}
+
+DWORD get_fattime(void)
+{
+  return ((DWORD)(2024 - 1980) << 25) | (1 << 21) | (1 << 16);
+}
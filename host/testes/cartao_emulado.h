@@ -0,0 +1,39 @@
+// Cartões SD emulados para os testes de lib/FatFs_SPI no computador. Cada um
+// guarda os setores num arquivo temporário esparso e implementa o que
+// sd_card.h e hw_config.h oferecem ao resto do firmware, de modo que glue.c,
+// FatFs e raid.c rodam sem alteração por cima deles.
+//
+// O tempo é virtual (relogio_us): as escritas em stream custam o que o perfil
+// do cartão manda, e quem espera o cartão avança o relógio. Leituras e
+// escritas pelo FatFs são instantâneas.
+#ifndef CARTAO_EMULADO_H
+#define CARTAO_EMULADO_H
+
+#include "sd_card.h"
+
+#define CARTOES_EMULADOS 2
+
+typedef struct
+{
+  uint32_t transferencia_us; // Um bloco de 512 bytes no SPI
+  uint32_t bloco_us;         // Programação de cada bloco
+  uint32_t parada_us;        // Programação depois do fim de uma escrita
+  uint32_t gc_cada;          // A cada tantas escritas (0: nunca)...
+  uint32_t gc_us;            // ...uma coleta de lixo desta duração
+  uint32_t falha_apos;       // CMD13 acusa erro depois de tantas escritas (0: nunca)
+} perfil_cartao_t;
+
+extern uint64_t relogio_us;
+
+// (Re)cria o cartão n vazio, com os setores, a AU e a classe dadas. O perfil
+// pode ser NULL (instantâneo). Os cartões usados são 0..n.
+void cartao_emulado_criar(size_t n, uint64_t setores, uint32_t au_setores,
+                          uint8_t classe, uint8_t uhs, const perfil_cartao_t *perfil);
+
+// Escritas em stream (multiple block write) feitas no cartão n
+uint32_t cartao_emulado_escritas(size_t n);
+
+// Blocos começados num cartão enquanto outro ainda transferia o seu
+uint32_t cartao_emulado_sobrepostos(void);
+
+#endif
@@ -0,0 +1,12 @@
+// Substituto de hardware/dma.h do pico-sdk para compilar lib/ no computador
+#ifndef HARDWARE_DMA_H
+#define HARDWARE_DMA_H
+
+#include "pico/types.h"
+
+typedef struct
+{
+  uint32_t ctrl;
+} dma_channel_config;
+
+#endif
@@ -0,0 +1,15 @@
+// Substituto de hardware/gpio.h do pico-sdk para compilar lib/ no computador
+#ifndef HARDWARE_GPIO_H
+#define HARDWARE_GPIO_H
+
+#include "pico/types.h"
+
+enum gpio_drive_strength
+{
+  GPIO_DRIVE_STRENGTH_2MA,
+  GPIO_DRIVE_STRENGTH_4MA,
+  GPIO_DRIVE_STRENGTH_8MA,
+  GPIO_DRIVE_STRENGTH_12MA
+};
+
+#endif
@@ -0,0 +1,7 @@
+// Substituto de hardware/irq.h do pico-sdk para compilar lib/ no computador
+#ifndef HARDWARE_IRQ_H
+#define HARDWARE_IRQ_H
+
+typedef void (*irq_handler_t)(void);
+
+#endif
@@ -0,0 +1,7 @@
+// Substituto de hardware/spi.h do pico-sdk para compilar lib/ no computador
+#ifndef HARDWARE_SPI_H
+#define HARDWARE_SPI_H
+
+typedef struct spi_inst spi_inst_t;
+
+#endif
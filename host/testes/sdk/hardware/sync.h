@@ -0,0 +1,10 @@
+// Substituto de hardware/sync.h do pico-sdk para compilar lib/ no computador
+#ifndef HARDWARE_SYNC_H
+#define HARDWARE_SYNC_H
+
+static inline void __dmb(void)
+{
+  __sync_synchronize();
+}
+
+#endif
@@ -0,0 +1,12 @@
+// Substituto de pico/mutex.h do pico-sdk para compilar lib/ no computador
+#ifndef PICO_MUTEX_H
+#define PICO_MUTEX_H
+
+#include "pico/types.h"
+
+typedef struct
+{
+  int dono;
+} mutex_t;
+
+#endif
@@ -0,0 +1,12 @@
+// Substituto de pico/sem.h do pico-sdk para compilar lib/ no computador
+#ifndef PICO_SEM_H
+#define PICO_SEM_H
+
+#include "pico/types.h"
+
+typedef struct
+{
+  int permissoes;
+} semaphore_t;
+
+#endif
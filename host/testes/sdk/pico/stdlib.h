@@ -0,0 +1,12 @@
+// Substituto de pico/stdlib.h do pico-sdk: só o tempo, que os testes fornecem
+// (ver cartao_emulado.c)
+#ifndef PICO_STDLIB_H
+#define PICO_STDLIB_H
+
+#include "pico/types.h"
+
+absolute_time_t get_absolute_time(void);
+absolute_time_t make_timeout_time_ms(uint32_t ms);
+int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to);
+
+#endif
@@ -0,0 +1,15 @@
+// Substituto de pico/types.h do pico-sdk para compilar lib/ no computador
+#ifndef PICO_TYPES_H
+#define PICO_TYPES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t; // µs
+
+#define __not_in_flash_func(f) f
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+
+#endif
@@ -0,0 +1,70 @@
+// Decimador em ponto fixo contra o mesmo FIR em forma direta com double.
+// A saída deve ficar a até 0,5 LSB da referência (só o arredondamento final).
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "decimador.h"
+
+#define ENTRADAS 4000
+#define TOLERANCIA 0.5
+
+static int testar(uint8_t fator)
+{
+  decimador_t d;
+  if (!decimador_init(&d, fator))
+  {
+    printf("fator %u: decimador_init falhou\n", fator);
+    return 1;
+  }
+  const int taps = DECIMADOR_TAPS_FASE * fator;
+  double h[DECIMADOR_TAPS_FASE * 8];
+  for (int t = 0; t < taps; t++)
+    h[t] = d.coef[t] / 32768.0;
+
+  // Senoide forte mais ruído, longe da saturação
+  static int16_t x[ENTRADAS];
+  srand(fator);
+  for (int i = 0; i < ENTRADAS; i++)
+    x[i] = (int16_t)(12000 * sin(i * 0.01 * fator) + (rand() % 2000 - 1000));
+
+  double erro_max = 0;
+  int saidas = 0;
+  for (int i = 0; i < ENTRADAS; i++)
+  {
+    amostra_t a = {.tempo_ms = (uint32_t)i}, y;
+    for (int c = 0; c < 3; c++)
+    {
+      a.accel[c] = x[i];
+      a.gyro[c] = (int16_t)-x[i];
+    }
+    if (!decimador_processar(&d, &a, &y))
+      continue;
+    double ref = 0;
+    for (int t = 0; t < taps && t <= i; t++)
+      ref += h[t] * x[i - t];
+    for (int c = 0; c < 3; c++)
+    {
+      erro_max = fmax(erro_max, fabs(y.accel[c] - ref));
+      erro_max = fmax(erro_max, fabs(y.gyro[c] + ref));
+    }
+    saidas++;
+  }
+
+  int esperadas = ENTRADAS / fator;
+  printf("fator %u: %d saídas, erro máximo %.3f LSB\n", fator, saidas, erro_max);
+  if (saidas != esperadas)
+  {
+    printf("fator %u: esperava %d saídas\n", fator, esperadas);
+    return 1;
+  }
+  return erro_max > TOLERANCIA;
+}
+
+int main(void)
+{
+  int falhas = 0;
+  for (uint8_t fator = 2; fator <= 8; fator *= 2)
+    falhas += testar(fator);
+  return falhas != 0;
+}
@@ -0,0 +1,138 @@
+// Espectro em ponto fixo contra uma DFT com janela de Hann em double, para os
+// três tamanhos de janela e tons de 8000, 300 e 12 LSB. A potência de cada
+// faixa deve ficar a 0,2% da referência, mais um piso de ruído de quantização
+// proporcional à potência total. Também mede os ciclos por transformada.
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "espectro.h"
+
+#define TAXA_HZ 1000
+#define TOLERANCIA_REL 0.002
+#define PISO_REL 1e-5 // Da potência total
+#define PISO_ABS 4.0  // LSB^2
+
+static int16_t buf[2 * ESPECTRO_N_MAX];
+
+static uint64_t ciclos(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (uint64_t)t.tv_sec * 1000000000u + t.tv_nsec;
+#endif
+}
+
+// Potência por faixa com a mesma normalização do firmware
+static void referencia(const int16_t *x, int n, double banda[ESPECTRO_BANDAS])
+{
+  double media = 0;
+  for (int i = 0; i < n; i++)
+    media += x[i];
+  media /= n;
+  for (int b = 0; b < ESPECTRO_BANDAS; b++)
+    banda[b] = 0;
+  for (int k = 1; k <= n / 2; k++)
+  {
+    double re = 0, im = 0;
+    for (int i = 0; i < n; i++)
+    {
+      double v = (x[i] - media) * (0.5 - 0.5 * cos(2 * M_PI * i / n));
+      re += v * cos(2 * M_PI * k * i / n);
+      im -= v * sin(2 * M_PI * k * i / n);
+    }
+    // Lado único, ganho de potência da janela de Hann = 3/8
+    double p = (re * re + im * im) * (k < n / 2 ? 2 : 1) / ((double)n * n) / 0.375;
+    banda[(k - 1) * ESPECTRO_BANDAS / (n / 2)] += p;
+  }
+}
+
+static int comparar(int n, double amp, double freq)
+{
+  espectro_t e;
+  espectro_init(&e, buf, n, TAXA_HZ);
+  int16_t x[ESPECTRO_N_MAX];
+  for (int i = 0; i < n; i++)
+  {
+    double v = amp * sin(2 * M_PI * freq * i / TAXA_HZ) +
+               0.2 * amp * sin(2 * M_PI * freq * 2.7 * i / TAXA_HZ) + 200 + (rand() % 5 - 2);
+    x[i] = (int16_t)lrint(v);
+    espectro_adicionar(&e, x[i], i);
+  }
+  espectro_resultado_t r;
+  while (!espectro_processar(&e, &r))
+    ;
+
+  double ref[ESPECTRO_BANDAS], total = 0;
+  referencia(x, n, ref);
+  for (int b = 0; b < ESPECTRO_BANDAS; b++)
+    total += ref[b];
+
+  int falhas = 0;
+  printf("n=%d amp=%g: dominante %.2f Hz\n  ponto fixo:", n, amp, r.freq_dominante_ch / 100.0);
+  for (int b = 0; b < ESPECTRO_BANDAS; b++)
+  {
+    printf(" %9u", r.banda[b]);
+    if (fabs(r.banda[b] - ref[b]) > TOLERANCIA_REL * ref[b] + PISO_REL * total + PISO_ABS)
+      falhas++;
+  }
+  printf("\n  double:    ");
+  for (int b = 0; b < ESPECTRO_BANDAS; b++)
+    printf(" %9.0f", ref[b]);
+  printf("\n");
+
+  if (fabs(r.freq_dominante_ch / 100.0 - freq) > (double)TAXA_HZ / n)
+  {
+    printf("  frequência dominante longe de %.1f Hz\n", freq);
+    falhas++;
+  }
+  if (falhas)
+    printf("  FALHOU\n");
+  return falhas;
+}
+
+// Menor custo de uma transformada completa, em ciclos (TSC no x86, ns nos outros)
+static uint64_t medir(int n)
+{
+  espectro_t e;
+  espectro_resultado_t r;
+  espectro_init(&e, buf, n, TAXA_HZ);
+  uint64_t melhor = UINT64_MAX;
+  for (int rep = 0; rep < 200; rep++)
+  {
+    for (int i = 0; i < n; i++)
+      espectro_adicionar(&e, (int16_t)(rand() % 2000 - 1000), i);
+    uint64_t c = ciclos();
+    while (!espectro_processar(&e, &r))
+      ;
+    c = ciclos() - c;
+    if (c < melhor)
+      melhor = c;
+  }
+  return melhor;
+}
+
+int main(void)
+{
+  static const int tamanhos[] = {256, 512, 1024};
+  static const double amp[] = {8000, 300, 12};
+  static const double freq[] = {123.4, 60.0, 311.0};
+  int falhas = 0;
+
+  srand(1);
+  for (int t = 0; t < 3; t++)
+  {
+    for (int c = 0; c < 3; c++)
+      falhas += comparar(tamanhos[t], amp[c], freq[c]);
+    printf("  custo (n=%d): %llu ciclos/transformada\n", tamanhos[t],
+           (unsigned long long)medir(tamanhos[t]));
+  }
+  return falhas != 0;
+}
@@ -0,0 +1,63 @@
+// formatacao.c sobre cartões emulados de 512 MB a 1 TB (arquivos esparsos): sistema de
+// arquivos e cluster escolhidos, área de dados no início de uma AU e nenhum cluster
+// atravessando duas AUs
+#include <stdio.h>
+
+#include "cartao_emulado.h"
+#include "ff.h"
+#include "formatacao.h"
+
+#define MB (2048u) // Setores
+
+typedef struct
+{
+  const char *nome;
+  uint64_t setores;
+  uint32_t au_setores; // Do SD Status
+  BYTE tipo;           // Esperado; 0: escolha do FatFs
+  DWORD cluster_bytes;
+  DWORD alinhamento;   // Esperado em GET_BLOCK_SIZE
+} cartao_t;
+
+static const cartao_t CARTOES[] = {
+  {"512 MB", 512 * MB, 4 * MB, 0, 0, 4 * MB},
+  {"8 GB", 15523840, 4 * MB, FS_FAT32, 32768, 4 * MB},
+  {"32 GB", 62333952, 8 * MB, FS_FAT32, 32768, 8 * MB},
+  {"64 GB", 124735488, 12 * MB, FS_EXFAT, 131072, 4 * MB}, // AU de 12 MB: alinha em 4 MB
+  {"1 TB", 2147483648u, 32 * MB, FS_EXFAT, 262144, 16 * MB}, // Limite do FatFs
+};
+
+int main(void)
+{
+  static const char *const tipos[] = {"?", "FAT12", "FAT16", "FAT32", "exFAT"};
+  int falhas = 0;
+  for (size_t c = 0; c < sizeof(CARTOES) / sizeof(CARTOES[0]); c++)
+  {
+    const cartao_t *k = &CARTOES[c];
+    cartao_emulado_criar(0, k->setores, k->au_setores, 10, 1, NULL);
+    static FATFS fs;
+    formatacao_t info;
+    FRESULT fr = formatacao_executar("0:", 0, &fs, &info);
+    if (fr != FR_OK)
+    {
+      printf("%s: erro %d\n", k->nome, fr);
+      falhas++;
+      continue;
+    }
+    f_unmount("0:");
+
+    printf("%s: %s, clusters de %lu KB, AU %lu setores, dados em %llu, %lu clusters\n", k->nome,
+           tipos[info.tipo < 5 ? info.tipo : 0], (unsigned long)info.cluster_bytes / 1024,
+           (unsigned long)info.au_setores, (unsigned long long)info.inicio_dados, (unsigned long)info.clusters);
+    int ok = info.au_setores == k->alinhamento && info.inicio_dados % info.au_setores == 0 &&
+             info.au_setores % (info.cluster_bytes / FF_MAX_SS) == 0 && info.clusters > 0;
+    if (k->tipo)
+      ok = ok && info.tipo == k->tipo && info.cluster_bytes == k->cluster_bytes;
+    if (!ok)
+    {
+      printf("  FALHOU\n");
+      falhas++;
+    }
+  }
+  return falhas ? 1 : 0;
+}
@@ -0,0 +1,120 @@
+// Fusão em ponto fixo contra os mesmos filtros em double, 20 s de movimento
+// sintético a 1 kHz, nos dois modos. Nenhuma componente do quaternion pode se
+// afastar mais que 4e-5 da referência. Também mede o custo por atualização.
+#include <math.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "fusao.h"
+
+#define PERIODO_US 1000
+#define PASSOS 20000
+#define TOLERANCIA 4e-5
+#define LSB_G 16384.0     // ±2 g
+#define LSB_GRAUS_S 131.0 // ±250 °/s
+
+// Um passo do filtro em double: a = aceleração em g, w = giro em rad/s
+static void referencia(double q[4], fusao_modo_t modo, double dt, double ganho,
+                       const double a_in[3], const double w[3])
+{
+  double a[3] = {a_in[0], a_in[1], a_in[2]};
+  double n = sqrt(a[0] * a[0] + a[1] * a[1] + a[2] * a[2]);
+  int valida = n > 0.5 && n < 1.5;
+  for (int i = 0; i < 3; i++)
+    a[i] /= n;
+
+  double h[3] = {w[0] * dt / 2, w[1] * dt / 2, w[2] * dt / 2};
+  double s[4] = {0};
+  if (valida && modo == FUSAO_COMPLEMENTAR)
+  {
+    double vx = 2 * (q[1] * q[3] - q[0] * q[2]);
+    double vy = 2 * (q[0] * q[1] + q[2] * q[3]);
+    double vz = q[0] * q[0] - q[1] * q[1] - q[2] * q[2] + q[3] * q[3];
+    h[0] += (a[1] * vz - a[2] * vy) * ganho * dt / 2;
+    h[1] += (a[2] * vx - a[0] * vz) * ganho * dt / 2;
+    h[2] += (a[0] * vy - a[1] * vx) * ganho * dt / 2;
+  }
+  else if (valida)
+  {
+    double f1 = 2 * (q[1] * q[3] - q[0] * q[2]) - a[0];
+    double f2 = 2 * (q[0] * q[1] + q[2] * q[3]) - a[1];
+    double f3 = 1 - 2 * (q[1] * q[1] + q[2] * q[2]) - a[2];
+    double g[4] = {
+      -2 * q[2] * f1 + 2 * q[1] * f2,
+      2 * q[3] * f1 + 2 * q[0] * f2 - 4 * q[1] * f3,
+      -2 * q[0] * f1 + 2 * q[3] * f2 - 4 * q[2] * f3,
+      2 * q[1] * f1 + 2 * q[2] * f2,
+    };
+    double gn = sqrt(g[0] * g[0] + g[1] * g[1] + g[2] * g[2] + g[3] * g[3]);
+    if (gn > 0)
+      for (int i = 0; i < 4; i++)
+        s[i] = g[i] / gn * ganho * dt;
+  }
+
+  double d[4] = {
+    -q[1] * h[0] - q[2] * h[1] - q[3] * h[2],
+    q[0] * h[0] + q[2] * h[2] - q[3] * h[1],
+    q[0] * h[1] - q[1] * h[2] + q[3] * h[0],
+    q[0] * h[2] + q[1] * h[1] - q[2] * h[0],
+  };
+  double m = 0;
+  for (int i = 0; i < 4; i++)
+  {
+    q[i] += d[i] - s[i];
+    m += q[i] * q[i];
+  }
+  m = sqrt(m);
+  for (int i = 0; i < 4; i++)
+    q[i] /= m;
+}
+
+static int testar(fusao_modo_t modo, uint32_t ganho_mil)
+{
+  fusao_t f;
+  fusao_init(&f, modo, PERIODO_US, ganho_mil);
+  double q[4] = {1, 0, 0, 0};
+  double erro_max = 0;
+
+  for (int i = 0; i < PASSOS; i++)
+  {
+    double t = i * PERIODO_US * 1e-6;
+    double giro[3] = {30 * sin(t), 20 * cos(0.7 * t), 5}; // °/s
+    double rolagem = 0.3 * sin(0.5 * t);
+    double g[3] = {0.2 * sin(rolagem), sin(rolagem), cos(rolagem)};
+    int16_t accel[3], gyro[3];
+    double a[3], w[3];
+    for (int k = 0; k < 3; k++)
+    {
+      accel[k] = (int16_t)lrint(g[k] * LSB_G);
+      gyro[k] = (int16_t)lrint(giro[k] * LSB_GRAUS_S);
+      a[k] = accel[k] / LSB_G;
+      w[k] = gyro[k] / LSB_GRAUS_S * M_PI / 180;
+    }
+    fusao_atualizar(&f, accel, gyro);
+    referencia(q, modo, PERIODO_US * 1e-6, ganho_mil / 1000.0, a, w);
+    for (int k = 0; k < 4; k++)
+      erro_max = fmax(erro_max, fabs(f.q[k] / 1073741824.0 - q[k]));
+  }
+
+  // Custo no computador, só para comparar versões
+  int16_t accel[3] = {100, 200, 16000}, gyro[3] = {50, -30, 20};
+  clock_t c = clock();
+  for (int i = 0; i < 2000000; i++)
+  {
+    gyro[0] ^= i & 1;
+    fusao_atualizar(&f, accel, gyro);
+  }
+  double ns = (double)(clock() - c) * 1e9 / CLOCKS_PER_SEC / 2e6;
+
+  printf("%s: erro máximo %.2e, q final %.4f %.4f %.4f %.4f, %.1f ns/atualização\n",
+         modo == FUSAO_COMPLEMENTAR ? "complementar" : "madgwick", erro_max, q[0], q[1],
+         q[2], q[3], ns);
+  return erro_max > TOLERANCIA;
+}
+
+int main(void)
+{
+  int falhas = testar(FUSAO_COMPLEMENTAR, 1000);
+  falhas += testar(FUSAO_MADGWICK, 100);
+  return falhas != 0;
+}
@@ -19,10 +19,20 @@ This example assumes the following hardware configuration:
 | MOSI  | TX    | 19    | 25    | DI        | DI        | Master Out, Slave In   |
 | SCK   | SCK   | 18    | 24    | SCLK      | CLK       | SPI clock              |
 | CS0   | CSn   | 17    | 22    | SS or CS  | CS        | Slave (or Chip) Select |
-| DET   |       | 22    | 29    |           | CD        | Card Detect            |
+| DET   |       | 22    | 29    |           | CD        | Card Detect (unused)   |
 | GND   |       |       | 18,23 |           | GND       | Ground                 |
 | 3v3   |       |       | 36    |           | 3v3       | 3.3 volt power         |
 
+With RAID_MODO (see CMakeLists.txt) a second card on its own SPI receives
+half of the stripes (1) or a copy of every block (2):
+
+|       | SPI1  | GPIO  | Pin   | SPI       | MicroSD   | Description            |
+| ----- | ----  | ----- | ---   | --------  | --------- | ---------------------- |
+| MISO  | RX    | 8     | 11    | DO        | DO        | Master In, Slave Out   |
+| MOSI  | TX    | 27    | 32    | DI        | DI        | Master Out, Slave In   |
+| SCK   | SCK   | 10    | 14    | SCLK      | CLK       | SPI clock              |
+| CS1   | CSn   | 9     | 12    | SS or CS  | CS        | Slave (or Chip) Select |
+
 */
 
 // Hardware Configuration of SPI "objects"
@@ -38,7 +48,17 @@ static spi_t spis[] = {  // One for each SPI.
         // .baud_rate = 1000 * 1000
         .baud_rate = 1000 * 1000
         // .baud_rate = 25 * 1000 * 1000 // Actual frequency: 20833333.
-    }};
+    }
+#if RAID_MODO
+    , {
+        .hw_inst = spi1,  // A bus of its own, so both cards transfer at once
+        .miso_gpio = 8,
+        .mosi_gpio = 27,
+        .sck_gpio = 10,
+        .baud_rate = 1000 * 1000  // Same as spis[0]
+    }
+#endif
+};
 
 // Hardware Configuration of the SD Card "objects"
 static sd_card_t sd_cards[] = {  // One for each SD card
@@ -46,11 +66,22 @@ static sd_card_t sd_cards[] = {  // One for each SD card
         .pcName = "0:",   // Name used to mount device
         .spi = &spis[0],  // Pointer to the SPI driving this card
         .ss_gpio = 17,    // The SPI slave select GPIO for this SD card
+        // GPIO 22 is also the joystick button on this board, so card detect
+        // stays off unless one of them is rewired
         .use_card_detect = false,
         .card_detect_gpio = 22,  // Card detect
         .card_detected_true = -1  // What the GPIO read returns when a card is
                                  // present.
-    }};
+    }
+#if RAID_MODO
+    , {
+        .pcName = "1:",
+        .spi = &spis[1],
+        .ss_gpio = 9,
+        .use_card_detect = false
+    }
+#endif
+};
 
 /* ********************************************************************** */
 size_t sd_get_num() { return count_of(sd_cards); }
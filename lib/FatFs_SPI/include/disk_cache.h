@@ -0,0 +1,37 @@
+/* disk_cache.h
+Write-behind and read sector caches between FatFs and the SD card driver
+(see glue.c).
+*/
+#pragma once
+
+#include "ff.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+    typedef struct {
+        uint32_t read_hits;    // Single-sector reads served from the read cache
+        uint32_t read_misses;  // Single-sector reads that went to the card
+        uint32_t write_hits;   // Single-sector reads served from the write-behind cache
+    } disk_cache_stats_t;
+
+    // Writes back all dirty sectors of a drive. Call before f_unmount.
+    // Returns SD_BLOCK_DEVICE_ERROR_NONE or an SD_BLOCK_DEVICE_ERROR_* code.
+    int disk_cache_flush(BYTE pdrv);
+
+    // Call periodically (e.g. from the main loop) so that dirty sectors are
+    // written back within DISK_CACHE_FLUSH_MS even when the disk is idle.
+    void disk_cache_task();
+
+    // Forgets any cached copy of count sectors from sector on, dirty or not.
+    // Call before writing them behind FatFs' back (e.g. raid.c streaming), so
+    // neither a stale copy is read back nor an old dirty one written over them.
+    void disk_cache_invalidate(BYTE pdrv, LBA_t sector, UINT count);
+
+    void disk_cache_get_stats(disk_cache_stats_t *stats);
+    void disk_cache_reset_stats();
+
+#ifdef __cplusplus
+}
+#endif
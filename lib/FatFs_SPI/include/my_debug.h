@@ -13,13 +13,27 @@ specific language governing permissions and limitations under the License.
 */
 #pragma once
 
+#include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* Number of messages held until my_log_drain() prints them */
+#ifndef MY_LOG_ENTRIES
+#define MY_LOG_ENTRIES 16
+#endif
+
+    /* Deferred: safe from IRQs and either core, never blocks on the console.
+       pcFormat must point to storage that outlives the call (a string literal). */
     void my_printf(const char *pcFormat, ...) __attribute__((format(__printf__, 1, 2)));
+    void my_vprintf(const char *pcFormat, va_list xArgs);
+
+    /* Prints pending messages; call from idle time */
+    void my_log_drain(void);
+    uint32_t my_log_dropped(void);
 
     void my_assert_func(const char *file, int line, const char *func,
                         const char *pred);
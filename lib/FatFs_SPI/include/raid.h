@@ -0,0 +1,95 @@
+/* raid.h
+Sequential logging to two SD cards, striped (RAID-0) or mirrored (RAID-1).
+
+Each card holds one contiguous, preallocated file of the same name.
+
+Striping: logical sectors are dealt out in stripe units: unit 0 to card 0,
+unit 1 to card 1, unit 2 to card 0 and so on. A full row (one unit per card)
+is written to both cards at once, with the data phases overlapping on their
+separate SPIs, so throughput is close to twice that of one card. The files
+stay readable on a PC and are reassembled by interleaving them in units of
+unit_sectors.
+
+Mirroring: every sector goes to both cards at the same offset, so either file
+is a complete copy. The stage buffer is a ring of sectors with one queue
+(tail) per card. A card that is ready takes up to unit_sectors of its queue in
+one multiple block write; one that is still busy programming, or collecting
+garbage, is skipped and catches up later while the other carries on, so the
+two only write in step when both are free. Writes to both overlap on their
+SPIs, keeping the rate of a single card. A card that reports an error,
+disappears or lags for RAID_STALL_MS with the ring full is dropped and
+logging continues on the other one.
+*/
+#pragma once
+
+#include "ff.h"
+#include "sd_card.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RAID_MEMBERS 2
+
+// How long a full mirror ring waits for the slowest card before dropping it
+#ifndef RAID_STALL_MS
+#define RAID_STALL_MS 1000
+#endif
+
+    typedef enum {
+        RAID_STRIPE,  // RAID-0: for bandwidth
+        RAID_MIRROR   // RAID-1: for redundancy
+    } raid_mode_t;
+
+    typedef struct {
+        raid_mode_t mode;
+        sd_card_t *card[RAID_MEMBERS];
+        FIL file[RAID_MEMBERS];
+        LBA_t base[RAID_MEMBERS];  // First sector of each member file
+        uint32_t member_sectors;   // Preallocated in each member file
+        uint32_t unit_sectors;     // Stripe unit, or longest write to one card
+        uint8_t *stage;
+        uint32_t stage_sectors;
+        // Striping
+        uint32_t staged;           // Sectors waiting in stage
+        uint32_t rows;             // Full rows written
+        uint64_t sectors_written;  // Logical sectors on the cards
+        // Mirroring: stage is a ring of stage_sectors
+        uint32_t head;                  // Sectors queued so far
+        uint32_t tail[RAID_MEMBERS];    // Sectors written to each card
+        bool status_due[RAID_MEMBERS];  // Last write not yet checked with CMD13
+        bool failed[RAID_MEMBERS];      // Dropped from the mirror
+    } raid_t;
+
+    // Creates name on every card (e.g. "mpu_data.imu" becomes "0:mpu_data.imu"
+    // and "1:mpu_data.imu") with member_size bytes of contiguous space each.
+    // stage holds stage_sectors * FF_MAX_SS bytes: at least one row
+    // (RAID_MEMBERS * unit_sectors) when striping, and at least unit_sectors
+    // when mirroring, where more is the lag a slow card may build up.
+    FRESULT raid_open(raid_t *r, const char *name, raid_mode_t mode,
+                      FSIZE_t member_size, uint32_t unit_sectors,
+                      uint8_t *stage, uint32_t stage_sectors);
+
+    // Appends one sector: a stripe row is written whenever it fills, a mirror
+    // queue whenever its card is ready and has unit_sectors waiting.
+    // Returns SD_BLOCK_DEVICE_ERROR_NONE or an SD_BLOCK_DEVICE_ERROR_* code;
+    // a mirror only fails when no card is left.
+    int raid_write(raid_t *r, const uint8_t *sector);
+
+    // Lets idle mirror cards catch up between writes; call it from the main
+    // loop. Does nothing when striping.
+    void raid_task(raid_t *r);
+
+    // Logical sectors accepted so far, written or still staged
+    uint64_t raid_size(const raid_t *r);
+
+    // Cards still in use (always RAID_MEMBERS when striping)
+    size_t raid_members_active(const raid_t *r);
+
+    // Writes whatever is staged, trims every file to its data and closes it
+    FRESULT raid_close(raid_t *r);
+
+#ifdef __cplusplus
+}
+#endif
+/* [] END OF FILE */
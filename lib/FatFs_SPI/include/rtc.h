@@ -13,12 +13,18 @@ specific language governing permissions and limitations under the License.
 */
 #pragma once
 
+#include <stdbool.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Starts the RTC and the once-per-second refresh of the cached FAT timestamp
 void time_init();
 
+// Sets the RTC (e.g. from the host over USB); returns false for an invalid date
+bool time_set(int year, int month, int day, int hour, int min, int sec);
+
 #ifdef __cplusplus
 }
 #endif
@@ -83,14 +83,14 @@ specific language governing permissions and limitations under the License.
 #include <stdio.h>
 #include <stdarg.h>
 
+#include "my_debug.h"
+
+/* Recorded into the deferred log ring; printed by my_log_drain() */
 void vLoggingPrintf( const char *pcFormat, ... )
 {
-    char pcBuffer[256] = {0};
 	va_list xArgs;
     va_start( xArgs, pcFormat );
-	vsnprintf( pcBuffer, sizeof(pcBuffer), pcFormat, xArgs );
+	my_vprintf( pcFormat, xArgs );
 	va_end( xArgs );
-    printf("%s", pcBuffer);
-    fflush(stdout);
 }
 /*-----------------------------------------------------------*/
@@ -163,6 +163,8 @@ specific language governing permissions and limitations under the License.
 #include <inttypes.h>
 #include <string.h>
 //
+#include "hardware/irq.h"
+#include "hardware/sync.h"
 #include "pico/mutex.h"
 //
 #include "hw_config.h"  // Hardware Configuration of the SPI and SD Card "objects"
@@ -354,7 +356,7 @@ static bool sd_wait_ready(sd_card_t *pSD, int timeout) {
     absolute_time_t timeout_time = make_timeout_time_ms(timeout);
     do {
         resp = sd_spi_write(pSD, 0xFF);
-    } while (resp == 0x00 &&
+    } while (resp == 0x00 && !(pSD->m_Status & STA_NODISK) &&
              0 < absolute_time_diff_us(get_absolute_time(), timeout_time));
 
     if (resp == 0x00) DBG_PRINTF("%s failed\r\n", __FUNCTION__);
@@ -612,27 +614,58 @@ static int sd_cmd(sd_card_t *pSD, const cmdSupported cmd, uint32_t arg,
 }
 
 /* Return non-zero if the SD-card is present. */
-bool sd_card_detect(sd_card_t *pSD) {
-    TRACE_PRINTF("> %s\r\n", __FUNCTION__);
-    if (!pSD->use_card_detect) {
-        pSD->m_Status &= ~STA_NODISK;
-        return true;
-    }
-    /*!< Check GPIO to detect SD */
+// m_Status is also written by the card detect interrupt, so read-modify-write
+// from thread context must not be interleaved with it
+static void sd_status_set(sd_card_t *pSD, int bits) {
+    uint32_t save = save_and_disable_interrupts();
+    pSD->m_Status |= bits;
+    restore_interrupts(save);
+}
+static void sd_status_clear(sd_card_t *pSD, int bits) {
+    uint32_t save = save_and_disable_interrupts();
+    pSD->m_Status &= ~bits;
+    restore_interrupts(save);
+}
+
+// Sample the card detect GPIO into m_Status
+static bool card_detect_update(sd_card_t *pSD) {
     if (gpio_get(pSD->card_detect_gpio) == pSD->card_detected_true) {
-        // The socket is now occupied
+        // The socket is now occupied; the card still needs sd_init()
         pSD->m_Status &= ~STA_NODISK;
-        TRACE_PRINTF("SD card detected!\r\n");
         return true;
     } else {
         // The socket is now empty
         pSD->m_Status |= (STA_NODISK | STA_NOINIT);
         pSD->card_type = SDCARD_NONE;
-        printf("No SD card detected!\r\n");
         return false;
     }
 }
 
+// Runs on both edges of every card detect GPIO. A removal is visible in
+// m_Status within microseconds, so disk_status() is a plain memory read and
+// transfers in progress give up instead of running into their timeouts.
+// Contact bounce only produces more edges; the last one leaves the final level.
+static void card_detect_irq_handler(void) {
+    for (size_t i = 0; i < sd_get_num(); ++i) {
+        sd_card_t *pSD = sd_get_by_num(i);
+        if (!pSD->use_card_detect) continue;
+        uint32_t events = gpio_get_irq_event_mask(pSD->card_detect_gpio);
+        if (!(events & (GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL))) continue;
+        gpio_acknowledge_irq(pSD->card_detect_gpio, events);
+        card_detect_update(pSD);
+    }
+}
+
+bool sd_card_detect(sd_card_t *pSD) {
+    TRACE_PRINTF("> %s\r\n", __FUNCTION__);
+    if (!pSD->use_card_detect) {
+        sd_status_clear(pSD, STA_NODISK);
+        return true;
+    }
+    // Kept current by card_detect_irq_handler()
+    return !(pSD->m_Status & STA_NODISK);
+}
+
 /*!< Number of retries for sending CMDO */
 #define SD_CMD0_GO_IDLE_STATE_RETRIES 10
 
@@ -759,6 +792,39 @@ uint64_t sd_sectors(sd_card_t *pSD) {
     return sectors;
 }
 
+static int sd_read_status_nolock(sd_card_t *pSD, uint8_t status[64]) {
+    // ACMD13, Response R2 (R1 byte + status byte), then a 64-byte data block
+    int err = sd_cmd(pSD, ACMD13_SD_STATUS, 0x0, true, 0);
+    if (err != SD_BLOCK_DEVICE_ERROR_NONE) {
+        DBG_PRINTF("ACMD13 failed: %d\r\n", err);
+        return err;
+    }
+    return sd_read_bytes(pSD, status, 64);
+}
+int sd_read_status(sd_card_t *pSD, uint8_t status[64]) {
+    sd_acquire(pSD);
+    int err = sd_read_status_nolock(pSD, status);
+    sd_release(pSD);
+    return err;
+}
+
+// Allocation unit and speed class from the SD Status (bit 511 is status[0] bit 7)
+static void sd_parse_status(sd_card_t *pSD, const uint8_t status[64]) {
+    // AU_SIZE [431:428]; UHS_AU_SIZE [395:392] supersedes it on UHS cards.
+    // Codes 1..F are 16 KiB..64 MiB, with 12 MiB and 24 MiB in between
+    static const uint32_t au_kib[16] = {0,    16,    32,    64,    128,   256,   512,   1024,
+                                        2048, 4096,  8192,  12288, 16384, 24576, 32768, 65536};
+    // SPEED_CLASS [447:440]: 0..4 = Class 0, 2, 4, 6, 10
+    static const uint8_t classes[5] = {0, 2, 4, 6, 10};
+    uint8_t au = status[10] >> 4;
+    uint8_t uhs_au = status[14] & 0x0F;
+    pSD->au_sectors = au_kib[uhs_au ? uhs_au : au] * 1024 / _block_size;
+    pSD->speed_class = status[8] < count_of(classes) ? classes[status[8]] : 0;
+    pSD->uhs_speed_grade = status[14] >> 4;  // UHS_SPEED_GRADE [399:396]
+    DBG_PRINTF("AU: %" PRIu32 " sectors, Class %u, U%u\r\n", pSD->au_sectors,
+               pSD->speed_class, pSD->uhs_speed_grade);
+}
+
 // SPI function to wait till chip is ready and sends start token
 static bool sd_wait_token(sd_card_t *pSD, uint8_t token) {
     TRACE_PRINTF("%s(0x%02hhx)\r\n", __FUNCTION__, token);
@@ -847,9 +913,11 @@ static int in_sd_read_blocks(sd_card_t *pSD, uint8_t *buffer,
                              uint64_t ulSectorNumber, uint32_t ulSectorCount) {
     uint32_t blockCnt = ulSectorCount;
 
+    if (pSD->m_Status & STA_NODISK)
+        return SD_BLOCK_DEVICE_ERROR_NO_DEVICE;
     if (ulSectorNumber + blockCnt > pSD->sectors)
         return SD_BLOCK_DEVICE_ERROR_PARAMETER;
-    if (pSD->m_Status & (STA_NOINIT | STA_NODISK))
+    if (pSD->m_Status & STA_NOINIT)
         return SD_BLOCK_DEVICE_ERROR_PARAMETER;
 
     int status = SD_BLOCK_DEVICE_ERROR_NONE;
@@ -948,9 +1016,11 @@ static uint8_t sd_write_block(sd_card_t *pSD, const uint8_t *buffer,
  */
 static int in_sd_write_blocks(sd_card_t *pSD, const uint8_t *buffer,
                               uint64_t ulSectorNumber, uint32_t blockCnt) {
+    if (pSD->m_Status & STA_NODISK)
+        return SD_BLOCK_DEVICE_ERROR_NO_DEVICE;
     if (ulSectorNumber + blockCnt > pSD->sectors)
         return SD_BLOCK_DEVICE_ERROR_PARAMETER;
-    if (pSD->m_Status & (STA_NOINIT | STA_NODISK))
+    if (pSD->m_Status & STA_NOINIT)
         return SD_BLOCK_DEVICE_ERROR_PARAMETER;
 
     int status = SD_BLOCK_DEVICE_ERROR_NONE;
@@ -1024,6 +1094,122 @@ int sd_write_blocks(sd_card_t *pSD, const uint8_t *buffer,
     return status;
 }
 
+/* Multiple block write broken into steps, so that the data phases of cards
+ * on separate SPIs can run at the same time: start a block on every card,
+ * then finish them all. The card stays locked and selected from
+ * sd_write_stream_begin() to sd_write_stream_end().
+ */
+int sd_write_stream_begin(sd_card_t *pSD, uint64_t ulSectorNumber,
+                          uint32_t blockCnt) {
+    if (pSD->m_Status & STA_NODISK)
+        return SD_BLOCK_DEVICE_ERROR_NO_DEVICE;
+    if (!blockCnt || ulSectorNumber + blockCnt > pSD->sectors)
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    if (pSD->m_Status & STA_NOINIT)
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+
+    sd_acquire(pSD);
+    uint64_t addr;
+    if (SDCARD_V2HC == pSD->card_type) {
+        addr = ulSectorNumber;
+    } else {
+        addr = ulSectorNumber * _block_size;
+    }
+    // Pre-erase setting prior to multiple block write operation
+    sd_cmd(pSD, ACMD23_SET_WR_BLK_ERASE_COUNT, blockCnt, 1, 0);
+
+    // Some SD cards want to be deselected between every bus transaction:
+    sd_spi_deselect_pulse(pSD);
+
+    int status = sd_cmd(pSD, CMD25_WRITE_MULTIPLE_BLOCK, addr, false, 0);
+    if (SD_BLOCK_DEVICE_ERROR_NONE != status) {
+        sd_release(pSD);
+        return status;
+    }
+    pSD->stream_blocks = blockCnt;
+    return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+
+// Wait for the card to finish programming the previous block, then send the
+// start token and leave the DMA running on the data
+int sd_write_stream_block_start(sd_card_t *pSD, const uint8_t *buffer) {
+    myASSERT(pSD->stream_blocks);
+    if (!sd_wait_ready(pSD, SD_COMMAND_TIMEOUT))
+        return (pSD->m_Status & STA_NODISK) ? SD_BLOCK_DEVICE_ERROR_NO_DEVICE
+                                            : SD_BLOCK_DEVICE_ERROR_WRITE;
+    sd_spi_write(pSD, SPI_START_BLK_MUL_WRITE);
+    sd_spi_transfer_start(pSD, buffer, NULL, _block_size);
+    pSD->stream_crc = (~0);
+#if SD_CRC_ENABLED
+    // Overlaps with the transfer
+    if (crc_on) pSD->stream_crc = crc16((void *)buffer, _block_size);
+#endif
+    return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+
+// Complete the block begun by sd_write_stream_block_start(); doesn't wait
+// for the card to program it
+int sd_write_stream_block_finish(sd_card_t *pSD) {
+    if (!sd_spi_transfer_wait_complete(pSD, 1000))
+        return SD_BLOCK_DEVICE_ERROR_WRITE;
+    sd_spi_write(pSD, pSD->stream_crc >> 8);
+    sd_spi_write(pSD, pSD->stream_crc);
+    uint8_t response = sd_spi_write(pSD, SPI_FILL_CHAR);
+    if ((response & SPI_DATA_RESPONSE_MASK) != SPI_DATA_ACCEPTED) {
+        DBG_PRINTF("Stream Block Write failed: 0x%x\r\n", response);
+        return SD_BLOCK_DEVICE_ERROR_WRITE;
+    }
+    --pSD->stream_blocks;
+    return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+
+// Stop the transmission (early, too, after an error) and release the card
+int sd_write_stream_end(sd_card_t *pSD) {
+    int status = SD_BLOCK_DEVICE_ERROR_NONE;
+    if (!(pSD->m_Status & STA_NODISK)) {
+        sd_wait_ready(pSD, SD_COMMAND_TIMEOUT);
+        sd_spi_write(pSD, SPI_STOP_TRAN);
+        uint32_t stat = 0;
+        sd_spi_deselect_pulse(pSD);
+        status = sd_cmd(pSD, CMD13_SEND_STATUS, 0, false, &stat);
+    }
+    if (pSD->stream_blocks && SD_BLOCK_DEVICE_ERROR_NONE == status)
+        status = SD_BLOCK_DEVICE_ERROR_WRITE;
+    pSD->stream_blocks = 0;
+    sd_release(pSD);
+    return status;
+}
+
+// Non-blocking alternative to sd_write_stream_end() once every block is
+// sent: the card programs the last block on its own while the caller does
+// something else. Follow with sd_write_stream_status() when it's ready.
+void sd_write_stream_stop(sd_card_t *pSD) {
+    myASSERT(!pSD->stream_blocks);
+    sd_spi_write(pSD, SPI_STOP_TRAN);
+    sd_release(pSD);
+}
+
+// Checks the outcome of a stream closed by sd_write_stream_stop()
+int sd_write_stream_status(sd_card_t *pSD) {
+    if (pSD->m_Status & STA_NODISK)
+        return SD_BLOCK_DEVICE_ERROR_NO_DEVICE;
+    uint32_t stat = 0;
+    sd_acquire(pSD);
+    int status = sd_cmd(pSD, CMD13_SEND_STATUS, 0, false, &stat);
+    sd_release(pSD);
+    return status;
+}
+
+// True once the card has released DO, i.e. isn't busy programming. Polls
+// one byte and doesn't wait.
+bool sd_card_ready(sd_card_t *pSD) {
+    if (pSD->m_Status & (STA_NOINIT | STA_NODISK)) return false;
+    sd_acquire(pSD);
+    bool ready = sd_spi_write(pSD, SPI_FILL_CHAR) != 0x00;
+    sd_release(pSD);
+    return ready;
+}
+
 static int sd_init_medium(sd_card_t *pSD) {
     int32_t status = SD_BLOCK_DEVICE_ERROR_NONE;
     uint32_t response, arg;
@@ -1144,6 +1330,7 @@ bool sd_init_driver() {
     auto_init_mutex(sd_init_driver_mutex);
     mutex_enter_blocking(&sd_init_driver_mutex);
     if (!initialized) {
+        uint32_t card_detect_mask = 0;
         for (size_t i = 0; i < sd_get_num(); ++i) {
             sd_card_t *pSD = sd_get_by_num(i);
 
@@ -1153,6 +1340,10 @@ bool sd_init_driver() {
                 gpio_init(pSD->card_detect_gpio);
                 gpio_pull_up(pSD->card_detect_gpio);
                 gpio_set_dir(pSD->card_detect_gpio, GPIO_IN);
+                card_detect_update(pSD);
+                gpio_set_irq_enabled(pSD->card_detect_gpio,
+                                     GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true);
+                card_detect_mask |= 1u << pSD->card_detect_gpio;
             }
             if (pSD->set_drive_strength) {
                 gpio_set_drive_strength(pSD->ss_gpio, pSD->ss_gpio_drive_strength);
@@ -1164,6 +1355,11 @@ bool sd_init_driver() {
             gpio_set_dir(pSD->ss_gpio, GPIO_OUT);
             gpio_put(pSD->ss_gpio, 1);  // In case set_dir does anything
         }
+        if (card_detect_mask) {
+            // A raw handler leaves gpio_set_irq_callback() to the application
+            gpio_add_raw_irq_handler_masked(card_detect_mask, card_detect_irq_handler);
+            irq_set_enabled(IO_IRQ_BANK0, true);
+        }
         for (size_t i = 0; i < spi_get_num(); ++i) {
             spi_t *pSPI = spi_get_by_num(i);
             if (!my_spi_init(pSPI)) {
@@ -1187,8 +1383,8 @@ static int sd_init(sd_card_t *pSD) {
     sd_lock(pSD);
 
     // Make sure there's a card in the socket before proceeding
-    sd_card_detect(pSD);
-    if (pSD->m_Status & STA_NODISK) {
+    if (!sd_card_detect(pSD)) {
+        printf("No SD card detected!\r\n");
         sd_unlock(pSD);
         return pSD->m_Status;
     }
@@ -1227,8 +1423,17 @@ static int sd_init(sd_card_t *pSD) {
     // Set SCK for data transfer
     sd_spi_go_high_frequency(pSD);
 
+    // Allocation unit for aligning f_mkfs (disk_ioctl GET_BLOCK_SIZE). Not fatal:
+    // without it the card is used as before
+    uint8_t status[64];
+    pSD->au_sectors = 0;
+    pSD->speed_class = 0;
+    pSD->uhs_speed_grade = 0;
+    if (sd_read_status_nolock(pSD, status) == SD_BLOCK_DEVICE_ERROR_NONE)
+        sd_parse_status(pSD, status);
+
     // The card is now initialized
-    pSD->m_Status &= ~STA_NOINIT;
+    sd_status_clear(pSD, STA_NOINIT);
 
     sd_spi_release(pSD);
     sd_unlock(pSD);
@@ -1264,7 +1469,7 @@ static bool sd_test_com(sd_card_t *pSD) {
 
             if (!success) {
                 // Card no longer sensed - ensure card is initialized once re-attached
-                pSD->m_Status |= STA_NOINIT;
+                sd_status_set(pSD, STA_NOINIT);
             }
         } else {
             // SD card is currently holding DO which is sufficient enough to know it's still there
@@ -38,7 +38,7 @@ struct sd_card_t {
     spi_t *spi;
     // Slave select is here instead of in spi_t because multiple SDs can share an SPI.
     uint ss_gpio;                   // Slave select for this SD card
-    bool use_card_detect;
+    bool use_card_detect;     // Edges on card_detect_gpio update m_Status by interrupt
     uint card_detect_gpio;    // Card detect; ignored if !use_card_detect
     uint card_detected_true;  // Varies with card socket; ignored if !use_card_detect
     // Drive strength levels for GPIO outputs.
@@ -48,12 +48,17 @@ struct sd_card_t {
     enum gpio_drive_strength ss_gpio_drive_strength;
 
     // Following fields are used to keep track of the state of the card:
-    int m_Status;                                    // Card status
+    volatile int m_Status;                           // Card status
     uint64_t sectors;                                // Assigned dynamically
     int card_type;                                   // Assigned dynamically
     mutex_t mutex;
     FATFS fatfs;
     bool mounted;
+    uint32_t stream_blocks;                          // Left in sd_write_stream_*()
+    uint16_t stream_crc;                             // Of the block in flight
+    uint32_t au_sectors;                             // Allocation unit from the SD Status; 0 if unknown
+    uint8_t speed_class;                             // Speed class in MB/s (2, 4, 6, 10); 0 if unknown
+    uint8_t uhs_speed_grade;                         // UHS speed grade (1: 10 MB/s, 3: 30 MB/s)
 
     int (*init)(sd_card_t *sd_card_p);
     int (*write_blocks)(sd_card_t *sd_card_p, const uint8_t *buffer,
@@ -89,10 +94,21 @@ struct sd_card_t {
 
 bool sd_card_detect(sd_card_t *pSD);
 uint64_t sd_sectors(sd_card_t *pSD);
+// SD Status register (ACMD13), 64 bytes, most significant byte first
+int sd_read_status(sd_card_t *pSD, uint8_t status[64]);
 
 bool sd_init_driver();
 bool sd_card_detect(sd_card_t *sd_card_p);
 
+// Multiple block write in steps; see sd_card.c
+int sd_write_stream_begin(sd_card_t *pSD, uint64_t ulSectorNumber, uint32_t blockCnt);
+int sd_write_stream_block_start(sd_card_t *pSD, const uint8_t *buffer);
+int sd_write_stream_block_finish(sd_card_t *pSD);
+int sd_write_stream_end(sd_card_t *pSD);
+void sd_write_stream_stop(sd_card_t *pSD);
+int sd_write_stream_status(sd_card_t *pSD);
+bool sd_card_ready(sd_card_t *pSD);
+
 #ifdef __cplusplus
 }
 #endif
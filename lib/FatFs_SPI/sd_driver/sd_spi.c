@@ -91,6 +91,15 @@ bool sd_spi_transfer(sd_card_t *pSD, const uint8_t *tx, uint8_t *rx,
     return spi_transfer(pSD->spi, tx, rx, length);
 }
 
+void sd_spi_transfer_start(sd_card_t *pSD, const uint8_t *tx, uint8_t *rx,
+                           size_t length) {
+    spi_transfer_start(pSD->spi, tx, rx, length);
+}
+
+bool sd_spi_transfer_wait_complete(sd_card_t *pSD, uint32_t timeout_ms) {
+    return spi_transfer_wait_complete(pSD->spi, timeout_ms);
+}
+
 uint8_t sd_spi_write(sd_card_t *pSD, const uint8_t value) {
     // TRACE_PRINTF("%s\n", __FUNCTION__);
     uint8_t received = SPI_FILL_CHAR;
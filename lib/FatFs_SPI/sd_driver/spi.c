@@ -54,12 +54,14 @@ void set_spi_dma_irq_channel(bool useChannel1, bool shared) {
     irqShared = shared;
 }
 
-// SPI Transfer: Read & Write (simultaneously) on SPI bus
+// Start an SPI transfer: Read & Write (simultaneously) on SPI bus
 //   If the data that will be received is not important, pass NULL as rx.
 //   If the data that will be transmitted is not important,
 //     pass NULL as tx and then the SPI_FILL_CHAR is sent out as each data
 //     element.
-bool spi_transfer(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
+// Returns as soon as the DMA is running, so transfers on different SPIs can
+// overlap; finish with spi_transfer_wait_complete().
+void spi_transfer_start(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
     // assert(512 == length || 1 == length);
     assert(tx || rx);
     // assert(!(tx && rx));
@@ -110,11 +112,13 @@ bool spi_transfer(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
     // start them exactly simultaneously to avoid races (in extreme cases
     // the FIFO could overflow)
     dma_start_channel_mask((1u << spi_p->tx_dma) | (1u << spi_p->rx_dma));
+}
 
+// Wait for the transfer begun by spi_transfer_start()
+bool spi_transfer_wait_complete(spi_t *spi_p, uint32_t timeout_ms) {
     /* Wait until master completes transfer or time out has occured. */
-    uint32_t timeOut = 1000; /* Timeout 1 sec */
     bool rc = sem_acquire_timeout_ms(
-        &spi_p->sem, timeOut);  // Wait for notification from ISR
+        &spi_p->sem, timeout_ms);  // Wait for notification from ISR
     if (!rc) {
         // If the timeout is reached the function will return false
         DBG_PRINTF("Notification wait timed out in %s\n", __FUNCTION__);
@@ -131,6 +135,12 @@ bool spi_transfer(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
     return true;
 }
 
+// SPI Transfer: Read & Write (simultaneously) on SPI bus
+bool spi_transfer(spi_t *spi_p, const uint8_t *tx, uint8_t *rx, size_t length) {
+    spi_transfer_start(spi_p, tx, rx, length);
+    return spi_transfer_wait_complete(spi_p, 1000); /* Timeout 1 sec */
+}
+
 void spi_lock(spi_t *spi_p) {
     assert(mutex_is_initialized(&spi_p->mutex));
     mutex_enter_blocking(&spi_p->mutex);
@@ -219,6 +229,8 @@ bool my_spi_init(spi_t *spi_p) {
 
         // Tell the DMA to raise IRQ line 0/1 when the channel finishes a block        
         static void (*spi_irq_handler_p)();
+        // The handlers serve every SPI on their IRQ line; install each only once
+        static bool handler_installed[2];
         switch (spi_p->DMA_IRQ_num) {
         case DMA_IRQ_0:
             spi_irq_handler_p = spi_irq_handler_0;
@@ -233,13 +245,17 @@ bool my_spi_init(spi_t *spi_p) {
         default:
             assert(false);
         }
-        if (irqShared) {
+        bool *installed_p = &handler_installed[spi_p->DMA_IRQ_num == DMA_IRQ_1];
+        if (*installed_p) {
+            // Already serving an earlier SPI
+        } else if (irqShared) {
             irq_add_shared_handler(
                 spi_p->DMA_IRQ_num, *spi_irq_handler_p,
                 PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
         } else {
             irq_set_exclusive_handler(spi_p->DMA_IRQ_num, *spi_irq_handler_p);
         }
+        *installed_p = true;
         irq_set_enabled(spi_p->DMA_IRQ_num, true);
         LED_INIT();
         spi_p->initialized = true;
@@ -20,11 +20,16 @@ specific language governing permissions and limitations under the License.
 /* storage control modules to the FatFs module with a defined API.       */
 /*-----------------------------------------------------------------------*/
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+//
+#include "pico/stdlib.h"
 //
 #include "ff.h" /* Obtains integer types */
 //
 #include "diskio.h" /* Declarations of disk functions */
 //
+#include "disk_cache.h"
 #include "hw_config.h"
 #include "my_debug.h"
 #include "sd_card.h"
@@ -32,6 +37,271 @@ specific language governing permissions and limitations under the License.
 #define TRACE_PRINTF(fmt, args...)
 //#define TRACE_PRINTF printf  // task_printf
 
+/*-----------------------------------------------------------------------*/
+/* Write-behind block cache                                              */
+/*-----------------------------------------------------------------------*/
+/* While logging, FatFs rewrites the same FAT and directory sectors over
+and over, and hands us file data one sector at a time. Holding dirty
+sectors here lets repeated rewrites of a sector cost one card write, and
+lets runs of adjacent sectors go out as a single multi-block write
+(CMD25) instead of one CMD24 each. Dirty sectors are written back when a
+line must be evicted, on CTRL_SYNC, from disk_cache_flush() (unmount) and
+once the oldest dirty sector has waited DISK_CACHE_FLUSH_MS. */
+
+#ifndef DISK_CACHE_SECTORS
+#define DISK_CACHE_SECTORS 16  // Number of 512-byte sectors held in RAM
+#endif
+#ifndef DISK_CACHE_FLUSH_MS
+#define DISK_CACHE_FLUSH_MS 1000  // Max age of a dirty sector; 0 disables
+#endif
+
+typedef struct {
+    LBA_t sector;
+    uint32_t last_use;  // Value of use_clock at last access, for LRU
+    BYTE pdrv;
+    bool valid;
+    bool dirty;
+    BYTE data[FF_MAX_SS] __attribute__((aligned(4)));
+} cache_line_t;
+
+static cache_line_t cache[DISK_CACHE_SECTORS];
+static uint32_t use_clock;
+static bool dirty_pending;
+static absolute_time_t first_dirty_time;  // When the oldest dirty line got dirty
+// Multi-block writes need one contiguous buffer
+static BYTE coalesce_buf[DISK_CACHE_SECTORS * FF_MAX_SS] __attribute__((aligned(4)));
+
+static cache_line_t *cache_find(BYTE pdrv, LBA_t sector) {
+    for (size_t i = 0; i < count_of(cache); ++i) {
+        cache_line_t *line = &cache[i];
+        if (line->valid && line->pdrv == pdrv && line->sector == sector)
+            return line;
+    }
+    return NULL;
+}
+
+static void cache_touch(cache_line_t *line) { line->last_use = ++use_clock; }
+
+static int cmp_line_sector(const void *a, const void *b) {
+    const cache_line_t *la = *(const cache_line_t **)a;
+    const cache_line_t *lb = *(const cache_line_t **)b;
+    if (la->sector < lb->sector) return -1;
+    return la->sector > lb->sector;
+}
+
+static void update_dirty_pending() {
+    for (size_t i = 0; i < count_of(cache); ++i) {
+        if (cache[i].valid && cache[i].dirty) return;
+    }
+    dirty_pending = false;
+}
+
+// Write back every dirty line of a drive, merging adjacent LBAs
+static int cache_flush_drive(BYTE pdrv) {
+    cache_line_t *dirty[DISK_CACHE_SECTORS];
+    size_t n = 0;
+    for (size_t i = 0; i < count_of(cache); ++i) {
+        if (cache[i].valid && cache[i].dirty && cache[i].pdrv == pdrv)
+            dirty[n++] = &cache[i];
+    }
+    if (!n) return SD_BLOCK_DEVICE_ERROR_NONE;
+    sd_card_t *p_sd = sd_get_by_num(pdrv);
+    if (!p_sd) return SD_BLOCK_DEVICE_ERROR_PARAMETER;
+    // Card pulled: the lines are dropped when the next card is initialized
+    if (p_sd->m_Status & STA_NODISK) return SD_BLOCK_DEVICE_ERROR_NO_DEVICE;
+
+    qsort(dirty, n, sizeof dirty[0], cmp_line_sector);
+    for (size_t i = 0; i < n;) {
+        size_t run = 1;
+        while (i + run < n && dirty[i + run]->sector == dirty[i]->sector + run)
+            ++run;
+        int rc;
+        if (1 == run) {
+            rc = p_sd->write_blocks(p_sd, dirty[i]->data, dirty[i]->sector, 1);
+        } else {
+            for (size_t j = 0; j < run; ++j)
+                memcpy(coalesce_buf + j * FF_MAX_SS, dirty[i + j]->data, FF_MAX_SS);
+            rc = p_sd->write_blocks(p_sd, coalesce_buf, dirty[i]->sector, run);
+        }
+        if (SD_BLOCK_DEVICE_ERROR_NONE != rc) {
+            DBG_PRINTF("%s: write of %zu sectors at %llu failed: %d\n", __func__,
+                       run, (unsigned long long)dirty[i]->sector, rc);
+            return rc;
+        }
+        for (size_t j = 0; j < run; ++j) dirty[i + j]->dirty = false;
+        i += run;
+    }
+    update_dirty_pending();
+    return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+
+static int cache_flush_all() {
+    int rc = SD_BLOCK_DEVICE_ERROR_NONE;
+    for (size_t pdrv = 0; pdrv < sd_get_num(); ++pdrv) {
+        int drc = cache_flush_drive(pdrv);
+        if (SD_BLOCK_DEVICE_ERROR_NONE != drc) rc = drc;
+    }
+    return rc;
+}
+
+// Enforce the time budget on dirty data
+static void cache_check_age() {
+    if (DISK_CACHE_FLUSH_MS && dirty_pending &&
+        absolute_time_diff_us(first_dirty_time, get_absolute_time()) >
+            DISK_CACHE_FLUSH_MS * 1000LL)
+        cache_flush_all();
+}
+
+// Pick a line for (pdrv, sector): a hit, a free line or the LRU victim
+static int cache_get_line(BYTE pdrv, LBA_t sector, cache_line_t **line_pp) {
+    cache_line_t *line = cache_find(pdrv, sector);
+    if (line) {
+        *line_pp = line;
+        return SD_BLOCK_DEVICE_ERROR_NONE;
+    }
+    cache_line_t *victim = NULL;
+    for (size_t i = 0; i < count_of(cache); ++i) {
+        if (!cache[i].valid) {
+            victim = &cache[i];
+            break;
+        }
+        if (!victim || cache[i].last_use < victim->last_use) victim = &cache[i];
+    }
+    if (victim->valid && victim->dirty) {
+        // The victim is probably part of a sequential run; write back all of
+        // its drive's dirty lines together.
+        int rc = cache_flush_drive(victim->pdrv);
+        if (SD_BLOCK_DEVICE_ERROR_NONE != rc) return rc;
+    }
+    victim->valid = false;
+    victim->dirty = false;
+    victim->pdrv = pdrv;
+    victim->sector = sector;
+    *line_pp = victim;
+    return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+
+// Drops the lines of a sector range without writing them back
+static void cache_invalidate_range(BYTE pdrv, LBA_t sector, UINT count) {
+    for (size_t i = 0; i < count_of(cache); ++i) {
+        cache_line_t *line = &cache[i];
+        if (line->valid && line->pdrv == pdrv && line->sector >= sector &&
+            line->sector < sector + count) {
+            line->valid = false;
+            line->dirty = false;
+        }
+    }
+    update_dirty_pending();
+}
+
+static void cache_invalidate_drive(BYTE pdrv) {
+    for (size_t i = 0; i < count_of(cache); ++i) {
+        cache_line_t *line = &cache[i];
+        if (line->valid && line->pdrv == pdrv) {
+            if (line->dirty)
+                DBG_PRINTF("%s: dropping dirty sector %llu\n", __func__,
+                           (unsigned long long)line->sector);
+            line->valid = false;
+            line->dirty = false;
+        }
+    }
+    update_dirty_pending();
+}
+
+/*-----------------------------------------------------------------------*/
+/* Read cache                                                            */
+/*-----------------------------------------------------------------------*/
+/* FatFs keeps a single sector window per volume, so walking a cluster
+chain or scanning a directory re-reads the same FAT and directory sectors
+every time the window moves away. Only sectors in front of the data
+area of a mounted volume (boot sector, FSInfo, FAT and the FAT12/16 root
+directory) are kept here: FatFs also reads file data one sector at a
+time, and letting it in would evict the FAT sectors the cache is for.
+Lines are invalidated when the sector is written. */
+
+#ifndef DISK_READ_CACHE_SECTORS
+#define DISK_READ_CACHE_SECTORS 8  // 0 disables the read cache
+#endif
+
+#if DISK_READ_CACHE_SECTORS
+typedef struct {
+    LBA_t sector;
+    uint32_t last_use;
+    BYTE pdrv;
+    bool valid;
+    BYTE data[FF_MAX_SS] __attribute__((aligned(4)));
+} rd_line_t;
+
+static rd_line_t rd_cache[DISK_READ_CACHE_SECTORS];
+#endif
+static uint32_t rd_hits, rd_misses, wr_hits;
+
+static void rd_cache_invalidate(BYTE pdrv, LBA_t sector, UINT count) {
+#if DISK_READ_CACHE_SECTORS
+    for (size_t i = 0; i < count_of(rd_cache); ++i) {
+        rd_line_t *line = &rd_cache[i];
+        if (line->valid && line->pdrv == pdrv && line->sector >= sector &&
+            line->sector < sector + count)
+            line->valid = false;
+    }
+#endif
+}
+
+// Single-sector read through the read cache
+static int rd_cache_read(sd_card_t *p_sd, BYTE pdrv, BYTE *buff, LBA_t sector) {
+#if DISK_READ_CACHE_SECTORS
+    // Data area: file contents and (FAT32/exFAT) directories go straight
+    // to the card. Before the volume is mounted everything is metadata.
+    if (p_sd->fatfs.fs_type && sector >= p_sd->fatfs.database) {
+        ++rd_misses;
+        return p_sd->read_blocks(p_sd, buff, sector, 1);
+    }
+    rd_line_t *victim = NULL;
+    for (size_t i = 0; i < count_of(rd_cache); ++i) {
+        rd_line_t *line = &rd_cache[i];
+        if (line->valid && line->pdrv == pdrv && line->sector == sector) {
+            ++rd_hits;
+            line->last_use = ++use_clock;
+            memcpy(buff, line->data, FF_MAX_SS);
+            return SD_BLOCK_DEVICE_ERROR_NONE;
+        }
+        if (!victim || (victim->valid && (!line->valid ||
+                                          line->last_use < victim->last_use)))
+            victim = line;
+    }
+    ++rd_misses;
+    victim->valid = false;
+    int rc = p_sd->read_blocks(p_sd, victim->data, sector, 1);
+    if (SD_BLOCK_DEVICE_ERROR_NONE != rc) return rc;
+    victim->pdrv = pdrv;
+    victim->sector = sector;
+    victim->last_use = ++use_clock;
+    victim->valid = true;
+    memcpy(buff, victim->data, FF_MAX_SS);
+    return SD_BLOCK_DEVICE_ERROR_NONE;
+#else
+    ++rd_misses;
+    return p_sd->read_blocks(p_sd, buff, sector, 1);
+#endif
+}
+
+int disk_cache_flush(BYTE pdrv) { return cache_flush_drive(pdrv); }
+
+void disk_cache_task() { cache_check_age(); }
+
+void disk_cache_invalidate(BYTE pdrv, LBA_t sector, UINT count) {
+    cache_invalidate_range(pdrv, sector, count);
+    rd_cache_invalidate(pdrv, sector, count);
+}
+
+void disk_cache_get_stats(disk_cache_stats_t *stats) {
+    stats->read_hits = rd_hits;
+    stats->read_misses = rd_misses;
+    stats->write_hits = wr_hits;
+}
+
+void disk_cache_reset_stats() { rd_hits = rd_misses = wr_hits = 0; }
+
 /*-----------------------------------------------------------------------*/
 /* Get Drive Status                                                      */
 /*-----------------------------------------------------------------------*/
@@ -41,7 +311,7 @@ DSTATUS disk_status(BYTE pdrv /* Physical drive nmuber to identify the drive */
     TRACE_PRINTF(">>> %s\n", __FUNCTION__);
     sd_card_t *p_sd = sd_get_by_num(pdrv);
     if (!p_sd) return RES_PARERR;
-    sd_card_detect(p_sd);   // Fast: just a GPIO read
+    // STA_NODISK is maintained by the card detect interrupt
     return p_sd->m_Status;  // See http://elm-chan.org/fsw/ff/doc/dstat.html
 }
 
@@ -59,6 +329,11 @@ DSTATUS disk_initialize(
 
     sd_card_t *p_sd = sd_get_by_num(pdrv);
     if (!p_sd) return RES_PARERR;
+    // Whatever is cached may belong to a card that has since been swapped
+    if (p_sd->m_Status & STA_NOINIT) {
+        cache_invalidate_drive(pdrv);
+        rd_cache_invalidate(pdrv, 0, ~(UINT)0);
+    }
     // See http://elm-chan.org/fsw/ff/doc/dstat.html
     return p_sd->init(p_sd);  
 }
@@ -98,8 +373,28 @@ DRESULT disk_read(BYTE pdrv,  /* Physical drive nmuber to identify the drive */
     TRACE_PRINTF(">>> %s\n", __FUNCTION__);
     sd_card_t *p_sd = sd_get_by_num(pdrv);
     if (!p_sd) return RES_PARERR;
+    cache_check_age();
+    if (1 == count) {
+        cache_line_t *line = cache_find(pdrv, sector);
+        if (line) {
+            ++wr_hits;
+            cache_touch(line);
+            memcpy(buff, line->data, FF_MAX_SS);
+            return RES_OK;
+        }
+        return sdrc2dresult(rd_cache_read(p_sd, pdrv, buff, sector));
+    }
     int rc = p_sd->read_blocks(p_sd, buff, sector, count);
-    return sdrc2dresult(rc);
+    if (SD_BLOCK_DEVICE_ERROR_NONE != rc) return sdrc2dresult(rc);
+    // The card doesn't have the sectors still waiting in the cache yet
+    for (size_t i = 0; dirty_pending && i < count_of(cache); ++i) {
+        cache_line_t *line = &cache[i];
+        if (line->valid && line->dirty && line->pdrv == pdrv &&
+            line->sector >= sector && line->sector < sector + count)
+            memcpy(buff + (line->sector - sector) * FF_MAX_SS, line->data,
+                   FF_MAX_SS);
+    }
+    return RES_OK;
 }
 
 /*-----------------------------------------------------------------------*/
@@ -116,8 +411,29 @@ DRESULT disk_write(BYTE pdrv, /* Physical drive nmuber to identify the drive */
     TRACE_PRINTF(">>> %s\n", __FUNCTION__);
     sd_card_t *p_sd = sd_get_by_num(pdrv);
     if (!p_sd) return RES_PARERR;
-    int rc = p_sd->write_blocks(p_sd, buff, sector, count);
-    return sdrc2dresult(rc);
+    rd_cache_invalidate(pdrv, sector, count);
+    if (count > DISK_CACHE_SECTORS / 2) {
+        // Big transfers are already efficient: write through, dropping
+        // the cached copies they supersede
+        cache_invalidate_range(pdrv, sector, count);
+        int rc = p_sd->write_blocks(p_sd, buff, sector, count);
+        return sdrc2dresult(rc);
+    }
+    for (UINT i = 0; i < count; ++i) {
+        cache_line_t *line;
+        int rc = cache_get_line(pdrv, sector + i, &line);
+        if (SD_BLOCK_DEVICE_ERROR_NONE != rc) return sdrc2dresult(rc);
+        memcpy(line->data, buff + i * FF_MAX_SS, FF_MAX_SS);
+        line->valid = true;
+        line->dirty = true;
+        cache_touch(line);
+        if (!dirty_pending) {
+            dirty_pending = true;
+            first_dirty_time = get_absolute_time();
+        }
+    }
+    cache_check_age();
+    return RES_OK;
 }
 
 #endif
@@ -156,12 +472,19 @@ DRESULT disk_ioctl(BYTE pdrv, /* Physical drive nmuber (0..) */
                                 // f_mkfs function and it attempts to align data
                                 // area on the erase block boundary. It is
                                 // required when FF_USE_MKFS == 1.
-            static DWORD bs = 1;
+            // The allocation unit from the SD Status. A 12 or 24 MiB AU
+            // aligns on its largest power-of-2 divisor, and FatFs caps
+            // the value at 32768 sectors (16 MiB)
+            DWORD bs = p_sd->au_sectors & -p_sd->au_sectors;
+            if (bs == 0) bs = 1;
+            if (bs > 32768) bs = 32768;
             *(DWORD *)buff = bs;
             return RES_OK;
         }
+        case MMC_GET_SDSTAT:  // Receives the SD Status (ACMD13), 64 bytes
+            return sdrc2dresult(sd_read_status(p_sd, buff));
         case CTRL_SYNC:
-            return RES_OK;
+            return sdrc2dresult(cache_flush_drive(pdrv));
         default:
             return RES_PARERR;
     }
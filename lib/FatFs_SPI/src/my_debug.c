@@ -11,23 +11,259 @@ under the License is distributed on an AS IS BASIS, WITHOUT WARRANTIES OR
 CONDITIONS OF ANY KIND, either express or implied. See the License for the 
 specific language governing permissions and limitations under the License.
 */
-#include <stdio.h>
 #include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hardware/sync.h"
+
 #include "my_debug.h"
 
+/* Deferred logging: callers only record the format pointer and their arguments
+   into a ring; the formatting and the (slow) USB output happen later, in
+   my_log_drain(), from idle time. The format string must therefore have static
+   storage, which is the case for every literal. String arguments are copied
+   since they may live on the caller's stack.
+
+   The Cortex-M0+ has no LDREX/STREX, so producers (either core, thread or IRQ)
+   claim a slot under a hardware spin lock held for a few instructions only.
+   The slot is then filled outside the lock and published with a ready flag. */
+
+#define LOG_ARGS_MAX 8
+#define LOG_STR_BYTES 48
+
+typedef enum {
+    ARG_INT,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_SIZE,
+    ARG_DOUBLE,
+    ARG_PTR,
+    ARG_STR
+} arg_type_t;
+
+typedef struct {
+    const char *fmt;
+    volatile bool ready;
+    uint8_t nargs;
+    uint8_t types[LOG_ARGS_MAX];
+    union {
+        long long ll;
+        double d;
+        const void *p;
+        uint16_t str_ofs; /* Offset into str[] */
+    } args[LOG_ARGS_MAX];
+    char str[LOG_STR_BYTES];
+} log_entry_t;
+
+static log_entry_t log_ring[MY_LOG_ENTRIES];
+static volatile uint32_t log_head; /* Next slot to claim */
+static volatile uint32_t log_tail; /* Next slot to print */
+static volatile uint32_t log_dropped;
+static uint32_t log_dropped_reported;
+
+static inline spin_lock_t *log_lock(void) {
+    /* Striped locks need no claim and are meant for short critical sections */
+    return spin_lock_instance(PICO_SPINLOCK_ID_STRIPED_FIRST);
+}
+
+/* Returns the end of the conversion spec starting at *fmt == '%', or NULL for "%%".
+   *stars receives the number of '*' (width/precision taken from arguments). */
+static const char *parse_spec(const char *fmt, arg_type_t *type, int *stars, char *conv) {
+    const char *p = fmt + 1;
+    *stars = 0;
+    if (*p == '%') return NULL;
+    while (*p && strchr("-+ #0", *p)) p++;
+    while (*p == '*' || (*p >= '0' && *p <= '9') || *p == '.') {
+        if (*p == '*') (*stars)++;
+        p++;
+    }
+    int longs = 0;
+    bool size = false;
+    while (*p && strchr("hlzjtL", *p)) {
+        if (*p == 'l') longs++;
+        if (*p == 'z' || *p == 't') size = true;
+        if (*p == 'j') longs = 2;
+        p++;
+    }
+    *conv = *p;
+    switch (*p) {
+        case 's':
+            *type = ARG_STR;
+            break;
+        case 'p':
+            *type = ARG_PTR;
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+            *type = ARG_DOUBLE;
+            break;
+        default:
+            *type = size ? ARG_SIZE : longs >= 2 ? ARG_LLONG : longs ? ARG_LONG : ARG_INT;
+            break;
+    }
+    return *p ? p + 1 : p;
+}
+
+void my_vprintf(const char *pcFormat, va_list xArgs) {
+    uint32_t save = spin_lock_blocking(log_lock());
+    uint32_t head = log_head;
+    if (head - log_tail >= MY_LOG_ENTRIES) {
+        log_dropped++;
+        spin_unlock(log_lock(), save);
+        return;
+    }
+    log_head = head + 1;
+    spin_unlock(log_lock(), save);
+
+    log_entry_t *e = &log_ring[head % MY_LOG_ENTRIES];
+    e->fmt = pcFormat;
+    e->nargs = 0;
+    size_t str_used = 0;
+    for (const char *p = pcFormat; *p && e->nargs < LOG_ARGS_MAX;) {
+        if (*p++ != '%') continue;
+        arg_type_t type;
+        int stars;
+        char conv;
+        const char *end = parse_spec(p - 1, &type, &stars, &conv);
+        if (!end) {
+            p++;
+            continue;
+        }
+        p = end;
+        for (int i = 0; i < stars && e->nargs < LOG_ARGS_MAX; i++) {
+            e->types[e->nargs] = ARG_INT;
+            e->args[e->nargs++].ll = va_arg(xArgs, int);
+        }
+        if (e->nargs >= LOG_ARGS_MAX || conv == 'n' || !conv) break;
+        e->types[e->nargs] = type;
+        switch (type) {
+            case ARG_INT:
+                e->args[e->nargs].ll = va_arg(xArgs, int);
+                break;
+            case ARG_LONG:
+                e->args[e->nargs].ll = va_arg(xArgs, long);
+                break;
+            case ARG_LLONG:
+                e->args[e->nargs].ll = va_arg(xArgs, long long);
+                break;
+            case ARG_SIZE:
+                e->args[e->nargs].ll = (long long)va_arg(xArgs, size_t);
+                break;
+            case ARG_DOUBLE:
+                e->args[e->nargs].d = va_arg(xArgs, double);
+                break;
+            case ARG_PTR:
+                e->args[e->nargs].p = va_arg(xArgs, void *);
+                break;
+            case ARG_STR: {
+                const char *s = va_arg(xArgs, const char *);
+                if (!s) s = "(null)";
+                size_t room = sizeof(e->str) - str_used;
+                size_t n = strnlen(s, room ? room - 1 : 0);
+                if (room) {
+                    memcpy(e->str + str_used, s, n);
+                    e->str[str_used + n] = '\0';
+                }
+                e->args[e->nargs].str_ofs = (uint16_t)(room ? str_used : sizeof(e->str) - 1);
+                str_used += room ? n + 1 : 0;
+                break;
+            }
+        }
+        e->nargs++;
+    }
+    __dmb();
+    e->ready = true;
+}
+
 void my_printf(const char *pcFormat, ...) {
-    char pcBuffer[256] = {0};
     va_list xArgs;
     va_start(xArgs, pcFormat);
-    vsnprintf(pcBuffer, sizeof(pcBuffer), pcFormat, xArgs);
+    my_vprintf(pcFormat, xArgs);
     va_end(xArgs);
-    printf("%s", pcBuffer);
-    fflush(stdout);
 }
 
+/* Print one recorded entry, one conversion at a time */
+static void print_entry(const log_entry_t *e) {
+    char spec[32];
+    int arg = 0;
+    const char *p = e->fmt;
+    while (*p) {
+        const char *pct = strchr(p, '%');
+        if (!pct) {
+            fputs(p, stdout);
+            break;
+        }
+        fwrite(p, 1, pct - p, stdout);
+        arg_type_t type;
+        int stars;
+        char conv;
+        const char *end = parse_spec(pct, &type, &stars, &conv);
+        if (!end) {
+            putchar('%');
+            p = pct + 2;
+            continue;
+        }
+        size_t len = end - pct;
+        if (arg + stars >= e->nargs || len >= sizeof(spec)) {
+            /* Arguments beyond LOG_ARGS_MAX were not recorded */
+            fputs(pct, stdout);
+            break;
+        }
+        memcpy(spec, pct, len);
+        spec[len] = '\0';
+        int w[2] = {0, 0};
+        for (int i = 0; i < stars; i++) w[i & 1] = (int)e->args[arg++].ll;
+        long long ll = e->args[arg].ll;
+#define EMIT(val)                                 \
+    do {                                          \
+        if (stars == 2) printf(spec, w[0], w[1], val); \
+        else if (stars == 1) printf(spec, w[0], val);  \
+        else printf(spec, val);                   \
+    } while (0)
+        switch (e->types[arg]) {
+            case ARG_INT: EMIT((int)ll); break;
+            case ARG_LONG: EMIT((long)ll); break;
+            case ARG_LLONG: EMIT(ll); break;
+            case ARG_SIZE: EMIT((size_t)ll); break;
+            case ARG_DOUBLE: EMIT(e->args[arg].d); break;
+            case ARG_PTR: EMIT(e->args[arg].p); break;
+            case ARG_STR: EMIT(e->str + e->args[arg].str_ofs); break;
+        }
+#undef EMIT
+        arg++;
+        p = end;
+    }
+}
+
+void my_log_drain(void) {
+    bool printed = false;
+    while (log_tail != log_head) {
+        log_entry_t *e = &log_ring[log_tail % MY_LOG_ENTRIES];
+        if (!e->ready) break; /* Claimed but still being filled */
+        __dmb();
+        print_entry(e);
+        e->ready = false;
+        __dmb();
+        log_tail++;
+        printed = true;
+    }
+    uint32_t dropped = log_dropped;
+    if (dropped != log_dropped_reported) {
+        printf("[log] %lu messages dropped\n", (unsigned long)(dropped - log_dropped_reported));
+        log_dropped_reported = dropped;
+        printed = true;
+    }
+    if (printed) fflush(stdout);
+}
+
+uint32_t my_log_dropped(void) {
+    return log_dropped;
+}
 
 void my_assert_func(const char *file, int line, const char *func,
                     const char *pred) {
+    my_log_drain(); /* Show what led here before halting */
     printf("assertion \"%s\" failed: file \"%s\", line %d, function: %s\n",
            pred, file, line, func);
     fflush(stdout);
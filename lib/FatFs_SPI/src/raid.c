@@ -0,0 +1,328 @@
+/* raid.c
+Sequential logging to two SD cards, striped or mirrored; see raid.h.
+
+The member files are reserved with f_expand(), so each one is a single run of
+sectors and data is written straight to the cards with the streaming calls
+of sd_card.c, bypassing FatFs and the sector caches. Only the directory
+entries go through FatFs: at open, with the preallocated size, and at close,
+trimmed to the data actually written. Whatever glue.c still holds for those
+sectors (from an earlier file that used them) is invalidated before they are
+streamed, so it is neither read back nor flushed over the new data.
+
+A stream never stays open between calls, since the application may reach the
+same card through FatFs in the meantime (sd_acquire() isn't recursive). A
+mirror write is ended with sd_write_stream_stop() instead, which leaves the
+card programming its last block on its own; the result is checked with CMD13
+the next time the card is found ready.
+*/
+#include <stdio.h>
+#include <string.h>
+//
+#include "pico/stdlib.h"
+//
+#include "ff.h"
+#include "diskio.h"  // STA_NODISK
+//
+#include "disk_cache.h"
+#include "hw_config.h"
+#include "my_debug.h"
+#include "raid.h"
+#include "sd_card.h"
+
+static const uint8_t *unit_sector(raid_t *r, size_t member, uint32_t i) {
+    return r->stage + ((size_t)member * r->unit_sectors + i) * FF_MAX_SS;
+}
+
+// Mirror ring slot of logical sector i
+static uint8_t *ring_sector(raid_t *r, uint32_t i) {
+    return r->stage + (size_t)(i % r->stage_sectors) * FF_MAX_SS;
+}
+
+// Drops glue.c's copies of sectors about to be streamed to member m
+static void forget_cached(raid_t *r, size_t m, LBA_t sector, uint32_t count) {
+    disk_cache_invalidate(r->file[m].obj.fs->pdrv, sector, count);
+}
+
+// Writes the first count staged sectors as row r->rows: every card receives
+// its share in one multiple block write, one block on each card at a time
+static int write_row(raid_t *r, uint32_t count) {
+    uint32_t n[RAID_MEMBERS];
+    bool begun[RAID_MEMBERS] = {false};
+    int rc = SD_BLOCK_DEVICE_ERROR_NONE;
+
+    if ((r->rows + 1) * r->unit_sectors > r->member_sectors)
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;  // Preallocation used up
+    for (size_t m = 0; m < RAID_MEMBERS; ++m) {
+        uint32_t before = m * r->unit_sectors;
+        n[m] = count > before ? count - before : 0;
+        if (n[m] > r->unit_sectors) n[m] = r->unit_sectors;
+    }
+    for (size_t m = 0; m < RAID_MEMBERS && n[m]; ++m) {
+        LBA_t sector = r->base[m] + (LBA_t)r->rows * r->unit_sectors;
+        forget_cached(r, m, sector, n[m]);
+        rc = sd_write_stream_begin(r->card[m], sector, n[m]);
+        if (SD_BLOCK_DEVICE_ERROR_NONE != rc) break;
+        begun[m] = true;
+    }
+    for (uint32_t i = 0; SD_BLOCK_DEVICE_ERROR_NONE == rc && i < n[0]; ++i) {
+        bool started[RAID_MEMBERS] = {false};
+        for (size_t m = 0; m < RAID_MEMBERS && i < n[m]; ++m) {
+            rc = sd_write_stream_block_start(r->card[m], unit_sector(r, m, i));
+            if (SD_BLOCK_DEVICE_ERROR_NONE != rc) break;
+            started[m] = true;
+        }
+        for (size_t m = 0; m < RAID_MEMBERS && started[m]; ++m) {
+            int frc = sd_write_stream_block_finish(r->card[m]);
+            if (SD_BLOCK_DEVICE_ERROR_NONE == rc) rc = frc;
+        }
+    }
+    for (size_t m = 0; m < RAID_MEMBERS && begun[m]; ++m) {
+        int erc = sd_write_stream_end(r->card[m]);
+        if (SD_BLOCK_DEVICE_ERROR_NONE == rc) rc = erc;
+    }
+    if (SD_BLOCK_DEVICE_ERROR_NONE != rc)
+        DBG_PRINTF("%s: row %lu failed: %d\n", __func__, (unsigned long)r->rows, rc);
+    return rc;
+}
+
+static void member_failed(raid_t *r, size_t m, int rc) {
+    r->failed[m] = true;
+    r->status_due[m] = false;
+    printf("RAID: drive \"%s\" dropped (%d) after %lu sectors; %u left\n",
+           r->card[m]->pcName, rc, (unsigned long)r->tail[m],
+           (unsigned)raid_members_active(r));
+}
+
+// Opens a multiple block write on card m if it's ready and has unit_sectors
+// queued (anything when flushing); returns its length, 0 if none. The result
+// of the card's previous write is checked first.
+static uint32_t mirror_begin(raid_t *r, size_t m, bool flush) {
+    uint32_t queued = r->head - r->tail[m];
+    bool due = queued && (flush || queued >= r->unit_sectors);
+    if (r->failed[m] || (!due && !r->status_due[m])) return 0;
+    if (r->card[m]->m_Status & STA_NODISK) {
+        member_failed(r, m, SD_BLOCK_DEVICE_ERROR_NO_DEVICE);
+        return 0;
+    }
+    if (!sd_card_ready(r->card[m])) return 0;  // Still programming
+    if (r->status_due[m]) {
+        r->status_due[m] = false;
+        int rc = sd_write_stream_status(r->card[m]);
+        if (SD_BLOCK_DEVICE_ERROR_NONE != rc) {
+            member_failed(r, m, rc);
+            return 0;
+        }
+    }
+    if (!due) return 0;
+    uint32_t n = queued < r->unit_sectors ? queued : r->unit_sectors;
+    forget_cached(r, m, r->base[m] + r->tail[m], n);
+    int rc = sd_write_stream_begin(r->card[m], r->base[m] + r->tail[m], n);
+    if (SD_BLOCK_DEVICE_ERROR_NONE != rc) {  // Card already released
+        member_failed(r, m, rc);
+        return 0;
+    }
+    return n;
+}
+
+// Runs the mirror queues until no card can take more: one block at a time on
+// every open write, overlapping on the SPIs. A card that becomes ready joins
+// at the next block instead of waiting for the other's write to end, and a
+// busy one is simply left out, so neither holds the other back.
+static void mirror_service(raid_t *r, bool flush) {
+    uint32_t left[RAID_MEMBERS] = {0};  // Blocks still to send in each write
+    uint32_t sent[RAID_MEMBERS] = {0};
+
+    for (;;) {
+        bool open = false;
+        for (size_t m = 0; m < RAID_MEMBERS; ++m) {
+            if (!left[m]) {
+                left[m] = mirror_begin(r, m, flush);
+                sent[m] = 0;
+            }
+            if (left[m]) open = true;
+        }
+        if (!open) return;
+        int rc[RAID_MEMBERS] = {0};
+        bool started[RAID_MEMBERS] = {false};
+        for (size_t m = 0; m < RAID_MEMBERS; ++m) {
+            if (!left[m]) continue;
+            rc[m] = sd_write_stream_block_start(
+                r->card[m], ring_sector(r, r->tail[m] + sent[m]));
+            started[m] = SD_BLOCK_DEVICE_ERROR_NONE == rc[m];
+        }
+        for (size_t m = 0; m < RAID_MEMBERS; ++m)
+            if (started[m]) rc[m] = sd_write_stream_block_finish(r->card[m]);
+        for (size_t m = 0; m < RAID_MEMBERS; ++m) {
+            if (!left[m]) continue;
+            if (SD_BLOCK_DEVICE_ERROR_NONE != rc[m]) {
+                sd_write_stream_end(r->card[m]);
+                member_failed(r, m, rc[m]);
+                left[m] = 0;
+            } else if (++sent[m], !--left[m]) {
+                // Slots are only released once the whole write is sent
+                sd_write_stream_stop(r->card[m]);
+                r->tail[m] += sent[m];
+                r->status_due[m] = true;
+            }
+        }
+    }
+}
+
+static int mirror_write(raid_t *r, const uint8_t *sector) {
+    if (r->head >= r->member_sectors)
+        return SD_BLOCK_DEVICE_ERROR_PARAMETER;  // Preallocation used up
+    absolute_time_t deadline = make_timeout_time_ms(RAID_STALL_MS);
+    for (;;) {
+        size_t slowest = RAID_MEMBERS;
+        for (size_t m = 0; m < RAID_MEMBERS; ++m)
+            if (!r->failed[m] && (RAID_MEMBERS == slowest ||
+                                  r->tail[m] < r->tail[slowest]))
+                slowest = m;
+        if (RAID_MEMBERS == slowest) return SD_BLOCK_DEVICE_ERROR_NO_DEVICE;
+        if (r->head - r->tail[slowest] < r->stage_sectors) break;  // Room
+        if (absolute_time_diff_us(get_absolute_time(), deadline) <= 0) {
+            member_failed(r, slowest, SD_BLOCK_DEVICE_ERROR_WRITE);
+            deadline = make_timeout_time_ms(RAID_STALL_MS);
+        } else {
+            mirror_service(r, false);
+        }
+    }
+    memcpy(ring_sector(r, r->head), sector, FF_MAX_SS);
+    ++r->head;
+    mirror_service(r, false);
+    return SD_BLOCK_DEVICE_ERROR_NONE;
+}
+
+// Empties every queue; a card that doesn't finish in time is dropped
+static void mirror_flush(raid_t *r) {
+    absolute_time_t deadline = make_timeout_time_ms(RAID_STALL_MS);
+    for (;;) {
+        bool pending = false;
+        for (size_t m = 0; m < RAID_MEMBERS; ++m)
+            if (!r->failed[m] && (r->tail[m] != r->head || r->status_due[m]))
+                pending = true;
+        if (!pending) return;
+        if (absolute_time_diff_us(get_absolute_time(), deadline) <= 0) {
+            for (size_t m = 0; m < RAID_MEMBERS; ++m)
+                if (!r->failed[m] && (r->tail[m] != r->head || r->status_due[m]))
+                    member_failed(r, m, SD_BLOCK_DEVICE_ERROR_WRITE);
+            return;
+        }
+        mirror_service(r, true);
+    }
+}
+
+FRESULT raid_open(raid_t *r, const char *name, raid_mode_t mode,
+                  FSIZE_t member_size, uint32_t unit_sectors,
+                  uint8_t *stage, uint32_t stage_sectors) {
+    memset(r, 0, sizeof *r);
+    if (sd_get_num() < RAID_MEMBERS || !unit_sectors) return FR_INVALID_PARAMETER;
+    if (stage_sectors < (RAID_STRIPE == mode ? RAID_MEMBERS : 1) * unit_sectors)
+        return FR_INVALID_PARAMETER;
+    r->mode = mode;
+    r->unit_sectors = unit_sectors;
+    r->stage = stage;
+    r->stage_sectors = stage_sectors;
+    r->member_sectors = (uint32_t)(member_size / FF_MAX_SS);
+
+    for (size_t m = 0; m < RAID_MEMBERS; ++m) {
+        r->card[m] = sd_get_by_num(m);
+        char path[40];
+        snprintf(path, sizeof path, "%s%s", r->card[m]->pcName, name);
+        FIL *fp = &r->file[m];
+        FRESULT fr = f_open(fp, path, FA_WRITE | FA_CREATE_ALWAYS);
+        if (FR_OK != fr) {
+            while (m--) f_close(&r->file[m]);
+            return fr;
+        }
+        // Contiguous, and recorded in the directory before any data is written
+        fr = f_expand(fp, (FSIZE_t)r->member_sectors * FF_MAX_SS, 1);
+        if (FR_OK == fr) fr = f_sync(fp);
+        if (FR_OK != fr) {
+            do f_close(&r->file[m]); while (m--);
+            return fr;
+        }
+        FATFS *fs = fp->obj.fs;
+        r->base[m] = fs->database + (LBA_t)fs->csize * (fp->obj.sclust - 2);
+        forget_cached(r, m, r->base[m], r->member_sectors);
+    }
+    return FR_OK;
+}
+
+int raid_write(raid_t *r, const uint8_t *sector) {
+    if (RAID_MIRROR == r->mode) return mirror_write(r, sector);
+    uint32_t row_sectors = RAID_MEMBERS * r->unit_sectors;
+    memcpy(r->stage + (size_t)r->staged * FF_MAX_SS, sector, FF_MAX_SS);
+    if (++r->staged < row_sectors) return SD_BLOCK_DEVICE_ERROR_NONE;
+    int rc = write_row(r, row_sectors);
+    r->staged = 0;
+    if (SD_BLOCK_DEVICE_ERROR_NONE == rc) {
+        ++r->rows;
+        r->sectors_written += row_sectors;
+    }
+    return rc;
+}
+
+void raid_task(raid_t *r) {
+    if (RAID_MIRROR == r->mode) mirror_service(r, false);
+}
+
+uint64_t raid_size(const raid_t *r) {
+    if (RAID_MIRROR == r->mode) return r->head;
+    return r->sectors_written + r->staged;
+}
+
+size_t raid_members_active(const raid_t *r) {
+    size_t active = 0;
+    for (size_t m = 0; m < RAID_MEMBERS; ++m)
+        if (!r->failed[m]) ++active;
+    return active;
+}
+
+static FRESULT mirror_close(raid_t *r) {
+    FRESULT result = FR_OK;
+    mirror_flush(r);
+    for (size_t m = 0; m < RAID_MEMBERS; ++m) {
+        FRESULT fr = FR_OK;
+        // A dropped card keeps its preallocated size; the data on it ends at
+        // the first block that doesn't validate
+        if (!r->failed[m]) {
+            fr = f_lseek(&r->file[m], (FSIZE_t)r->head * FF_MAX_SS);
+            if (FR_OK == fr) fr = f_truncate(&r->file[m]);
+        }
+        FRESULT fr_close = f_close(&r->file[m]);
+        if (FR_OK == fr) fr = fr_close;
+        if (FR_OK == result && !r->failed[m]) result = fr;
+    }
+    return raid_members_active(r) ? result : FR_DISK_ERR;
+}
+
+FRESULT raid_close(raid_t *r) {
+    if (RAID_MIRROR == r->mode) return mirror_close(r);
+    FRESULT result = FR_OK;
+    uint32_t partial = 0;
+    if (r->staged) {
+        if (SD_BLOCK_DEVICE_ERROR_NONE == write_row(r, r->staged)) {
+            partial = r->staged;
+            r->sectors_written += partial;
+        } else {
+            result = FR_DISK_ERR;
+        }
+        r->staged = 0;
+    }
+    for (size_t m = 0; m < RAID_MEMBERS; ++m) {
+        // Data on this card: the full rows plus its share of the partial one
+        uint32_t before = m * r->unit_sectors;
+        uint32_t extra = partial > before ? partial - before : 0;
+        if (extra > r->unit_sectors) extra = r->unit_sectors;
+        FSIZE_t size = ((FSIZE_t)r->rows * r->unit_sectors + extra) * FF_MAX_SS;
+        FRESULT fr = f_lseek(&r->file[m], size);
+        if (FR_OK == fr) fr = f_truncate(&r->file[m]);
+        FRESULT fr_close = f_close(&r->file[m]);
+        if (FR_OK == fr) fr = fr_close;
+        if (FR_OK == result) result = fr;
+    }
+    return result;
+}
+
+/* [] END OF FILE */
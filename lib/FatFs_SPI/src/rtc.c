@@ -26,6 +26,11 @@ specific language governing permissions and limitations under the License.
 
 static time_t epochtime;
 
+// FAT timestamp read by FatFs; refreshed once per second by a timer so the
+// f_write/f_sync path never touches the RTC peripheral
+static volatile DWORD fattime;
+static struct repeating_timer fattime_timer;
+
 // Make an attempt to save a recent time stamp across reset:
 typedef struct rtc_save {
     uint32_t signature;
@@ -34,32 +39,52 @@ typedef struct rtc_save {
 } rtc_save_t;
 static rtc_save_t rtc_save __attribute__((section(".uninitialized_data")));
 
-static void update_epochtime() {
-    bool rc = rtc_get_datetime(&rtc_save.datetime);
-    if (rc) {
-        rtc_save.signature = 0xBABEBABE;
-        struct tm timeinfo = {
-            .tm_sec = rtc_save.datetime
-                          .sec, /* Seconds.	[0-60] (1 leap second) */
-            .tm_min = rtc_save.datetime.min,          /* Minutes.	[0-59] */
-            .tm_hour = rtc_save.datetime.hour,        /* Hours.	[0-23] */
-            .tm_mday = rtc_save.datetime.day,         /* Day.		[1-31] */
-            .tm_mon = rtc_save.datetime.month - 1,    /* Month.	[0-11] */
-            .tm_year = rtc_save.datetime.year - 1900, /* Year	- 1900.  */
-            .tm_wday = 0,                             /* Day of week.	[0-6] */
-            .tm_yday = 0,                             /* Days in year.[0-365]	*/
-            .tm_isdst = -1                            /* DST.		[-1/0/1]*/
-        };
-        rtc_save.checksum = calculate_checksum((uint32_t *)&rtc_save,
-                                               offsetof(rtc_save_t, checksum));
-        epochtime = mktime(&timeinfo);
-        rtc_save.datetime.dotw = timeinfo.tm_wday;
-        // configASSERT(-1 != epochtime);
-    }
+// Days since 1970-01-01 for a proleptic Gregorian date (H. Hinnant's days_from_civil)
+static int32_t days_from_civil(int32_t y, int32_t m, int32_t d) {
+    y -= m <= 2;
+    const int32_t era = (y >= 0 ? y : y - 399) / 400;
+    const int32_t yoe = y - era * 400;
+    const int32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static int days_in_month(int y, int m) {
+    static const int8_t days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+    return days[m - 1] + (m == 2 && leap);
+}
+
+static DWORD pack_fattime(const datetime_t *t) {
+    if (t->year < 1980) return 0;
+    return (DWORD)(t->year - 1980) << 25 |  // bit31:25 Year origin from 1980
+           (DWORD)t->month << 21 |          // bit24:21 Month (1..12)
+           (DWORD)t->day << 16 |            // bit20:16 Day of the month (1..31)
+           (DWORD)t->hour << 11 |           // bit15:11 Hour (0..23)
+           (DWORD)t->min << 5 |             // bit10:5 Minute (0..59)
+           (DWORD)(t->sec / 2);             // bit4:0 Second / 2 (0..29)
+}
+
+// Refresh the cached FAT time, epoch time and reset-surviving copy from a
+// datetime; integer arithmetic only (no mktime)
+static void update_cache(const datetime_t *t) {
+    rtc_save.datetime = *t;
+    rtc_save.signature = 0xBABEBABE;
+    rtc_save.checksum = calculate_checksum((uint32_t *)&rtc_save,
+                                           offsetof(rtc_save_t, checksum));
+    epochtime = (time_t)days_from_civil(t->year, t->month, t->day) * 86400 +
+                t->hour * 3600 + t->min * 60 + t->sec;
+    fattime = pack_fattime(t);
+}
+
+static bool fattime_tick(struct repeating_timer *rt) {
+    (void)rt;
+    datetime_t t;
+    if (rtc_get_datetime(&t)) update_cache(&t);
+    return true;
 }
 
 time_t time(time_t *pxTime) {
-    update_epochtime();
     if (pxTime) {
         *pxTime = epochtime;
     }
@@ -79,38 +104,31 @@ void time_init() {
             rtc_set_datetime(&rtc_save.datetime);
         }
     }
+    fattime_tick(NULL);
+    add_repeating_timer_ms(1000, fattime_tick, NULL, &fattime_timer);
+}
+
+bool time_set(int year, int month, int day, int hour, int min, int sec) {
+    if (year < 1980 || year > 2107 || month < 1 || month > 12 || day < 1 ||
+        day > days_in_month(year, month) || hour < 0 || hour > 23 || min < 0 || min > 59 || sec < 0 ||
+        sec > 59)
+        return false;
+    datetime_t t = {
+        .year = (int16_t)year,
+        .month = (int8_t)month,
+        .day = (int8_t)day,
+        // 1970-01-01 was a Thursday
+        .dotw = (int8_t)((days_from_civil(year, month, day) % 7 + 11) % 7),
+        .hour = (int8_t)hour,
+        .min = (int8_t)min,
+        .sec = (int8_t)sec};
+    if (!rtc_set_datetime(&t)) return false;
+    // The RTC takes a few of its clock cycles to load; use the new value now
+    update_cache(&t);
+    return true;
 }
 
 // Called by FatFs:
 DWORD get_fattime(void) {
-    datetime_t t = {0, 0, 0, 0, 0, 0, 0};
-    bool rc = rtc_get_datetime(&t);
-    if (!rc) return 0;
-
-    DWORD fattime = 0;
-    // bit31:25
-    // Year origin from the 1980 (0..127, e.g. 37 for 2017)
-    uint8_t yr = t.year - 1980;
-    fattime |= (0b01111111 & yr) << 25;
-    // bit24:21
-    // Month (1..12)
-    uint8_t mo = t.month;
-    fattime |= (0b00001111 & mo) << 21;
-    // bit20:16
-    // Day of the month (1..31)
-    uint8_t da = t.day;
-    fattime |= (0b00011111 & da) << 16;
-    // bit15:11
-    // Hour (0..23)
-    uint8_t hr = t.hour;
-    fattime |= (0b00011111 & hr) << 11;
-    // bit10:5
-    // Minute (0..59)
-    uint8_t mi = t.min;
-    fattime |= (0b00111111 & mi) << 5;
-    // bit4:0
-    // Second / 2 (0..29, e.g. 25 for 50)
-    uint8_t sd = t.sec / 2;
-    fattime |= (0b00011111 & sd);
     return fattime;
 }
@@ -0,0 +1,57 @@
+#ifndef AMOSTRA_H
+#define AMOSTRA_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hardware/sync.h"
+
+// Amostra bruta do MPU6050 com carimbo de tempo (ms desde o início da gravação)
+typedef struct {
+  uint32_t tempo_ms;
+  int16_t accel[3];
+  int16_t gyro[3];
+  uint8_t canal;    // Sensor de origem (0 com um só sensor)
+} amostra_t;
+
+// Fila circular de amostras com um produtor e um consumidor (ex.: IRQ -> laço principal).
+// A capacidade deve ser potência de 2; os índices correm livremente e são mascarados no acesso.
+typedef struct {
+  amostra_t *buf;
+  uint32_t mascara;
+  volatile uint32_t cabeca; // Próxima posição de escrita (produtor)
+  volatile uint32_t cauda;  // Próxima posição de leitura (consumidor)
+} fila_amostras_t;
+
+static inline void fila_init(fila_amostras_t *f, amostra_t *buf, uint32_t capacidade) {
+  f->buf = buf;
+  f->mascara = capacidade - 1;
+  f->cabeca = 0;
+  f->cauda = 0;
+}
+
+static inline uint32_t fila_tamanho(const fila_amostras_t *f) {
+  return f->cabeca - f->cauda;
+}
+
+static inline bool fila_push(fila_amostras_t *f, const amostra_t *a) {
+  uint32_t cabeca = f->cabeca;
+  if (cabeca - f->cauda > f->mascara)
+    return false; // Cheia
+  f->buf[cabeca & f->mascara] = *a;
+  __dmb(); // Dados visíveis antes do índice
+  f->cabeca = cabeca + 1;
+  return true;
+}
+
+static inline bool fila_pop(fila_amostras_t *f, amostra_t *a) {
+  uint32_t cauda = f->cauda;
+  if (cauda == f->cabeca)
+    return false; // Vazia
+  __dmb();
+  *a = f->buf[cauda & f->mascara];
+  f->cauda = cauda + 1;
+  return true;
+}
+
+#endif
@@ -0,0 +1,63 @@
+#include "barramento_i2c.h"
+
+#include "pico/stdlib.h"
+
+#define MEIO_PERIODO_US 5             // SCL a 100 kHz durante a limpeza
+
+static void configurar(const barramento_i2c_t *b)
+{
+  i2c_init(b->i2c, b->baudrate);
+  gpio_set_function(b->sda, GPIO_FUNC_I2C);
+  gpio_set_function(b->scl, GPIO_FUNC_I2C);
+  gpio_pull_up(b->sda);
+  gpio_pull_up(b->scl);
+}
+
+void barramento_i2c_init(barramento_i2c_t *b, i2c_inst_t *i2c, uint sda, uint scl, uint baudrate)
+{
+  b->i2c = i2c;
+  b->sda = sda;
+  b->scl = scl;
+  b->baudrate = baudrate;
+  b->limpezas = 0;
+  b->limpezas_falhas = 0;
+  configurar(b);
+}
+
+// Dreno aberto: nível baixo com o pino como saída em 0, alto soltando a linha para o pull-up
+static void linha(uint pino, bool alto)
+{
+  gpio_set_dir(pino, alto ? GPIO_IN : GPIO_OUT);
+  sleep_us(MEIO_PERIODO_US);
+}
+
+bool barramento_i2c_limpar(barramento_i2c_t *b)
+{
+  i2c_deinit(b->i2c);
+  gpio_init(b->sda);
+  gpio_init(b->scl);
+  gpio_put(b->sda, 0);
+  gpio_put(b->scl, 0);
+  linha(b->sda, true);
+  linha(b->scl, true);
+
+  // Cada pulso deixa o escravo avançar um bit; em até 9 ele termina o byte e o ACK
+  for (int i = 0; i < 9 && !gpio_get(b->sda); i++)
+  {
+    linha(b->scl, false);
+    linha(b->scl, true);
+  }
+
+  // STOP: SDA sobe com SCL em nível alto
+  linha(b->scl, false);
+  linha(b->sda, false);
+  linha(b->scl, true);
+  linha(b->sda, true);
+  bool livre = gpio_get(b->sda) && gpio_get(b->scl);
+
+  b->limpezas++;
+  if (!livre)
+    b->limpezas_falhas++;
+  configurar(b);
+  return livre;
+}
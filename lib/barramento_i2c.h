@@ -0,0 +1,29 @@
+#ifndef BARRAMENTO_I2C_H
+#define BARRAMENTO_I2C_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hardware/i2c.h"
+
+// Barramento I2C com os pinos guardados, para poder ser limpo quando um escravo prende a
+// linha SDA em nível baixo (reset no meio de um byte, ruído na linha). A limpeza assume os
+// pinos como GPIO, gera até 9 pulsos em SCL até o escravo soltar SDA, termina com uma
+// condição de STOP e devolve os pinos ao controlador reiniciado.
+
+typedef struct {
+  i2c_inst_t *i2c;
+  uint sda, scl;
+  uint baudrate;
+  uint32_t limpezas;                  // Limpezas feitas
+  uint32_t limpezas_falhas;           // Limpezas em que SDA continuou presa
+} barramento_i2c_t;
+
+// Inicia o controlador e configura os pinos com pull-up
+void barramento_i2c_init(barramento_i2c_t *b, i2c_inst_t *i2c, uint sda, uint scl, uint baudrate);
+
+// Limpa o barramento e reinicia o controlador (FIFOs vazios, registradores padrão).
+// Retorna false se SDA continuar presa. Leva cerca de 100 us
+bool barramento_i2c_limpar(barramento_i2c_t *b);
+
+#endif
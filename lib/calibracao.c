@@ -0,0 +1,131 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+#include "calibracao.h"
+#include "crc.h"
+
+#define CALIBRACAO_MAGICO 0x4C41434Du  // "MCAL"
+
+// Último setor da flash, longe do programa
+#define CALIBRACAO_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+
+// Limites para considerar o sensor parado durante a medida (variação máxima por eixo)
+#define TOLERANCIA_ACCEL 820    // 0,05 g (16384 LSB/g)
+#define TOLERANCIA_GYRO 393     // 3 °/s (131 LSB/(°/s))
+#define UM_G 16384
+
+typedef struct {
+  uint32_t magico;
+  calibracao_t valores;
+  uint16_t crc;
+} registro_t;
+
+void calibracao_zerar(calibracao_t *c)
+{
+  memset(c, 0, sizeof(*c));
+}
+
+bool calibracao_carregar(calibracao_t *c)
+{
+  const registro_t *r = (const registro_t *)(XIP_BASE + CALIBRACAO_OFFSET);
+  if (r->magico != CALIBRACAO_MAGICO ||
+      r->crc != crc16((const char *)&r->valores, sizeof(r->valores)))
+  {
+    calibracao_zerar(c);
+    return false;
+  }
+  *c = r->valores;
+  return true;
+}
+
+bool calibracao_salvar(const calibracao_t *c)
+{
+  // A programação é feita em páginas inteiras
+  static uint8_t pagina[FLASH_PAGE_SIZE];
+  memset(pagina, 0xFF, sizeof(pagina));
+  registro_t r;
+  memset(&r, 0, sizeof(r));
+  r.magico = CALIBRACAO_MAGICO;
+  r.valores = *c;
+  r.crc = crc16((const char *)&r.valores, sizeof(r.valores));
+  memcpy(pagina, &r, sizeof(r));
+
+  uint32_t interrupcoes = save_and_disable_interrupts();
+  flash_range_erase(CALIBRACAO_OFFSET, FLASH_SECTOR_SIZE);
+  flash_range_program(CALIBRACAO_OFFSET, pagina, FLASH_PAGE_SIZE);
+  restore_interrupts(interrupcoes);
+
+  calibracao_t lido;
+  return calibracao_carregar(&lido) && memcmp(&lido, c, sizeof(lido)) == 0;
+}
+
+bool calibracao_medir(calibracao_t *c, calibracao_ler_t ler, uint32_t n, uint32_t intervalo_us)
+{
+  int64_t soma[6] = {0};
+  int16_t min[6], max[6];
+  for (int i = 0; i < 6; i++)
+  {
+    min[i] = INT16_MAX;
+    max[i] = INT16_MIN;
+  }
+
+  uint32_t validas = 0, falhas = 0;
+  for (uint32_t k = 0; k < n; k++)
+  {
+    int16_t v[6];
+    if (!ler(&v[0], &v[3]))
+    {
+      if (++falhas > n / CALIBRACAO_FALHAS_MAX)
+        return false;
+      sleep_us(intervalo_us);
+      continue;
+    }
+    validas++;
+    for (int i = 0; i < 6; i++)
+    {
+      soma[i] += v[i];
+      if (v[i] < min[i])
+        min[i] = v[i];
+      if (v[i] > max[i])
+        max[i] = v[i];
+    }
+    sleep_us(intervalo_us);
+  }
+
+  for (int i = 0; i < 6; i++)
+  {
+    int32_t tolerancia = i < 3 ? TOLERANCIA_ACCEL : TOLERANCIA_GYRO;
+    if (max[i] - min[i] > tolerancia)
+      return false;
+  }
+
+  // Média arredondada
+  int32_t media[6];
+  if (!validas)
+    return false;
+  for (int i = 0; i < 6; i++)
+    media[i] = (int32_t)((soma[i] + (soma[i] >= 0 ? (int64_t)validas / 2 : -(int64_t)validas / 2)) /
+                         (int64_t)validas);
+
+  // A gravidade fica no eixo de maior módulo e precisa estar entre 0,8 g e 1,2 g
+  int vertical = 0;
+  for (int i = 1; i < 3; i++)
+  {
+    if (abs(media[i]) > abs(media[vertical]))
+      vertical = i;
+  }
+  if (abs(media[vertical]) < UM_G * 8 / 10 || abs(media[vertical]) > UM_G * 12 / 10)
+    return false;
+
+  for (int i = 0; i < 3; i++)
+  {
+    int32_t esperado = i != vertical ? 0 : media[i] > 0 ? UM_G : -UM_G;
+    c->accel[i] = (int16_t)(media[i] - esperado);
+    c->gyro[i] = (int16_t)media[i + 3];
+  }
+  return true;
+}
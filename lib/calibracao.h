@@ -0,0 +1,48 @@
+#ifndef CALIBRACAO_H
+#define CALIBRACAO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CALIBRACAO_FALHAS_MAX 10
+
+// Offsets de bias do MPU6050, subtraídos dos valores brutos antes de qualquer filtro ou
+// formatação. Ficam no último setor da flash e sobrevivem a reinícios.
+
+typedef struct {
+  int16_t accel[3];
+  int16_t gyro[3];
+} calibracao_t;
+
+// Função que lê uma amostra bruta do sensor; retorna false se a leitura falhar
+typedef bool (*calibracao_ler_t)(int16_t accel[3], int16_t gyro[3]);
+
+void calibracao_zerar(calibracao_t *c);
+
+// Lê os offsets gravados; retorna false (e zera c) se não houver calibração válida
+bool calibracao_carregar(calibracao_t *c);
+
+// Grava os offsets na flash. Desabilita interrupções durante a escrita; o outro
+// núcleo não pode estar executando da flash neste intervalo
+bool calibracao_salvar(const calibracao_t *c);
+
+// Média de n amostras com o sensor parado. O eixo do acelerômetro mais próximo da
+// vertical deve medir 1 g; nos demais eixos e no giroscópio o esperado é zero.
+// Leituras que falham são descartadas. Retorna false se mais de 1 em cada
+// CALIBRACAO_FALHAS_MAX falhar, o sensor se mover durante a medida ou nenhum
+// eixo medir ~1 g
+bool calibracao_medir(calibracao_t *c, calibracao_ler_t ler, uint32_t n, uint32_t intervalo_us);
+
+// Subtrai os offsets com saturação em 16 bits
+static inline void calibracao_aplicar(const calibracao_t *c, int16_t accel[3], int16_t gyro[3])
+{
+  for (int i = 0; i < 3; i++)
+  {
+    int32_t a = (int32_t)accel[i] - c->accel[i];
+    int32_t g = (int32_t)gyro[i] - c->gyro[i];
+    accel[i] = (int16_t)(a > INT16_MAX ? INT16_MAX : a < INT16_MIN ? INT16_MIN : a);
+    gyro[i] = (int16_t)(g > INT16_MAX ? INT16_MAX : g < INT16_MIN ? INT16_MIN : g);
+  }
+}
+
+#endif
@@ -0,0 +1,253 @@
+#include <string.h>
+
+#include "compressao.h"
+#include "crc.h"
+
+#define MAX_BYTES_AMOSTRA (5 + 6 * 3) // varint de 32 bits + 6 varints de 16 bits
+
+static void escrever_u16(uint8_t *p, uint16_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+}
+
+static void escrever_u32(uint8_t *p, uint32_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static uint16_t ler_u16(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static uint32_t ler_u32(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int escrever_varint(uint8_t *p, uint32_t v)
+{
+  int n = 0;
+  while (v >= 0x80)
+  {
+    p[n++] = (v & 0x7F) | 0x80;
+    v >>= 7;
+  }
+  p[n++] = v;
+  return n;
+}
+
+// Retorna bytes consumidos ou 0 se o varint ultrapassar o fim dos dados
+static int ler_varint(const uint8_t *p, const uint8_t *fim, uint32_t *v)
+{
+  uint32_t valor = 0;
+  for (int n = 0; n < 5 && p + n < fim; n++)
+  {
+    valor |= (uint32_t)(p[n] & 0x7F) << (7 * n);
+    if (!(p[n] & 0x80))
+    {
+      *v = valor;
+      return n + 1;
+    }
+  }
+  return 0;
+}
+
+// Zigzag: pequenos valores negativos viram pequenos positivos (0,-1,1,-2 -> 0,1,2,3)
+static uint32_t zigzag(int32_t v)
+{
+  return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static int32_t dezigzag(uint32_t v)
+{
+  return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+static void iniciar_bloco(compressor_t *c, const amostra_t *a)
+{
+  uint8_t *b = c->bloco[c->atual];
+  memset(b, 0, BLOCO_TAM);
+  uint8_t *q = b + BLOCO_CABECALHO;
+  escrever_u32(q, a->tempo_ms);
+  for (int i = 0; i < 3; i++)
+  {
+    escrever_u16(q + 4 + 2 * i, a->accel[i]);
+    escrever_u16(q + 10 + 2 * i, a->gyro[i]);
+  }
+  b[19] = a->canal;
+  c->pos = BLOCO_CABECALHO + BLOCO_QUADRO_CHAVE;
+  c->n = 1;
+  c->chave = *a;
+  c->anterior[a->canal] = *a;
+  c->vistos = 1u << a->canal;
+  c->tempo_anterior = a->tempo_ms;
+}
+
+// Preenche o cabeçalho do bloco atual e alterna para o outro buffer
+static const uint8_t *fechar_bloco(compressor_t *c)
+{
+  uint8_t *b = c->bloco[c->atual];
+  escrever_u32(b, BLOCO_MAGICO);
+  escrever_u32(b + 4, c->sessao);
+  escrever_u32(b + 8, c->seq++);
+  escrever_u16(b + 12, c->n);
+  escrever_u16(b + 14, c->pos - BLOCO_CABECALHO);
+  escrever_u16(b + 16, 0);
+  b[18] = c->canais > 1 ? c->canais : 0;
+  escrever_u16(b + 16, crc16((const char *)b, BLOCO_TAM));
+  c->atual ^= 1;
+  c->n = 0;
+  return b;
+}
+
+void compressor_init(compressor_t *c, uint32_t sessao, uint8_t canais)
+{
+  c->canais = canais;
+  c->atual = 0;
+  c->sessao = sessao;
+  c->seq = 0;
+  c->n = 0;
+  c->pos = 0;
+}
+
+// Acrescenta uma amostra; retorna um bloco completo pronto para gravar ou NULL.
+// O ponteiro retornado permanece válido até a próxima chamada.
+const uint8_t *compressor_adicionar(compressor_t *c, const amostra_t *a)
+{
+  if (c->n == 0)
+  {
+    iniciar_bloco(c, a);
+    return NULL;
+  }
+
+  const amostra_t *ref = (c->vistos >> a->canal) & 1 ? &c->anterior[a->canal] : &c->chave;
+  uint8_t tmp[MAX_BYTES_AMOSTRA];
+  int n = escrever_varint(tmp, (a->tempo_ms - c->tempo_anterior) * c->canais + a->canal);
+  for (int i = 0; i < 3; i++)
+  {
+    n += escrever_varint(tmp + n, zigzag((int32_t)a->accel[i] - ref->accel[i]));
+  }
+  for (int i = 0; i < 3; i++)
+  {
+    n += escrever_varint(tmp + n, zigzag((int32_t)a->gyro[i] - ref->gyro[i]));
+  }
+
+  if (c->pos + n > BLOCO_TAM)
+  {
+    // Não cabe: fecha o bloco e começa outro com esta amostra como quadro-chave
+    const uint8_t *completo = fechar_bloco(c);
+    iniciar_bloco(c, a);
+    return completo;
+  }
+
+  memcpy(c->bloco[c->atual] + c->pos, tmp, n);
+  c->pos += n;
+  c->n++;
+  c->anterior[a->canal] = *a;
+  c->vistos |= 1u << a->canal;
+  c->tempo_anterior = a->tempo_ms;
+  return NULL;
+}
+
+// Fecha o bloco parcial (fim da gravação); retorna NULL se não houver amostras pendentes
+const uint8_t *compressor_finalizar(compressor_t *c)
+{
+  if (c->n == 0)
+  {
+    return NULL;
+  }
+  return fechar_bloco(c);
+}
+
+uint32_t bloco_seq(const uint8_t *bloco)
+{
+  return ler_u32(bloco + 8);
+}
+
+uint32_t bloco_sessao(const uint8_t *bloco)
+{
+  return ler_u32(bloco + 4);
+}
+
+// Verifica mágico, sessão e CRC
+bool bloco_valido(const uint8_t *bloco, uint32_t sessao)
+{
+  if (ler_u32(bloco) != BLOCO_MAGICO || ler_u32(bloco + 4) != sessao)
+  {
+    return false;
+  }
+  uint16_t tam = ler_u16(bloco + 14);
+  if (ler_u16(bloco + 12) == 0 || tam < BLOCO_QUADRO_CHAVE || tam > BLOCO_TAM - BLOCO_CABECALHO)
+  {
+    return false;
+  }
+  unsigned short crc = crc16((const char *)bloco, 16);
+  const uint8_t zero[2] = {0, 0};
+  update_crc16(&crc, (const char *)zero, 2);
+  update_crc16(&crc, (const char *)bloco + 18, BLOCO_TAM - 18);
+  return crc == ler_u16(bloco + 16);
+}
+
+// Decodifica um bloco já validado; retorna o número de amostras ou -1 se estiver corrompido
+int bloco_decodificar(const uint8_t *bloco, amostra_t *saida, int max)
+{
+  int n = ler_u16(bloco + 12);
+  const uint8_t *p = bloco + BLOCO_CABECALHO;
+  const uint8_t *fim = p + ler_u16(bloco + 14);
+  uint8_t canais = bloco[18] ? bloco[18] : 1;
+  if (n > max || canais > COMPRESSAO_MAX_CANAIS || bloco[19] >= canais)
+  {
+    return -1;
+  }
+
+  amostra_t chave;
+  chave.tempo_ms = ler_u32(p);
+  for (int i = 0; i < 3; i++)
+  {
+    chave.accel[i] = ler_u16(p + 4 + 2 * i);
+    chave.gyro[i] = ler_u16(p + 10 + 2 * i);
+  }
+  chave.canal = bloco[19];
+  p += BLOCO_QUADRO_CHAVE;
+  saida[0] = chave;
+
+  amostra_t anterior[COMPRESSAO_MAX_CANAIS];
+  uint8_t vistos = 1u << chave.canal;
+  anterior[chave.canal] = chave;
+  uint32_t tempo = chave.tempo_ms;
+  for (int k = 1; k < n; k++)
+  {
+    uint32_t v;
+    int usados = ler_varint(p, fim, &v);
+    if (!usados)
+    {
+      return -1;
+    }
+    p += usados;
+    uint8_t canal = v % canais;
+    amostra_t a = (vistos >> canal) & 1 ? anterior[canal] : chave;
+    tempo += v / canais;
+    a.tempo_ms = tempo;
+    a.canal = canal;
+    for (int i = 0; i < 6; i++)
+    {
+      usados = ler_varint(p, fim, &v);
+      if (!usados)
+      {
+        return -1;
+      }
+      p += usados;
+      int16_t *eixo = i < 3 ? &a.accel[i] : &a.gyro[i - 3];
+      *eixo += dezigzag(v);
+    }
+    anterior[canal] = a;
+    vistos |= 1u << canal;
+    saida[k] = a;
+  }
+  return n;
+}
@@ -0,0 +1,63 @@
+#ifndef COMPRESSAO_H
+#define COMPRESSAO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "amostra.h"
+
+// Formato binário compacto: blocos de 512 bytes (um setor do cartão), cada um
+// independente dos demais. O bloco começa com um cabeçalho, seguido de um
+// quadro-chave com a primeira amostra em valor absoluto; as demais amostras são
+// diferenças em relação à anterior, codificadas em zigzag + varint.
+//
+//   off  tam  campo
+//     0    4  magico (BLOCO_MAGICO)
+//     4    4  sessao  identificador da gravação
+//     8    4  seq     número de sequência do bloco na sessão (0, 1, 2, ...)
+//    12    2  n       amostras no bloco
+//    14    2  tam     bytes úteis de dados após o cabeçalho
+//    16    2  crc     CRC-16/XMODEM do bloco inteiro com este campo zerado
+//    18    1  canais  sensores intercalados no bloco (0: um só sensor)
+//    19    1  canal   sensor do quadro-chave
+//    20   16  quadro-chave: tempo_ms (u32) + accel[3] + gyro[3] (i16)
+//    36  ...  por amostra: varint(dt * canais + canal) + 6 x varint(zigzag(delta))
+// Todos os campos multibyte são little-endian.
+//
+// Com vários sensores, as amostras de uma rodada têm o mesmo tempo_ms e seguem juntas;
+// dt é relativo à amostra anterior, de qualquer canal, e os deltas à anterior do mesmo
+// canal (ou ao quadro-chave, na primeira vez que o canal aparece no bloco). Com um só
+// sensor o formato é o original.
+
+#define BLOCO_TAM 512
+#define BLOCO_MAGICO 0x42554D49u // "IMUB"
+#define BLOCO_CABECALHO 20
+#define BLOCO_QUADRO_CHAVE 16
+#define BLOCO_MAX_AMOSTRAS ((BLOCO_TAM - BLOCO_CABECALHO - BLOCO_QUADRO_CHAVE) / 7 + 1)
+#define COMPRESSAO_MAX_CANAIS 4
+
+typedef struct {
+  uint8_t bloco[2][BLOCO_TAM]; // Bloco em preenchimento e último bloco completo
+  uint8_t atual;               // Índice do bloco em preenchimento
+  uint32_t sessao;
+  uint32_t seq;
+  uint16_t n;
+  uint16_t pos;
+  uint8_t canais;
+  uint8_t vistos;                            // Canais já presentes no bloco (bit por canal)
+  amostra_t chave;
+  amostra_t anterior[COMPRESSAO_MAX_CANAIS];
+  uint32_t tempo_anterior;
+} compressor_t;
+
+// canais: sensores intercalados na gravação (1 a COMPRESSAO_MAX_CANAIS)
+void compressor_init(compressor_t *c, uint32_t sessao, uint8_t canais);
+const uint8_t *compressor_adicionar(compressor_t *c, const amostra_t *a);
+const uint8_t *compressor_finalizar(compressor_t *c);
+
+bool bloco_valido(const uint8_t *bloco, uint32_t sessao);
+uint32_t bloco_seq(const uint8_t *bloco);
+uint32_t bloco_sessao(const uint8_t *bloco);
+int bloco_decodificar(const uint8_t *bloco, amostra_t *saida, int max);
+
+#endif
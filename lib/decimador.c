@@ -0,0 +1,116 @@
+#include "decimador.h"
+
+// Filtros passa-baixa FIR de fase linear (janela de Kaiser, beta = 7) com
+// DECIMADOR_TAPS_FASE coeficientes por fase, em Q15 e ganho DC exatamente 1.
+// Corte em 0,36 * fs_saída: até 0,25 * fs_saída a ondulação é < 0,6 dB e o que
+// seria rebatido sobre essa banda fica ~70 dB abaixo.
+static const int16_t coef_m2[24] = {
+  2, -16, -68, -29, 239, 457, -54, -1288, -1598, 1104, 6527, 11108,
+  11108, 6527, 1104, -1598, -1288, -54, 457, 239, -29, -68, -16, 2,
+};
+
+static const int16_t coef_m4[48] = {
+  2, 1, -5, -17, -33, -43, -33, 9, 84, 173, 235, 220,
+  87, -171, -500, -789, -884, -635, 50, 1156, 2544, 3972, 5148, 5813,
+  5813, 5148, 3972, 2544, 1156, 50, -635, -884, -789, -500, -171, 87,
+  220, 235, 173, 84, 9, -33, -43, -33, -17, -5, 1, 2,
+};
+
+static const int16_t coef_m8[96] = {
+  1, 1, 1, 0, -2, -4, -8, -12, -16, -20, -22, -23,
+  -20, -13, -2, 13, 33, 55, 78, 99, 116, 123, 120, 102,
+  68, 17, -49, -127, -211, -294, -368, -422, -447, -432, -370, -254,
+  -82, 146, 424, 744, 1093, 1456, 1816, 2152, 2448, 2686, 2853, 2937,
+  2937, 2853, 2686, 2448, 2152, 1816, 1456, 1093, 744, 424, 146, -82,
+  -254, -370, -432, -447, -422, -368, -294, -211, -127, -49, 17, 68,
+  102, 120, 123, 116, 99, 78, 55, 33, 13, -2, -13, -20,
+  -23, -22, -20, -16, -12, -8, -4, -2, 0, 1, 1, 1,
+};
+
+bool decimador_init(decimador_t *d, uint8_t fator)
+{
+  switch (fator)
+  {
+    case 1:
+      d->coef = NULL;
+      break;
+    case 2:
+      d->coef = coef_m2;
+      break;
+    case 4:
+      d->coef = coef_m4;
+      break;
+    case 8:
+      d->coef = coef_m8;
+      break;
+    default:
+      return false;
+  }
+  d->fator = fator;
+  d->fase = 0;
+  d->tempo_anterior = 0;
+  memset(d->acc, 0, sizeof(d->acc));
+  return true;
+}
+
+static int16_t saturar_q15(int32_t acc)
+{
+  acc = (acc + (1 << 14)) >> 15;
+  if (acc > INT16_MAX)
+    return INT16_MAX;
+  if (acc < INT16_MIN)
+    return INT16_MIN;
+  return acc;
+}
+
+// Forma polifásica com acumuladores: cada entrada contribui para as
+// DECIMADOR_TAPS_FASE saídas em andamento, de modo que o custo por amostra é
+// constante (12 MACs por canal) em vez de um pico a cada 'fator' entradas.
+// acc[c][j] é a saída que fica pronta daqui a j * fator entradas.
+bool decimador_processar(decimador_t *d, const amostra_t *in, amostra_t *out)
+{
+  if (d->fator == 1)
+  {
+    *out = *in;
+    return true;
+  }
+
+  const int16_t *h = d->coef + (d->fator - 1 - d->fase);
+  const int16_t x[DECIMADOR_CANAIS] = {in->accel[0], in->accel[1], in->accel[2],
+                                       in->gyro[0],  in->gyro[1],  in->gyro[2]};
+  for (int c = 0; c < DECIMADOR_CANAIS; c++)
+  {
+    int32_t *acc = d->acc[c];
+    for (int j = 0; j < DECIMADOR_TAPS_FASE; j++)
+    {
+      acc[j] += h[j * d->fator] * x[c];
+    }
+  }
+
+  uint32_t dt = in->tempo_ms - d->tempo_anterior;
+  d->tempo_anterior = in->tempo_ms;
+  if (++d->fase < d->fator)
+  {
+    return false;
+  }
+  d->fase = 0;
+
+  for (int c = 0; c < DECIMADOR_CANAIS; c++)
+  {
+    int32_t *acc = d->acc[c];
+    int16_t y = saturar_q15(acc[0]);
+    if (c < 3)
+      out->accel[c] = y;
+    else
+      out->gyro[c - 3] = y;
+    memmove(acc, acc + 1, (DECIMADOR_TAPS_FASE - 1) * sizeof(acc[0]));
+    acc[DECIMADOR_TAPS_FASE - 1] = 0;
+  }
+
+  // O filtro atrasa o sinal em (N - 1) / 2 amostras de entrada; o carimbo de
+  // tempo é corrigido para o instante que a saída realmente representa
+  uint32_t atraso = ((uint32_t)(DECIMADOR_TAPS_FASE * d->fator - 1) * dt) / 2;
+  out->tempo_ms = in->tempo_ms > atraso ? in->tempo_ms - atraso : 0;
+  out->canal = in->canal;
+  return true;
+}
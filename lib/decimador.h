@@ -0,0 +1,28 @@
+#ifndef DECIMADOR_H
+#define DECIMADOR_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "amostra.h"
+
+// Decimador FIR polifásico em ponto fixo (Q15) para os 6 canais do MPU6050.
+// Permite amostrar o sensor rápido e armazenar a uma taxa 'fator' vezes menor
+// sem rebatimento espectral. Fatores suportados: 1 (sem filtro), 2, 4 e 8.
+
+#define DECIMADOR_CANAIS 6
+#define DECIMADOR_TAPS_FASE 12
+
+typedef struct {
+  const int16_t *coef;  // DECIMADOR_TAPS_FASE * fator coeficientes Q15
+  uint8_t fator;
+  uint8_t fase;         // Entradas já recebidas na saída atual
+  uint32_t tempo_anterior;
+  int32_t acc[DECIMADOR_CANAIS][DECIMADOR_TAPS_FASE];
+} decimador_t;
+
+bool decimador_init(decimador_t *d, uint8_t fator);
+bool decimador_processar(decimador_t *d, const amostra_t *in, amostra_t *out);
+
+#endif
@@ -0,0 +1,295 @@
+#include "espectro.h"
+
+#include "hardware/sync.h"
+
+// Quarto de onda do seno em Q15 com resolução de 1024 pontos por volta
+static const int16_t seno_tab[257] = {
+  0, 201, 402, 603, 804, 1005, 1206, 1407, 1608, 1809, 2009, 2210,
+  2410, 2611, 2811, 3012, 3212, 3412, 3612, 3811, 4011, 4210, 4410, 4609,
+  4808, 5007, 5205, 5404, 5602, 5800, 5998, 6195, 6393, 6590, 6786, 6983,
+  7179, 7375, 7571, 7767, 7962, 8157, 8351, 8545, 8739, 8933, 9126, 9319,
+  9512, 9704, 9896, 10087, 10278, 10469, 10659, 10849, 11039, 11228, 11417, 11605,
+  11793, 11980, 12167, 12353, 12539, 12725, 12910, 13094, 13279, 13462, 13645, 13828,
+  14010, 14191, 14372, 14553, 14732, 14912, 15090, 15269, 15446, 15623, 15800, 15976,
+  16151, 16325, 16499, 16673, 16846, 17018, 17189, 17360, 17530, 17700, 17869, 18037,
+  18204, 18371, 18537, 18703, 18868, 19032, 19195, 19357, 19519, 19680, 19841, 20000,
+  20159, 20317, 20475, 20631, 20787, 20942, 21096, 21250, 21403, 21554, 21705, 21856,
+  22005, 22154, 22301, 22448, 22594, 22739, 22884, 23027, 23170, 23311, 23452, 23592,
+  23731, 23870, 24007, 24143, 24279, 24413, 24547, 24680, 24811, 24942, 25072, 25201,
+  25329, 25456, 25582, 25708, 25832, 25955, 26077, 26198, 26319, 26438, 26556, 26674,
+  26790, 26905, 27019, 27133, 27245, 27356, 27466, 27575, 27683, 27790, 27896, 28001,
+  28105, 28208, 28310, 28411, 28510, 28609, 28706, 28803, 28898, 28992, 29085, 29177,
+  29268, 29358, 29447, 29534, 29621, 29706, 29791, 29874, 29956, 30037, 30117, 30195,
+  30273, 30349, 30424, 30498, 30571, 30643, 30714, 30783, 30852, 30919, 30985, 31050,
+  31113, 31176, 31237, 31297, 31356, 31414, 31470, 31526, 31580, 31633, 31685, 31736,
+  31785, 31833, 31880, 31926, 31971, 32014, 32057, 32098, 32137, 32176, 32213, 32250,
+  32285, 32318, 32351, 32382, 32412, 32441, 32469, 32495, 32521, 32545, 32567, 32589,
+  32609, 32628, 32646, 32663, 32678, 32692, 32705, 32717, 32728, 32737, 32745, 32752,
+  32757, 32761, 32765, 32766, 32767
+};
+
+// Seno de 2*pi*i/n em Q15, para 0 <= i < n
+static int32_t seno_q15(const espectro_t *e, uint32_t i)
+{
+  uint32_t idx = i << (10 - e->log2n);
+  uint32_t r = idx & 255;
+  switch (idx >> 8)
+  {
+  case 0:
+    return seno_tab[r];
+  case 1:
+    return seno_tab[256 - r];
+  case 2:
+    return -seno_tab[r];
+  default:
+    return -seno_tab[256 - r];
+  }
+}
+
+static int32_t cosseno_q15(const espectro_t *e, uint32_t i)
+{
+  return seno_q15(e, (i + (e->n >> 2)) & (e->n - 1));
+}
+
+static inline int32_t absoluto(int32_t v)
+{
+  return v < 0 ? -v : v;
+}
+
+bool espectro_init(espectro_t *e, int16_t *buf, uint16_t n, uint32_t taxa_hz)
+{
+  if (n != 256 && n != 512 && n != 1024)
+    return false;
+
+  e->n = n;
+  e->log2n = 0;
+  while ((1u << e->log2n) < n)
+    e->log2n++;
+  e->taxa_hz = taxa_hz;
+  e->enchendo = buf;
+  e->trabalho = buf + n;
+  e->pos = 0;
+  e->fase = ESPECTRO_OCIOSO;
+  e->janelas_perdidas = 0;
+  return true;
+}
+
+void espectro_adicionar(espectro_t *e, int16_t valor, uint32_t tempo_ms)
+{
+  e->enchendo[e->pos++] = valor;
+  if (e->pos < e->n)
+    return;
+  e->pos = 0;
+
+  // Janela anterior ainda em processamento: descarta esta e recomeça
+  if (e->fase != ESPECTRO_OCIOSO)
+  {
+    e->janelas_perdidas++;
+    return;
+  }
+  int16_t *cheio = e->enchendo;
+  e->enchendo = e->trabalho;
+  e->trabalho = cheio;
+  e->tempo_janela = tempo_ms;
+  __dmb();
+  e->fase = ESPECTRO_JANELA;
+}
+
+// Remove a média, aplica Hann, normaliza para ocupar 15 bits e reordena os pares
+// (re, im) em ordem de bits invertidos. As amostras pares e ímpares formam a parte
+// real e imaginária dos n/2 pontos complexos.
+static void preparar_janela(espectro_t *e)
+{
+  int16_t *x = e->trabalho;
+  uint32_t n = e->n;
+
+  int32_t soma = 0;
+  for (uint32_t i = 0; i < n; i++)
+    soma += x[i];
+  int32_t media = soma / (int32_t)n;
+
+  int32_t maximo = 0;
+  int32_t v[2];
+  for (uint32_t i = 0; i < n; i++)
+  {
+    int32_t w = (32768 - cosseno_q15(e, i)) >> 1;
+    int32_t d = x[i] - media;
+    if (d > 32767)
+      d = 32767;
+    else if (d < -32768)
+      d = -32768;
+    v[0] = (d * w) >> 15;
+    x[i] = (int16_t)v[0];
+    if (absoluto(v[0]) > maximo)
+      maximo = absoluto(v[0]);
+  }
+
+  // Ponto flutuante em bloco: máximo em (2^13, 2^14] para não perder resolução
+  int shift = 0;
+  while (maximo && maximo <= (1 << 13))
+  {
+    maximo <<= 1;
+    shift++;
+  }
+  if (maximo > (1 << 14))
+  {
+    for (uint32_t i = 0; i < n; i++)
+      x[i] >>= 1;
+    shift = -1;
+  }
+  else if (shift)
+  {
+    for (uint32_t i = 0; i < n; i++)
+      x[i] = (int16_t)(x[i] << shift);
+  }
+  e->expoente = (int16_t)-shift;
+  e->pico = (int16_t)(shift < 0 ? maximo >> 1 : maximo);
+
+  uint32_t m = n >> 1;
+  uint32_t bits = e->log2n - 1;
+  for (uint32_t i = 0; i < m; i++)
+  {
+    uint32_t j = 0;
+    for (uint32_t b = 0; b < bits; b++)
+      j |= ((i >> b) & 1) << (bits - 1 - b);
+    if (j > i)
+    {
+      v[0] = x[2 * i];
+      v[1] = x[2 * i + 1];
+      x[2 * i] = x[2 * j];
+      x[2 * i + 1] = x[2 * j + 1];
+      x[2 * j] = (int16_t)v[0];
+      x[2 * j + 1] = (int16_t)v[1];
+    }
+  }
+  e->estagio = 0;
+}
+
+// Um estágio radix-2 com decimação no tempo sobre os n/2 pontos complexos.
+// Só divide por 2 quando o pico anterior poderia estourar: um butterfly cresce
+// no máximo 1 + sqrt(2) vezes, então o pico é mantido abaixo de 27145.
+static void executar_estagio(espectro_t *e)
+{
+  int16_t *x = e->trabalho;
+  uint32_t m = e->n >> 1;
+  uint32_t meio = 1u << e->estagio;
+  uint32_t passo = e->n / (2 * meio);   // Passo do ângulo em unidades de 2*pi/n
+
+  int escala = e->pico > (1 << 13);
+  if (escala)
+    e->expoente++;
+
+  int32_t pico = 0;
+  for (uint32_t j = 0; j < meio; j++)
+  {
+    int32_t c = cosseno_q15(e, j * passo);
+    int32_t s = seno_q15(e, j * passo);
+    for (uint32_t k = j; k < m; k += 2 * meio)
+    {
+      int16_t *a = &x[2 * k];
+      int16_t *b = &x[2 * (k + meio)];
+      // b * W, com W = cos - j sen
+      int32_t tr = (b[0] * c + b[1] * s) >> 15;
+      int32_t ti = (b[1] * c - b[0] * s) >> 15;
+      int32_t ar = a[0], ai = a[1];
+      int32_t v0 = ar + tr, v1 = ai + ti, v2 = ar - tr, v3 = ai - ti;
+      if (escala)
+      {
+        v0 >>= 1;
+        v1 >>= 1;
+        v2 >>= 1;
+        v3 >>= 1;
+      }
+      a[0] = (int16_t)v0;
+      a[1] = (int16_t)v1;
+      b[0] = (int16_t)v2;
+      b[1] = (int16_t)v3;
+      int32_t p = absoluto(v0);
+      if (absoluto(v1) > p)
+        p = absoluto(v1);
+      if (absoluto(v2) > p)
+        p = absoluto(v2);
+      if (absoluto(v3) > p)
+        p = absoluto(v3);
+      if (p > pico)
+        pico = p;
+    }
+  }
+  e->pico = (int16_t)pico;
+  e->estagio++;
+}
+
+// Recupera o espectro de n pontos reais a partir de Z, a FFT de n/2 pontos:
+// X[k] = (Z[k] + Z*[m-k]) / 2 - j W^k (Z[k] - Z*[m-k]) / 2
+static void separar(espectro_t *e, espectro_resultado_t *r)
+{
+  const int16_t *x = e->trabalho;
+  uint32_t m = e->n >> 1;
+  uint64_t soma[ESPECTRO_BANDAS] = {0};
+  uint64_t maior = 0;
+  uint32_t k_maior = 1;
+
+  for (uint32_t k = 1; k <= m; k++)
+  {
+    uint32_t km = (m - k) & (m - 1);
+    int32_t er = (x[2 * k % e->n] + x[2 * km]) >> 1;
+    int32_t ei = (x[2 * k % e->n + 1] - x[2 * km + 1]) >> 1;
+    int32_t dr = (x[2 * k % e->n] - x[2 * km]) >> 1;
+    int32_t di = (x[2 * k % e->n + 1] + x[2 * km + 1]) >> 1;
+    int32_t c = cosseno_q15(e, k & (e->n - 1));
+    int32_t s = seno_q15(e, k & (e->n - 1));
+    int32_t xr = er + ((c * di - s * dr) >> 15);
+    int32_t xi = ei - ((c * dr + s * di) >> 15);
+
+    uint64_t p = (uint64_t)((int64_t)xr * xr + (int64_t)xi * xi);
+    if (p > maior)
+    {
+      maior = p;
+      k_maior = k;
+    }
+    // Espectro unilateral: todas as raias menos Nyquist contam em dobro
+    soma[(k - 1) * ESPECTRO_BANDAS / m] += k < m ? 2 * p : p;
+  }
+
+  // Potência média = soma * 2^(2 * expoente) / n^2, corrigida pelo ganho
+  // de potência da janela de Hann (3/8)
+  int sh = 2 * e->expoente - 2 * e->log2n;
+  for (int b = 0; b < ESPECTRO_BANDAS; b++)
+  {
+    uint64_t v = soma[b] * 8 / 3;
+    if (sh >= 0)
+      v = v > (UINT64_MAX >> sh) ? UINT64_MAX : v << sh;
+    else
+      v >>= -sh;
+    r->banda[b] = v > UINT32_MAX ? UINT32_MAX : (uint32_t)v;
+  }
+  r->freq_dominante_ch = (uint32_t)((uint64_t)k_maior * e->taxa_hz * 100 / e->n);
+  r->tempo_ms = e->tempo_janela;
+}
+
+bool espectro_processar(espectro_t *e, espectro_resultado_t *r)
+{
+  switch (e->fase)
+  {
+  case ESPECTRO_JANELA:
+    preparar_janela(e);
+    e->fase = ESPECTRO_ESTAGIO;
+    return false;
+
+  case ESPECTRO_ESTAGIO:
+    executar_estagio(e);
+    if (e->estagio == e->log2n - 1)
+      e->fase = ESPECTRO_SEPARACAO;
+    return false;
+
+  case ESPECTRO_SEPARACAO:
+    separar(e, r);
+    // Libera o buffer só depois de terminar de lê-lo
+    __dmb();
+    e->fase = ESPECTRO_OCIOSO;
+    return true;
+
+  default:
+    return false;
+  }
+}
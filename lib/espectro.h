@@ -0,0 +1,55 @@
+#ifndef ESPECTRO_H
+#define ESPECTRO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Espectro de vibração de um eixo por FFT real radix-2 em ponto fixo (Q15).
+// A janela de Hann é aplicada sobre n amostras (256, 512 ou 1024) e o resultado
+// é resumido em potência por faixa e frequência dominante.
+//
+// O temporizador enche um buffer com espectro_adicionar() enquanto o outro é
+// transformado no lugar pelo laço principal, uma etapa por chamada de
+// espectro_processar(), para não atrasar a gravação.
+
+#define ESPECTRO_N_MAX 1024
+#define ESPECTRO_BANDAS 8
+
+typedef enum {
+  ESPECTRO_OCIOSO,      // Buffer de trabalho livre
+  ESPECTRO_JANELA,      // Janela completa aguardando processamento
+  ESPECTRO_ESTAGIO,     // Estágios da FFT complexa de n/2 pontos
+  ESPECTRO_SEPARACAO    // Separação do espectro real e soma por faixa
+} espectro_fase_t;
+
+typedef struct {
+  uint32_t tempo_ms;                // Instante da última amostra da janela
+  uint32_t freq_dominante_ch;       // Frequência do maior pico, em centésimos de Hz
+  uint32_t banda[ESPECTRO_BANDAS];  // Potência média (LSB^2) em faixas iguais de 0 a fs/2
+} espectro_resultado_t;
+
+typedef struct {
+  uint16_t n;                       // Pontos por janela
+  uint16_t log2n;
+  uint32_t taxa_hz;                 // Taxa de amostragem
+  int16_t *enchendo;                // Buffer preenchido pelo temporizador
+  int16_t *trabalho;                // Janela completa, transformada no lugar
+  uint16_t pos;
+  volatile espectro_fase_t fase;
+  uint32_t tempo_janela;
+  uint16_t estagio;
+  int16_t expoente;                 // Valor real = valor calculado * 2^expoente
+  int16_t pico;                     // Maior componente após o último estágio
+  uint32_t janelas_perdidas;        // Janelas descartadas por processamento atrasado
+} espectro_t;
+
+// buf deve ter 2 * n posições; retorna false se n não for suportado
+bool espectro_init(espectro_t *e, int16_t *buf, uint16_t n, uint32_t taxa_hz);
+
+// Chamada do temporizador a cada amostra
+void espectro_adicionar(espectro_t *e, int16_t valor, uint32_t tempo_ms);
+
+// Executa uma etapa pendente; retorna true quando r recebeu o resultado de uma janela
+bool espectro_processar(espectro_t *e, espectro_resultado_t *r);
+
+#endif
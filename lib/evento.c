@@ -0,0 +1,68 @@
+#include "evento.h"
+
+void evento_init(evento_t *e, amostra_t *buf, uint32_t capacidade, uint32_t pre_amostras,
+                 uint32_t pos_amostras, int32_t limiar_accel, int32_t limiar_gyro)
+{
+  fila_init(&e->pre, buf, capacidade);
+  e->pre_amostras = pre_amostras < capacidade ? pre_amostras : capacidade;
+  e->pos_amostras = pos_amostras;
+  e->restantes = 0;
+  e->limiar_accel2 = (uint32_t)limiar_accel * (uint32_t)limiar_accel;
+  e->limiar_gyro = limiar_gyro;
+  e->disparos = 0;
+}
+
+// Compara em inteiros e sem raiz quadrada: |a|^2 cabe em 32 bits sem sinal (3 * 32768^2)
+bool evento_disparou(const evento_t *e, const amostra_t *a)
+{
+  uint32_t mod2 = 0;
+  for (int i = 0; i < 3; i++)
+  {
+    int32_t v = a->accel[i];
+    mod2 += (uint32_t)(v * v);
+  }
+  if (mod2 > e->limiar_accel2)
+    return true;
+
+  for (int i = 0; i < 3; i++)
+  {
+    int32_t g = a->gyro[i];
+    if (g > e->limiar_gyro || -g > e->limiar_gyro)
+      return true;
+  }
+  return false;
+}
+
+bool evento_processar(evento_t *e, const amostra_t *a, evento_gravar_t gravar)
+{
+  bool disparo = evento_disparou(e, a);
+
+  if (e->restantes == 0)
+  {
+    if (!disparo)
+    {
+      // Armado: apenas atualiza o histórico, descartando a amostra mais antiga
+      amostra_t descartada;
+      if (fila_tamanho(&e->pre) >= e->pre_amostras)
+        fila_pop(&e->pre, &descartada);
+      if (e->pre_amostras)
+        fila_push(&e->pre, a);
+      return true;
+    }
+
+    // Disparo: grava primeiro a janela pré-disparo
+    e->disparos++;
+    amostra_t anterior;
+    while (fila_pop(&e->pre, &anterior))
+    {
+      if (!gravar(&anterior))
+        return false;
+    }
+  }
+
+  // Um novo disparo durante a janela pós-disparo a estende
+  if (disparo)
+    e->restantes = e->pos_amostras + 1;
+  e->restantes--;
+  return gravar(a);
+}
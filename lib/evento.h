@@ -0,0 +1,29 @@
+#ifndef EVENTO_H
+#define EVENTO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "amostra.h"
+
+// Callback que grava uma amostra no cartão; retorna false em caso de falha
+typedef bool (*evento_gravar_t)(const amostra_t *a);
+
+// Captura por evento: mantém os últimos segundos em RAM e só grava a janela
+// pré-disparo + pós-disparo quando um limiar é ultrapassado
+typedef struct {
+  fila_amostras_t pre;     // Anel com o histórico pré-disparo
+  uint32_t pre_amostras;   // Quantidade de amostras mantidas antes do disparo
+  uint32_t pos_amostras;   // Quantidade de amostras gravadas após o último disparo
+  uint32_t restantes;      // Amostras pós-disparo que ainda faltam gravar (0 = armado)
+  uint32_t limiar_accel2;  // Limiar do módulo da aceleração ao quadrado (LSB^2)
+  int32_t limiar_gyro;     // Limiar da velocidade angular em qualquer eixo (LSB)
+  uint32_t disparos;       // Número de eventos detectados na sessão
+} evento_t;
+
+void evento_init(evento_t *e, amostra_t *buf, uint32_t capacidade, uint32_t pre_amostras,
+                 uint32_t pos_amostras, int32_t limiar_accel, int32_t limiar_gyro);
+bool evento_disparou(const evento_t *e, const amostra_t *a);
+bool evento_processar(evento_t *e, const amostra_t *a, evento_gravar_t gravar);
+
+#endif
@@ -0,0 +1,52 @@
+#include <string.h>
+
+#include "formatacao.h"
+#include "diskio.h"
+
+#define SETORES_POR_GB (1024u * 1024u * 2u)
+
+DWORD formatacao_cluster(LBA_t setores)
+{
+  if (setores > 512 * (LBA_t)SETORES_POR_GB)
+    return 256 * 1024;
+  if (setores > 32 * (LBA_t)SETORES_POR_GB)
+    return 128 * 1024;
+  if (setores >= 2 * (LBA_t)SETORES_POR_GB)
+    return 32 * 1024;
+  return 0;
+}
+
+FRESULT formatacao_executar(const char *unidade, BYTE pdrv, FATFS *fs, formatacao_t *info)
+{
+  memset(info, 0, sizeof(*info));
+  if (disk_initialize(pdrv) & STA_NOINIT)
+    return FR_NOT_READY;
+  if (disk_ioctl(pdrv, GET_SECTOR_COUNT, &info->setores) != RES_OK)
+    return FR_DISK_ERR;
+  if (disk_ioctl(pdrv, GET_BLOCK_SIZE, &info->au_setores) != RES_OK || info->au_setores == 0)
+    info->au_setores = 1;
+  // Uma FAT só (a segunda cópia dobraria as gravações na FAT); alinhamento pela AU
+  static BYTE trabalho[FF_MAX_SS * 4];
+  MKFS_PARM opcoes = {FM_ANY, 1, info->au_setores, 0, formatacao_cluster(info->setores)};
+  FRESULT fr = f_mkfs(unidade, &opcoes, trabalho, sizeof(trabalho));
+  if (fr == FR_MKFS_ABORTED && opcoes.au_size)
+  {
+    // Cluster incompatível com o tamanho do volume: o FatFs escolhe
+    opcoes.au_size = 0;
+    fr = f_mkfs(unidade, &opcoes, trabalho, sizeof(trabalho));
+  }
+  if (fr != FR_OK)
+    return fr;
+
+  fr = f_mount(fs, unidade, 1);
+  if (fr != FR_OK)
+    return fr;
+  FATFS *montado;
+  fr = f_getfree(unidade, &info->clusters, &montado);
+  info->tipo = fs->fs_type;
+  info->cluster_bytes = (DWORD)fs->csize * FF_MAX_SS;
+  info->inicio_dados = fs->database;
+  if (fr != FR_OK)
+    f_unmount(unidade);
+  return fr;
+}
@@ -0,0 +1,33 @@
+#ifndef FORMATACAO_H
+#define FORMATACAO_H
+
+#include <stdint.h>
+
+#include "ff.h"
+
+// Formatação do cartão para gravação sequencial. A área de dados começa numa fronteira da
+// unidade de alocação (AU) que o cartão informa no SD Status (disk_ioctl GET_BLOCK_SIZE), e
+// os clusters são grandes: cada AU é preenchida de uma vez, sem o ciclo interno de leitura,
+// apagamento e regravação que um cluster atravessando duas AUs provoca, e a FAT é
+// atualizada menos vezes por MB gravado. Os tamanhos seguem a recomendação da SD
+// Association: FAT32 com clusters de 32 KB até 32 GB, exFAT com 128 KB acima disso (256 KB
+// acima de 512 GB). Cartões pequenos ficam com a escolha do FatFs.
+
+typedef struct {
+  LBA_t setores;          // Setores do cartão
+  DWORD au_setores;       // Alinhamento usado (1: AU desconhecida)
+  DWORD cluster_bytes;    // Tamanho do cluster escolhido
+  BYTE tipo;              // FS_FAT12, FS_FAT16, FS_FAT32 ou FS_EXFAT
+  LBA_t inicio_dados;     // Primeiro setor da área de dados
+  DWORD clusters;         // Clusters livres depois da formatação
+} formatacao_t;
+
+// Tamanho de cluster em bytes para um cartão de `setores` setores; 0 deixa o FatFs escolher
+DWORD formatacao_cluster(LBA_t setores);
+
+// Formata a unidade lógica `unidade` (ex.: "0:") do drive `pdrv`, que deve estar
+// desmontada, e a monta em `fs` para conferir o resultado. Com erro, fica desmontada.
+// A classe e o UHS do cartão o driver já guarda em sd_card_t, lidos na inicialização
+FRESULT formatacao_executar(const char *unidade, BYTE pdrv, FATFS *fs, formatacao_t *info);
+
+#endif
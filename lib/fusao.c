@@ -0,0 +1,143 @@
+#include "fusao.h"
+#include "ponto_fixo.h"
+
+#define Q30_UM (1 << 30)
+
+// pi em Q32, para converter a sensibilidade do giro sem usar float
+#define PI_Q32 13493037705ull
+
+// Gravidade aceita para correção: entre 0,5 g e 1,5 g (16384 LSB/g)
+#define ACCEL_MIN 8192
+#define ACCEL_MAX 24576
+
+void fusao_init(fusao_t *f, fusao_modo_t modo, uint32_t periodo_us, uint32_t ganho_mil)
+{
+  f->q[0] = Q30_UM;
+  f->q[1] = 0;
+  f->q[2] = 0;
+  f->q[3] = 0;
+  f->modo = modo;
+
+  // rad/s por LSB = pi / (180 * 131); meio ângulo em um período = w * dt / 2
+  // k (Q40) = pi * dt_us * 2^40 / (180 * 131 * 2 * 10^6)
+  f->k_gyro = (int64_t)(((uint64_t)periodo_us * PI_Q32 << 8) / 47160000000ull);
+
+  if (modo == FUSAO_COMPLEMENTAR)
+    f->ganho = (int32_t)(((uint64_t)ganho_mil * periodo_us << 30) / 2000000000ull);
+  else
+    f->ganho = (int32_t)(((uint64_t)ganho_mil * periodo_us << 30) / 1000000000ull);
+}
+
+// Q30 x valor de 64 bits (|b| < 2^33), resultado em 64 bits
+static inline int64_t mul_q30_64(int32_t a, int64_t b)
+{
+  return (a * b) >> 30;
+}
+
+// Normaliza o acelerômetro para um vetor unitário em Q30; retorna 0 se a
+// medida não for confiável como referência de gravidade
+static int normalizar_accel(const int16_t accel[3], int32_t u[3])
+{
+  uint32_t mod2 = 0;
+  for (int i = 0; i < 3; i++)
+    mod2 += (uint32_t)((int32_t)accel[i] * accel[i]);
+  uint32_t mod = isqrt32(mod2);
+  if (mod < ACCEL_MIN || mod > ACCEL_MAX)
+    return 0;
+
+  int64_t inv = (1ll << 46) / mod; // 2^30 / |a| em Q16
+  for (int i = 0; i < 3; i++)
+    u[i] = (int32_t)((accel[i] * inv) >> 16);
+  return 1;
+}
+
+// Renormaliza com um passo de Newton: q *= (3 - |q|^2) / 2. Basta porque |q|
+// se afasta de 1 muito pouco a cada amostra, e evita raiz e divisão.
+static void renormalizar(int32_t q[4])
+{
+  int64_t n2 = 0;
+  for (int i = 0; i < 4; i++)
+    n2 += (int64_t)q[i] * q[i];
+  int32_t fator = (int32_t)((3ll << 29) - (n2 >> 31));
+  for (int i = 0; i < 4; i++)
+    q[i] = mul_q30(q[i], fator);
+}
+
+void fusao_atualizar(fusao_t *f, const int16_t accel[3], const int16_t gyro[3])
+{
+  int32_t *q = f->q;
+
+  // Meio ângulo girado em cada eixo neste período (Q30)
+  int32_t h[3];
+  for (int i = 0; i < 3; i++)
+    h[i] = (int32_t)((gyro[i] * f->k_gyro) >> 10);
+
+  int32_t a[3];
+  int tem_gravidade = normalizar_accel(accel, a);
+
+  // Correção de gradiente do Madgwick, aplicada depois da integração
+  int32_t s[4] = {0, 0, 0, 0};
+
+  if (tem_gravidade && f->modo == FUSAO_COMPLEMENTAR)
+  {
+    // Direção da gravidade estimada pelo quaternion
+    int32_t vx = 2 * (mul_q30(q[1], q[3]) - mul_q30(q[0], q[2]));
+    int32_t vy = 2 * (mul_q30(q[0], q[1]) + mul_q30(q[2], q[3]));
+    int32_t vz = mul_q30(q[0], q[0]) - mul_q30(q[1], q[1]) - mul_q30(q[2], q[2]) + mul_q30(q[3], q[3]);
+
+    // Erro = medida x estimativa, realimentado no giro
+    h[0] += mul_q30(mul_q30(a[1], vz) - mul_q30(a[2], vy), f->ganho);
+    h[1] += mul_q30(mul_q30(a[2], vx) - mul_q30(a[0], vz), f->ganho);
+    h[2] += mul_q30(mul_q30(a[0], vy) - mul_q30(a[1], vx), f->ganho);
+  }
+  else if (tem_gravidade && f->modo == FUSAO_MADGWICK)
+  {
+    // Resíduo f = gravidade estimada - medida, e gradiente J^T f (em int64, pode passar de 2)
+    int64_t f1 = 2ll * (mul_q30(q[1], q[3]) - mul_q30(q[0], q[2])) - a[0];
+    int64_t f2 = 2ll * (mul_q30(q[0], q[1]) + mul_q30(q[2], q[3])) - a[1];
+    int64_t f3 = Q30_UM - 2ll * (mul_q30(q[1], q[1]) + mul_q30(q[2], q[2])) - a[2];
+
+    int64_t g[4];
+    g[0] = -2 * mul_q30_64(q[2], f1) + 2 * mul_q30_64(q[1], f2);
+    g[1] = 2 * mul_q30_64(q[3], f1) + 2 * mul_q30_64(q[0], f2) - 4 * mul_q30_64(q[1], f3);
+    g[2] = -2 * mul_q30_64(q[0], f1) + 2 * mul_q30_64(q[3], f2) - 4 * mul_q30_64(q[2], f3);
+    g[3] = 2 * mul_q30_64(q[1], f1) + 2 * mul_q30_64(q[2], f2);
+
+    // Normaliza o gradiente; reduz para Q24 para que a soma dos quadrados caiba em 64 bits
+    uint64_t n2 = 0;
+    for (int i = 0; i < 4; i++)
+    {
+      g[i] >>= 6;
+      n2 += (uint64_t)(g[i] * g[i]);
+    }
+    uint32_t n = isqrt64(n2);
+    if (n)
+    {
+      int64_t inv = (1ll << 54) / n; // 2^30 / |g| em Q24
+      for (int i = 0; i < 4; i++)
+        s[i] = mul_q30((int32_t)((g[i] * inv) >> 24), f->ganho);
+    }
+  }
+
+  // Integração: q += q (x) (0, h)
+  int32_t dq0 = -mul_q30(q[1], h[0]) - mul_q30(q[2], h[1]) - mul_q30(q[3], h[2]);
+  int32_t dq1 = mul_q30(q[0], h[0]) + mul_q30(q[2], h[2]) - mul_q30(q[3], h[1]);
+  int32_t dq2 = mul_q30(q[0], h[1]) - mul_q30(q[1], h[2]) + mul_q30(q[3], h[0]);
+  int32_t dq3 = mul_q30(q[0], h[2]) + mul_q30(q[1], h[1]) - mul_q30(q[2], h[0]);
+  q[0] += dq0 - s[0];
+  q[1] += dq1 - s[1];
+  q[2] += dq2 - s[2];
+  q[3] += dq3 - s[3];
+
+  renormalizar(q);
+}
+
+void fusao_para_amostra(const fusao_t *f, amostra_t *a)
+{
+  a->accel[0] = f->q[0] >> 16;
+  a->accel[1] = f->q[1] >> 16;
+  a->accel[2] = f->q[2] >> 16;
+  a->gyro[0] = f->q[3] >> 16;
+  a->gyro[1] = 0;
+  a->gyro[2] = 0;
+}
@@ -0,0 +1,36 @@
+#ifndef FUSAO_H
+#define FUSAO_H
+
+#include <stdint.h>
+
+#include "amostra.h"
+
+// Fusão de acelerômetro e giroscópio em ponto fixo, sem uso de float.
+// O quaternion de orientação (w, x, y, z) é mantido em Q30.
+//
+// FUSAO_COMPLEMENTAR: filtro complementar na forma de quaternion (Mahony, só
+// termo proporcional): o erro entre a gravidade medida e a estimada corrige o giro.
+// FUSAO_MADGWICK: um passo de descida de gradiente por amostra (Madgwick, IMU).
+//
+// Sem magnetômetro o yaw não tem referência absoluta e deriva com o bias do giro.
+
+typedef enum {
+  FUSAO_COMPLEMENTAR,
+  FUSAO_MADGWICK
+} fusao_modo_t;
+
+typedef struct {
+  int32_t q[4];        // Quaternion unitário em Q30
+  fusao_modo_t modo;
+  int64_t k_gyro;      // Meio ângulo por LSB do giro em um período, em Q40
+  int32_t ganho;       // Kp * dt / 2 (complementar) ou beta * dt (Madgwick), em Q30
+} fusao_t;
+
+// ganho_mil: Kp (complementar) ou beta (Madgwick) em milésimos, ex.: 1000 -> 1,0
+void fusao_init(fusao_t *f, fusao_modo_t modo, uint32_t periodo_us, uint32_t ganho_mil);
+void fusao_atualizar(fusao_t *f, const int16_t accel[3], const int16_t gyro[3]);
+
+// Guarda o quaternion em Q14 numa amostra: accel = (w, x, y), gyro = (z, 0, 0)
+void fusao_para_amostra(const fusao_t *f, amostra_t *a);
+
+#endif
@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "indice.h"
+
+// Fragmentos previstos na tabela de busca rápida do índice durante a busca
+#define CLMT_TAM 16
+
+static void escrever_u32(uint8_t *p, uint32_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static uint32_t ler_u32(const uint8_t *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void indice_nome(const char *log, char *nome, size_t tam)
+{
+  snprintf(nome, tam, "%s", log);
+  char *ponto = strrchr(nome, '.');
+  size_t base = ponto ? (size_t)(ponto - nome) : strlen(nome);
+  snprintf(nome + base, tam - base, ".idx");
+}
+
+static FRESULT escrever_cabecalho(indice_t *x)
+{
+  uint8_t c[INDICE_CABECALHO];
+  escrever_u32(c, INDICE_MAGICO);
+  c[4] = 1;
+  c[5] = 0;
+  c[6] = x->formato;
+  c[7] = x->formato >> 8;
+  escrever_u32(c + 8, x->passo);
+  escrever_u32(c + 12, x->sessao);
+  UINT bw;
+  FRESULT fr = f_write(&x->arquivo, c, sizeof(c), &bw);
+  return fr == FR_OK && bw != sizeof(c) ? FR_DENIED : fr;
+}
+
+FRESULT indice_criar(indice_t *x, const char *nome, uint16_t formato, uint32_t passo, uint32_t sessao)
+{
+  memset(x, 0, sizeof(*x));
+  x->formato = formato;
+  x->passo = passo;
+  x->sessao = sessao;
+  FRESULT fr = f_open(&x->arquivo, nome, FA_WRITE | FA_CREATE_ALWAYS);
+  if (fr != FR_OK)
+    return fr;
+  fr = escrever_cabecalho(x);
+  if (fr == FR_OK)
+    fr = f_sync(&x->arquivo);
+  if (fr != FR_OK)
+  {
+    f_close(&x->arquivo);
+    return fr;
+  }
+  x->confirmado = INDICE_CABECALHO;
+  x->aberto = true;
+  return FR_OK;
+}
+
+FRESULT indice_reabrir(indice_t *x, const char *nome)
+{
+  if (!x->aberto)
+    return FR_OK;
+  FRESULT fr = f_open(&x->arquivo, nome, FA_WRITE | FA_OPEN_APPEND);
+  if (fr != FR_OK)
+    return fr;
+  if (f_size(&x->arquivo) == 0)
+  {
+    // Outro cartão: o índice recomeça, como o log
+    fr = escrever_cabecalho(x);
+    x->confirmado = INDICE_CABECALHO;
+    x->proximo = x->proximo_confirmado = 0;
+  }
+  else if (f_size(&x->arquivo) > x->confirmado)
+  {
+    fr = f_lseek(&x->arquivo, x->confirmado);
+    if (fr == FR_OK)
+      fr = f_truncate(&x->arquivo);
+  }
+  return fr;
+}
+
+// Grava as pendentes no arquivo, sem confirmar
+static FRESULT descarregar(indice_t *x)
+{
+  uint8_t e[INDICE_PENDENTES * INDICE_ENTRADA];
+  for (int i = 0; i < x->n_pendentes; i++)
+  {
+    uint8_t *p = e + i * INDICE_ENTRADA;
+    uint64_t off = x->pendentes[i].offset;
+    escrever_u32(p, (uint32_t)off);
+    escrever_u32(p + 4, (uint32_t)(off >> 32));
+    escrever_u32(p + 8, x->pendentes[i].tempo_ms);
+    escrever_u32(p + 12, x->pendentes[i].amostra);
+  }
+  UINT n = x->n_pendentes * INDICE_ENTRADA, bw;
+  FRESULT fr = n ? f_write(&x->arquivo, e, n, &bw) : FR_OK;
+  if (fr == FR_OK && n && bw != n)
+    fr = FR_DENIED;
+  if (fr == FR_OK)
+    x->n_pendentes = 0;
+  return fr;
+}
+
+FRESULT indice_registrar(indice_t *x, FSIZE_t offset, uint32_t tempo_ms, uint32_t amostra)
+{
+  if (!x->aberto || offset < x->proximo)
+    return FR_OK;
+  // Fila cheia entre dois syncs: as entradas vão ao arquivo e são confirmadas no próximo
+  if (x->n_pendentes == INDICE_PENDENTES)
+  {
+    FRESULT fr = descarregar(x);
+    if (fr != FR_OK)
+      return fr;
+  }
+  x->pendentes[x->n_pendentes++] = (indice_entrada_t){offset, tempo_ms, amostra};
+  x->proximo = offset + 1;
+  return FR_OK;
+}
+
+FRESULT indice_sync(indice_t *x)
+{
+  if (!x->aberto)
+    return FR_OK;
+  FRESULT fr = descarregar(x);
+  if (fr == FR_OK)
+    fr = f_sync(&x->arquivo);
+  if (fr != FR_OK)
+    return fr;
+  x->confirmado = f_size(&x->arquivo);
+  x->proximo_confirmado = x->proximo;
+  return FR_OK;
+}
+
+void indice_descartar(indice_t *x)
+{
+  x->n_pendentes = 0;
+  x->proximo = x->proximo_confirmado;
+}
+
+FRESULT indice_fechar(indice_t *x)
+{
+  if (!x->aberto)
+    return FR_OK;
+  FRESULT fr = descarregar(x);
+  FRESULT fr_close = f_close(&x->arquivo);
+  x->aberto = false;
+  return fr != FR_OK ? fr : fr_close;
+}
+
+static bool ler_entrada(FIL *f, uint32_t i, indice_entrada_t *e)
+{
+  uint8_t p[INDICE_ENTRADA];
+  UINT br;
+  if (f_lseek(f, INDICE_CABECALHO + (FSIZE_t)i * INDICE_ENTRADA) != FR_OK ||
+      f_read(f, p, sizeof(p), &br) != FR_OK || br != sizeof(p))
+    return false;
+  e->offset = ler_u32(p) | ((FSIZE_t)ler_u32(p + 4) << 32);
+  e->tempo_ms = ler_u32(p + 8);
+  e->amostra = ler_u32(p + 12);
+  return true;
+}
+
+FRESULT indice_buscar(const char *nome, uint16_t formato, uint32_t passo, uint32_t sessao, uint32_t alvo,
+                      FSIZE_t limite, indice_entrada_t *e, uint32_t *leituras)
+{
+  memset(e, 0, sizeof(*e));
+  *leituras = 0;
+
+  FIL f;
+  FRESULT fr = f_open(&f, nome, FA_READ);
+  if (fr != FR_OK)
+    return FR_NO_FILE;
+  uint8_t c[INDICE_CABECALHO];
+  UINT br;
+  fr = f_read(&f, c, sizeof(c), &br);
+  // Um índice que sobrou de outra gravação apontaria para posições sem sentido neste log
+  if (fr != FR_OK || br != sizeof(c) || ler_u32(c) != INDICE_MAGICO || c[4] != 1 || c[5] != 0 ||
+      (c[6] | c[7] << 8) != formato || ler_u32(c + 8) != passo || ler_u32(c + 12) != sessao)
+  {
+    f_close(&f);
+    return fr != FR_OK ? fr : FR_NO_FILE;
+  }
+
+  DWORD clmt[CLMT_TAM];
+  clmt[0] = CLMT_TAM;
+  f.cltbl = clmt;
+  if (f_lseek(&f, CREATE_LINKMAP) != FR_OK)
+    f.cltbl = NULL;
+
+  // As entradas que satisfazem tempo < alvo e offset < limite formam um prefixo
+  uint32_t lo = 0, hi = (uint32_t)((f_size(&f) - INDICE_CABECALHO) / INDICE_ENTRADA);
+  indice_entrada_t m;
+  while (lo < hi)
+  {
+    uint32_t meio = lo + (hi - lo) / 2;
+    (*leituras)++;
+    if (!ler_entrada(&f, meio, &m))
+    {
+      f_close(&f);
+      return FR_INT_ERR;
+    }
+    if (m.tempo_ms < alvo && m.offset < limite)
+    {
+      *e = m;
+      lo = meio + 1;
+    }
+    else
+      hi = meio;
+  }
+  f_close(&f);
+  return FR_OK;
+}
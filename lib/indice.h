@@ -0,0 +1,83 @@
+#ifndef INDICE_H
+#define INDICE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "ff.h"
+
+// Índice de tempo gravado ao lado do log (mpu_data.csv -> mpu_data.idx): a cada `passo`
+// registros, o tempo e a posição do registro no arquivo. Achar um instante numa gravação
+// longa passa a custar uma busca binária no índice e um f_lseek no log, em vez de ler o
+// log desde o início.
+//
+//   off  tam  campo
+//     0    4  magico (INDICE_MAGICO)
+//     4    2  versao (1)
+//     6    2  formato (0: CSV, 1: binário)
+//     8    4  passo   linhas do CSV ou blocos do binário entre entradas
+//    12    4  sessao  identificador da gravação binária (0 no CSV)
+//    16  ...  entradas de 16 bytes: offset (u64), tempo_ms (u32), amostra (u32)
+// Todos os campos são little-endian. Offsets e tempos crescem ao longo do arquivo.
+//
+// As entradas ficam em RAM até indice_sync(), chamado junto com o f_sync do log, então o
+// índice no cartão nunca aponta além do que o log tem confirmado. Depois de uma queda de
+// energia o log binário é cortado no último bloco válido e pode terminar antes da última
+// entrada; a busca ignora entradas além do tamanho atual do log.
+
+#define INDICE_MAGICO 0x58554D49u // "IMUX"
+#define INDICE_CABECALHO 16
+#define INDICE_ENTRADA 16
+#define INDICE_PENDENTES 32
+
+typedef struct {
+  FSIZE_t offset;    // Início do registro (linha ou bloco) no log
+  uint32_t tempo_ms; // Tempo do registro (no binário, do quadro-chave)
+  uint32_t amostra;  // Número da amostra na gravação
+} indice_entrada_t;
+
+typedef struct {
+  FIL arquivo;
+  bool aberto;
+  uint16_t formato;
+  uint32_t passo;
+  uint32_t sessao;
+  indice_entrada_t pendentes[INDICE_PENDENTES];
+  uint8_t n_pendentes;
+  FSIZE_t confirmado;          // Tamanho do índice no último indice_sync
+  FSIZE_t proximo;             // Menor offset aceito na próxima entrada (deduplica regravações)
+  FSIZE_t proximo_confirmado;  // Idem, no último indice_sync
+} indice_t;
+
+// Nome do índice de um log: troca a extensão por .idx
+void indice_nome(const char *log, char *nome, size_t tam);
+
+// Cria o índice de uma gravação nova, vazio. Com falha, `aberto` fica false e as demais
+// chamadas de gravação não fazem nada: a gravação segue sem índice
+FRESULT indice_criar(indice_t *x, const char *nome, uint16_t formato, uint32_t passo, uint32_t sessao);
+
+// Reabre depois de uma falha do cartão, descartando o que passou do último indice_sync
+FRESULT indice_reabrir(indice_t *x, const char *nome);
+
+// Registra um registro do log; entradas que não avançam em relação à última são ignoradas,
+// como as refeitas pela regravação do diário
+FRESULT indice_registrar(indice_t *x, FSIZE_t offset, uint32_t tempo_ms, uint32_t amostra);
+
+// Grava as entradas pendentes e confirma o índice no cartão
+FRESULT indice_sync(indice_t *x);
+
+// Esquece as entradas posteriores ao último indice_sync (o log volta ao último sync)
+void indice_descartar(indice_t *x);
+
+FRESULT indice_fechar(indice_t *x);
+
+// Procura a última entrada com tempo_ms < alvo e offset < limite (tamanho atual do log).
+// Sem nenhuma, retorna a entrada zerada (início do log). `leituras` recebe as entradas
+// lidas na busca. formato, passo e sessao são os do log (no binário, a sessão do seu
+// primeiro bloco): FR_NO_FILE se o índice não existir, não for reconhecido ou for de
+// outra gravação
+FRESULT indice_buscar(const char *nome, uint16_t formato, uint32_t passo, uint32_t sessao, uint32_t alvo,
+                      FSIZE_t limite, indice_entrada_t *e, uint32_t *leituras);
+
+#endif
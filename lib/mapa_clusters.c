@@ -0,0 +1,153 @@
+#include <string.h>
+
+#include "mapa_clusters.h"
+
+// Tabela mínima que o FatFs aceita: tamanho, um fragmento e o terminador
+#define TABELA_MIN 4
+
+void mapa_clusters_iniciar(mapa_clusters_t *c, DWORD *memoria, uint32_t palavras)
+{
+  memset(c, 0, sizeof(*c));
+  c->memoria = memoria;
+  c->palavras = palavras;
+}
+
+void mapa_clusters_esquecer(mapa_clusters_t *c, FATFS *fs)
+{
+  for (int i = 0; i < MAPA_CLUSTERS_ENTRADAS; i++)
+  {
+    if (!fs || c->entradas[i].fs == fs)
+      c->entradas[i].uso = 0;
+  }
+}
+
+// Maior trecho livre da memória; `entrada` recebe uma entrada livre, ou -1
+static uint32_t maior_livre(mapa_clusters_t *c, uint32_t *inicio, int *entrada)
+{
+  uint32_t maior = 0;
+  uint32_t pos = 0;
+  *entrada = -1;
+  *inicio = 0;
+  // Percorre as tabelas na ordem da memória, medindo os buracos entre elas
+  for (;;)
+  {
+    int prox = -1;
+    for (int i = 0; i < MAPA_CLUSTERS_ENTRADAS; i++)
+    {
+      mapa_clusters_entrada_t *e = &c->entradas[i];
+      if (e->uso && e->palavras && e->inicio >= pos && (prox < 0 || e->inicio < c->entradas[prox].inicio))
+        prox = i;
+    }
+    uint32_t fim = prox < 0 ? c->palavras : c->entradas[prox].inicio;
+    if (fim - pos > maior)
+    {
+      maior = fim - pos;
+      *inicio = pos;
+    }
+    if (prox < 0)
+      break;
+    pos = c->entradas[prox].inicio + c->entradas[prox].palavras;
+  }
+  for (int i = 0; i < MAPA_CLUSTERS_ENTRADAS && *entrada < 0; i++)
+  {
+    if (!c->entradas[i].uso)
+      *entrada = i;
+  }
+  return maior;
+}
+
+// Descarta a tabela usada há mais tempo; false se não houver nenhuma
+static bool descartar_antiga(mapa_clusters_t *c)
+{
+  int antiga = -1;
+  for (int i = 0; i < MAPA_CLUSTERS_ENTRADAS; i++)
+  {
+    if (c->entradas[i].uso && (antiga < 0 || c->entradas[i].uso < c->entradas[antiga].uso))
+      antiga = i;
+  }
+  if (antiga < 0)
+    return false;
+  c->entradas[antiga].uso = 0;
+  return true;
+}
+
+// Trecho livre de ao menos `palavras` (e uma entrada), descartando tabelas antigas
+static bool reservar(mapa_clusters_t *c, uint32_t palavras, uint32_t *inicio, int *entrada)
+{
+  for (;;)
+  {
+    if (maior_livre(c, inicio, entrada) >= palavras && *entrada >= 0)
+      return true;
+    if (!descartar_antiga(c))
+      return false;
+  }
+}
+
+static void guardar(mapa_clusters_t *c, int i, const FIL *f, uint32_t inicio, uint32_t palavras)
+{
+  mapa_clusters_entrada_t *e = &c->entradas[i];
+  e->fs = f->obj.fs;
+  e->id = f->obj.id;
+  e->sclust = f->obj.sclust;
+  e->tamanho = f->obj.objsize;
+  e->inicio = inicio;
+  e->palavras = palavras;
+  e->uso = c->relogio;
+}
+
+bool mapa_clusters_usar(mapa_clusters_t *c, FIL *f)
+{
+  f->cltbl = NULL;
+  c->relogio++;
+  for (int i = 0; i < MAPA_CLUSTERS_ENTRADAS; i++)
+  {
+    mapa_clusters_entrada_t *e = &c->entradas[i];
+    if (e->uso && e->fs == f->obj.fs && e->id == f->obj.id && e->sclust == f->obj.sclust &&
+        e->tamanho == f->obj.objsize)
+    {
+      // Uma entrada sem palavras lembra que a tabela não cabe, para não percorrer a FAT à toa
+      e->uso = c->relogio;
+      f->cltbl = e->palavras ? c->memoria + e->inicio : NULL;
+      c->acertos++;
+      return f->cltbl != NULL;
+    }
+  }
+
+  // Primeira tentativa no maior trecho livre; se não couber, o FatFs informa o tamanho
+  // necessário e a tabela é construída de novo num trecho desse tamanho
+  uint32_t inicio;
+  int livre;
+  if (!reservar(c, TABELA_MIN, &inicio, &livre))
+    return false;
+  uint32_t palavras = maior_livre(c, &inicio, &livre);
+  DWORD *tabela = c->memoria + inicio;
+  tabela[0] = palavras;
+  f->cltbl = tabela;
+  FRESULT fr = f_lseek(f, CREATE_LINKMAP);
+  c->construcoes++;
+  if (fr == FR_NOT_ENOUGH_CORE)
+  {
+    palavras = tabela[0];
+    if (palavras > c->palavras || !reservar(c, palavras, &inicio, &livre))
+    {
+      f->cltbl = NULL;
+      c->sem_memoria++;
+      if (reservar(c, 0, &inicio, &livre))
+        guardar(c, livre, f, 0, 0);
+      return false;
+    }
+    tabela = c->memoria + inicio;
+    tabela[0] = palavras;
+    f->cltbl = tabela;
+    fr = f_lseek(f, CREATE_LINKMAP);
+    c->construcoes++;
+  }
+  if (fr != FR_OK)
+  {
+    f->cltbl = NULL;
+    return false;
+  }
+
+  guardar(c, livre, f, inicio, tabela[0]); // O FatFs deixa em tabela[0] as palavras usadas
+  return true;
+}
@@ -0,0 +1,55 @@
+#ifndef MAPA_CLUSTERS_H
+#define MAPA_CLUSTERS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ff.h"
+
+// Cache de tabelas de busca rápida (FF_USE_FASTSEEK) dos arquivos lidos. Sem a tabela, um
+// f_lseek para longe do início percorre a cadeia de clusters lendo a FAT setor a setor (um
+// log de 4 GB em clusters de 32 KB passa de 1000 setores de FAT); com ela, a posição sai da
+// tabela em RAM. A tabela de um arquivo custa 2 palavras por fragmento mais 2, e é
+// construída uma vez: as próximas aberturas do mesmo arquivo, sem mudança de tamanho,
+// reaproveitam a guardada.
+//
+// A memória é dada pelo chamador e dividida entre até MAPA_CLUSTERS_ENTRADAS arquivos; para
+// caber uma tabela nova, as usadas há mais tempo são descartadas. Um arquivo cuja tabela não
+// cabe no orçamento inteiro é lido seguindo a FAT, como antes; a cache lembra disso (sem
+// gastar memória) para não percorrer a cadeia de novo a cada abertura.
+
+#define MAPA_CLUSTERS_ENTRADAS 4
+
+typedef struct {
+  FATFS *fs;
+  WORD id;           // Montagem do volume (fs->id) quando a tabela foi construída
+  DWORD sclust;      // Primeiro cluster do arquivo
+  FSIZE_t tamanho;   // Tamanho do arquivo quando a tabela foi construída
+  uint32_t inicio;   // Posição da tabela na memória, em palavras
+  uint32_t palavras; // 0: a tabela não cabe no orçamento
+  uint32_t uso;      // Ordem do último uso; 0 = entrada livre
+} mapa_clusters_entrada_t;
+
+typedef struct {
+  DWORD *memoria;
+  uint32_t palavras;
+  mapa_clusters_entrada_t entradas[MAPA_CLUSTERS_ENTRADAS];
+  uint32_t relogio;
+  uint32_t acertos;     // Aberturas resolvidas pela cache, sem percorrer a FAT
+  uint32_t construcoes; // Tabelas construídas percorrendo a FAT
+  uint32_t sem_memoria; // Arquivos fragmentados demais para o orçamento
+} mapa_clusters_t;
+
+void mapa_clusters_iniciar(mapa_clusters_t *c, DWORD *memoria, uint32_t palavras);
+
+// Liga a tabela do arquivo `f`, aberto só para leitura, guardada ou construída agora.
+// Retorna false se ela não couber (f->cltbl fica NULL e a busca segue a FAT). A tabela
+// pertence à cache: pode ser descartada por uma chamada seguinte para outro arquivo, então
+// só um arquivo por vez deve usá-la
+bool mapa_clusters_usar(mapa_clusters_t *c, FIL *f);
+
+// Descarta as tabelas de um volume (todos com fs NULL), antes de desmontá-lo ou de
+// reescrever arquivos nele
+void mapa_clusters_esquecer(mapa_clusters_t *c, FATFS *fs);
+
+#endif
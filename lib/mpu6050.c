@@ -0,0 +1,321 @@
+#include "mpu6050.h"
+
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+
+#define REG_PWR_MGMT_1 0x6B
+#define REG_ACCEL_XOUT_H 0x3B
+
+bool mpu6050_reset(const mpu6050_t *s)
+{
+  // Dois bytes por escrita: primeiro o registrador, depois o dado
+  uint8_t buf[] = {REG_PWR_MGMT_1, 0x80};
+  if (i2c_write_timeout_us(s->i2c, s->endereco, buf, 2, false, MPU6050_PRAZO_US) != 2)
+    return false;
+  sleep_ms(100); // Aguarda reset e estabilização
+
+  // Sai do modo sleep
+  buf[1] = 0x00;
+  bool ok = i2c_write_timeout_us(s->i2c, s->endereco, buf, 2, false, MPU6050_PRAZO_US) == 2;
+  sleep_ms(10); // Aguarda estabilização após acordar
+  return ok;
+}
+
+// Enfileira a transação completa no FIFO de transmissão (16 posições): a escrita do
+// ponteiro e os 14 comandos de leitura, com RESTART no primeiro e STOP no último.
+// Retorna false se o controlador continuar ocupado (SCL presa pelo escravo)
+static bool rajada_iniciar(const mpu6050_t *s)
+{
+  i2c_hw_t *hw = i2c_get_hw(s->i2c);
+  // O STOP da rajada anterior ainda pode estar saindo quando os dados chegam
+  absolute_time_t prazo = make_timeout_time_us(MPU6050_ESPERA_STOP_US);
+  while (hw->status & I2C_IC_STATUS_MST_ACTIVITY_BITS)
+  {
+    if (absolute_time_diff_us(get_absolute_time(), prazo) <= 0)
+      return false;
+  }
+  hw->enable = 0;
+  hw->tar = s->endereco;
+  hw->enable = 1;
+  hw->data_cmd = REG_ACCEL_XOUT_H;
+  for (int i = 0; i < MPU6050_RAJADA; i++)
+  {
+    hw->data_cmd = I2C_IC_DATA_CMD_CMD_BITS |
+                   (i == 0 ? I2C_IC_DATA_CMD_RESTART_BITS : 0) |
+                   (i == MPU6050_RAJADA - 1 ? I2C_IC_DATA_CMD_STOP_BITS : 0);
+  }
+  return true;
+}
+
+// Aguarda os 14 bytes no FIFO de recepção; um NACK aborta a transação e esvazia os FIFOs.
+// No fim do prazo o controlador é desligado, o que descarta os comandos que sobraram
+static bool rajada_concluir(const mpu6050_t *s, uint8_t *buf, absolute_time_t prazo)
+{
+  i2c_hw_t *hw = i2c_get_hw(s->i2c);
+  while (hw->rxflr < MPU6050_RAJADA)
+  {
+    bool abortada = hw->raw_intr_stat & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS;
+    if (abortada || absolute_time_diff_us(get_absolute_time(), prazo) <= 0)
+    {
+      if (!abortada)
+        hw->enable = 0;
+      (void)hw->clr_tx_abrt;
+      while (hw->rxflr)
+        (void)hw->data_cmd;
+      return false;
+    }
+  }
+  for (int i = 0; i < MPU6050_RAJADA; i++)
+    buf[i] = (uint8_t)hw->data_cmd;
+  return true;
+}
+
+// Registradores em big-endian: aceleração em 0..5, temperatura em 6..7, giroscópio em 8..13
+static void decodificar(const uint8_t *buf, int16_t accel[3], int16_t gyro[3])
+{
+  for (int i = 0; i < 3; i++)
+  {
+    accel[i] = (int16_t)(buf[i * 2] << 8 | buf[i * 2 + 1]);
+    gyro[i] = (int16_t)(buf[8 + i * 2] << 8 | buf[8 + i * 2 + 1]);
+  }
+}
+
+bool mpu6050_ler(const mpu6050_t *s, int16_t accel[3], int16_t gyro[3])
+{
+  uint8_t buf[MPU6050_RAJADA];
+  if (!rajada_iniciar(s) || !rajada_concluir(s, buf, make_timeout_time_us(MPU6050_PRAZO_US)))
+    return false;
+  decodificar(buf, accel, gyro);
+  return true;
+}
+
+void mpu6050_converter(const int16_t accel[3], const int16_t gyro[3], float *ax, float *ay, float *az,
+                       float *gx, float *gy, float *gz)
+{
+  const float sensibilidade_accel = 16384.0f;
+  *ax = accel[0] / sensibilidade_accel;
+  *ay = accel[1] / sensibilidade_accel;
+  *az = accel[2] / sensibilidade_accel;
+
+  const float sensibilidade_gyro = 131.0f;
+  *gx = gyro[0] / sensibilidade_gyro;
+  *gy = gyro[1] / sensibilidade_gyro;
+  *gz = gyro[2] / sensibilidade_gyro;
+}
+
+void mpu6050_grupo_init(mpu6050_grupo_t *g)
+{
+  g->n = 0;
+  g->n_barramento[0] = g->n_barramento[1] = 0;
+  g->desvio_us = 0;
+  g->desvio_max_us = 0;
+  g->falhas = 0;
+  for (int i = 0; i < MPU6050_MAX_SENSORES; i++)
+    g->seguidas[i] = 0;
+}
+
+bool mpu6050_grupo_adicionar(mpu6050_grupo_t *g, i2c_inst_t *i2c, uint8_t endereco)
+{
+  uint b = i2c_hw_index(i2c);
+  if (g->n >= MPU6050_MAX_SENSORES || g->n_barramento[b] >= 2)
+    return false;
+  g->sensor[g->n].i2c = i2c;
+  g->sensor[g->n].endereco = endereco;
+  g->ordem[b][g->n_barramento[b]++] = g->n++;
+  return true;
+}
+
+uint32_t mpu6050_grupo_ler(mpu6050_grupo_t *g, int16_t accel[][3], int16_t gyro[][3], uint64_t *instante_us)
+{
+  uint32_t lidos = 0;
+  uint64_t primeiro = 0, ultimo = 0;
+  uint8_t passos = g->n_barramento[0] > g->n_barramento[1] ? g->n_barramento[0] : g->n_barramento[1];
+  for (uint8_t p = 0; p < passos; p++)
+  {
+    // As rajadas dos dois barramentos partem com poucos ciclos de diferença
+    uint64_t inicio = time_us_64();
+    bool iniciada[2] = {false, false};
+    for (int b = 0; b < 2; b++)
+    {
+      if (p < g->n_barramento[b])
+        iniciada[b] = rajada_iniciar(&g->sensor[g->ordem[b][p]]);
+    }
+    if (p == 0)
+      primeiro = inicio;
+    ultimo = inicio;
+
+    absolute_time_t prazo = make_timeout_time_us(MPU6050_PRAZO_US);
+    for (int b = 0; b < 2; b++)
+    {
+      if (p >= g->n_barramento[b])
+        continue;
+      uint8_t i = g->ordem[b][p];
+      uint8_t buf[MPU6050_RAJADA];
+      if (iniciada[b] && rajada_concluir(&g->sensor[i], buf, prazo))
+      {
+        decodificar(buf, accel[i], gyro[i]);
+        lidos |= 1u << i;
+        g->seguidas[i] = 0;
+      }
+      else
+      {
+        g->falhas++;
+        if (g->seguidas[i] < UINT16_MAX)
+          g->seguidas[i]++;
+      }
+    }
+  }
+  g->desvio_us = (uint32_t)(ultimo - primeiro);
+  if (g->desvio_us > g->desvio_max_us)
+    g->desvio_max_us = g->desvio_us;
+  *instante_us = primeiro + g->desvio_us / 2;
+  return lidos;
+}
+
+// Ponteiro de registrador e 14 leituras, na forma em que vão para o IC_DATA_CMD
+static const uint32_t comandos_rajada[1 + MPU6050_RAJADA] = {
+  REG_ACCEL_XOUT_H,
+  I2C_IC_DATA_CMD_CMD_BITS | I2C_IC_DATA_CMD_RESTART_BITS,
+  I2C_IC_DATA_CMD_CMD_BITS, I2C_IC_DATA_CMD_CMD_BITS, I2C_IC_DATA_CMD_CMD_BITS,
+  I2C_IC_DATA_CMD_CMD_BITS, I2C_IC_DATA_CMD_CMD_BITS, I2C_IC_DATA_CMD_CMD_BITS,
+  I2C_IC_DATA_CMD_CMD_BITS, I2C_IC_DATA_CMD_CMD_BITS, I2C_IC_DATA_CMD_CMD_BITS,
+  I2C_IC_DATA_CMD_CMD_BITS, I2C_IC_DATA_CMD_CMD_BITS, I2C_IC_DATA_CMD_CMD_BITS,
+  I2C_IC_DATA_CMD_CMD_BITS | I2C_IC_DATA_CMD_STOP_BITS,
+};
+
+static mpu6050_dma_t *leitores[MPU6050_DMA_MAX];
+
+static void preparar_controlador(const mpu6050_dma_t *d)
+{
+  i2c_hw_t *hw = i2c_get_hw(d->sensor.i2c);
+  hw->enable = 0;
+  hw->tar = d->sensor.endereco;
+  hw->dma_tdlr = 8; // DREQ com o FIFO pela metade, para o DMA manter o barramento ocupado
+  hw->dma_rdlr = 0;
+  hw->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS | I2C_IC_DMA_CR_RDMAE_BITS;
+  hw->enable = 1;
+}
+
+// Interrompe os dois canais. A IRQ fica desligada durante o abort, que pode sinalizar um
+// fim falso (errata RP2040-E13)
+static void cancelar(mpu6050_dma_t *d)
+{
+  d->ocupado = false;
+  dma_channel_set_irq1_enabled(d->canal_rx, false);
+  dma_channel_abort(d->canal_tx);
+  dma_channel_abort(d->canal_rx);
+  dma_channel_acknowledge_irq1(d->canal_rx);
+  dma_channel_set_irq1_enabled(d->canal_rx, true);
+}
+
+static void dma_irq_handler()
+{
+  for (int i = 0; i < MPU6050_DMA_MAX; i++)
+  {
+    mpu6050_dma_t *d = leitores[i];
+    if (!d || !dma_channel_get_irq1_status(d->canal_rx))
+      continue;
+    dma_channel_acknowledge_irq1(d->canal_rx);
+    if (!d->ocupado)
+      continue; // Fim de um canal abortado
+    d->ocupado = false;
+    d->seguidas = 0;
+    d->cabeca++;
+    if (d->concluida)
+      d->concluida();
+  }
+}
+
+bool mpu6050_dma_init(mpu6050_dma_t *d, i2c_inst_t *i2c, uint8_t endereco, void (*concluida)(void))
+{
+  uint b = i2c_hw_index(i2c);
+  if (leitores[b])
+    return false;
+  d->sensor.i2c = i2c;
+  d->sensor.endereco = endereco;
+  d->cabeca = d->cauda = 0;
+  d->ocupado = false;
+  d->perdidas = 0;
+  d->seguidas = 0;
+  d->concluida = concluida;
+  d->canal_tx = dma_claim_unused_channel(true);
+  d->canal_rx = dma_claim_unused_channel(true);
+
+  i2c_hw_t *hw = i2c_get_hw(i2c);
+  preparar_controlador(d);
+
+  dma_channel_config c = dma_channel_get_default_config(d->canal_tx);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+  channel_config_set_read_increment(&c, true);
+  channel_config_set_write_increment(&c, false);
+  channel_config_set_dreq(&c, i2c_get_dreq(i2c, true));
+  dma_channel_configure(d->canal_tx, &c, &hw->data_cmd, comandos_rajada, count_of(comandos_rajada), false);
+
+  c = dma_channel_get_default_config(d->canal_rx);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, true);
+  channel_config_set_dreq(&c, i2c_get_dreq(i2c, false));
+  dma_channel_configure(d->canal_rx, &c, d->anel[0], &hw->data_cmd, MPU6050_RAJADA, false);
+
+  bool primeiro = !leitores[b ^ 1];
+  leitores[b] = d;
+  dma_channel_set_irq1_enabled(d->canal_rx, true);
+  if (primeiro)
+  {
+    irq_add_shared_handler(DMA_IRQ_1, dma_irq_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_1, true);
+  }
+  return true;
+}
+
+bool mpu6050_dma_disparar(mpu6050_dma_t *d)
+{
+  i2c_hw_t *hw = i2c_get_hw(d->sensor.i2c);
+  if (d->ocupado)
+  {
+    // Sem resposta em um período inteiro: NACK (o controlador descarta o resto da lista)
+    // ou barramento preso. Cancela e recomeça do zero
+    cancelar(d);
+    (void)hw->clr_tx_abrt;
+    while (hw->rxflr)
+      (void)hw->data_cmd;
+    d->perdidas++;
+    if (d->seguidas < UINT16_MAX)
+      d->seguidas++;
+  }
+  if (d->cabeca - d->cauda >= MPU6050_DMA_POSICOES)
+  {
+    d->perdidas++;
+    return false;
+  }
+  uint32_t pos = d->cabeca & (MPU6050_DMA_POSICOES - 1);
+  d->instante_us[pos] = time_us_64();
+  d->ocupado = true;
+  dma_channel_set_write_addr(d->canal_rx, d->anel[pos], false);
+  dma_channel_set_trans_count(d->canal_rx, MPU6050_RAJADA, false);
+  dma_channel_set_read_addr(d->canal_tx, comandos_rajada, false);
+  dma_channel_set_trans_count(d->canal_tx, count_of(comandos_rajada), false);
+  dma_start_channel_mask((1u << d->canal_tx) | (1u << d->canal_rx));
+  return true;
+}
+
+bool mpu6050_dma_retirar(mpu6050_dma_t *d, int16_t accel[3], int16_t gyro[3], uint64_t *instante_us)
+{
+  uint32_t cauda = d->cauda;
+  if (cauda == d->cabeca)
+    return false;
+  uint32_t pos = cauda & (MPU6050_DMA_POSICOES - 1);
+  decodificar(d->anel[pos], accel, gyro);
+  *instante_us = d->instante_us[pos];
+  d->cauda = cauda + 1;
+  return true;
+}
+
+void mpu6050_dma_retomar(mpu6050_dma_t *d)
+{
+  cancelar(d);
+  d->seguidas = 0;
+  preparar_controlador(d);
+}
@@ -0,0 +1,103 @@
+#ifndef MPU6050_H
+#define MPU6050_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "hardware/i2c.h"
+
+// MPU6050 em I2C: um sensor é identificado pelo barramento e pelo endereço (0x68 com
+// o pino AD0 em nível baixo, 0x69 em nível alto), então cabem até quatro em i2c0 e i2c1.
+//
+// A leitura é uma rajada de 14 bytes a partir de ACCEL_XOUT_H (aceleração, temperatura e
+// giroscópio), que o sensor entrega de um mesmo instante. A transação inteira (ponteiro
+// de registrador + 14 comandos de leitura) é enfileirada de uma vez no FIFO de
+// transmissão do controlador, sem esperar byte a byte; assim os dois barramentos
+// trabalham em paralelo e, no mesmo barramento, uma rajada começa logo após a outra.
+//
+// Toda espera no barramento tem prazo: no pior caso (sensor mudo, SDA presa) um passo da
+// rodada custa MPU6050_ESPERA_STOP_US por barramento mais MPU6050_PRAZO_US, e uma rodada
+// com dois sensores por barramento fica abaixo de 5 ms. Quem chama acompanha as falhas
+// seguidas de cada sensor e decide quando limpar o barramento e reiniciar o sensor.
+
+#define MPU6050_ENDERECO_AD0_BAIXO 0x68
+#define MPU6050_ENDERECO_AD0_ALTO 0x69
+#define MPU6050_MAX_SENSORES 4
+#define MPU6050_RAJADA 14
+#define MPU6050_PRAZO_US 2000         // Limite para uma rajada (ou escrita) terminar
+#define MPU6050_ESPERA_STOP_US 100    // Limite para o STOP anterior sair antes de uma rajada
+
+typedef struct {
+  i2c_inst_t *i2c;
+  uint8_t endereco;
+} mpu6050_t;
+
+// Sensores lidos em rodada com um carimbo de tempo comum. Cada passo da rodada lê o
+// n-ésimo sensor de cada barramento ao mesmo tempo
+typedef struct {
+  mpu6050_t sensor[MPU6050_MAX_SENSORES];
+  uint8_t n;
+  uint8_t ordem[2][2];                // Índices dos sensores de cada barramento
+  uint8_t n_barramento[2];
+  uint32_t desvio_us;                 // Entre a primeira e a última rajada da última rodada
+  uint32_t desvio_max_us;
+  uint32_t falhas;                    // Rajadas sem resposta ou abortadas
+  uint16_t seguidas[MPU6050_MAX_SENSORES]; // Falhas seguidas de cada sensor
+} mpu6050_grupo_t;
+
+// Reinicia o sensor e o tira do modo sleep; retorna false se ele não responder
+bool mpu6050_reset(const mpu6050_t *s);
+
+// Lê aceleração e giroscópio brutos numa rajada; retorna false se o sensor não responder
+bool mpu6050_ler(const mpu6050_t *s, int16_t accel[3], int16_t gyro[3]);
+
+// Converte valores brutos em unidades físicas (g e °/s) nas escalas padrão de ±2 g e ±250 °/s
+void mpu6050_converter(const int16_t accel[3], const int16_t gyro[3], float *ax, float *ay, float *az,
+                       float *gx, float *gy, float *gz);
+
+void mpu6050_grupo_init(mpu6050_grupo_t *g);
+
+// Acrescenta um sensor ao grupo; retorna false se o grupo ou o barramento estiver cheio
+bool mpu6050_grupo_adicionar(mpu6050_grupo_t *g, i2c_inst_t *i2c, uint8_t endereco);
+
+// Lê todos os sensores numa rodada. instante_us recebe o meio da rodada (tempo desde o
+// boot), comum a todas as amostras. Retorna a máscara dos sensores lidos (bit i = sensor i)
+uint32_t mpu6050_grupo_ler(mpu6050_grupo_t *g, int16_t accel[][3], int16_t gyro[][3], uint64_t *instante_us);
+
+// Leitura por DMA: um canal escreve a lista de comandos da rajada (ponteiro + 14 leituras)
+// no IC_DATA_CMD, ritmado pelo DREQ de transmissão, e outro leva os 14 bytes recebidos
+// direto para uma posição do anel, ritmado pelo DREQ de recepção. O fim da recepção gera
+// a IRQ DMA_IRQ_1 (compartilhada), que avança o anel e chama `concluida`. A CPU só
+// dispara a sequência e consome o resultado; não espera nenhum byte no barramento.
+#define MPU6050_DMA_POSICOES 8        // Potência de 2
+#define MPU6050_DMA_MAX 2             // Um sensor por barramento
+
+typedef struct {
+  mpu6050_t sensor;
+  uint canal_tx, canal_rx;
+  uint8_t anel[MPU6050_DMA_POSICOES][16];     // 14 bytes usados por posição
+  uint64_t instante_us[MPU6050_DMA_POSICOES]; // Disparo de cada leitura
+  volatile uint32_t cabeca;                   // Leituras concluídas (IRQ)
+  volatile uint32_t cauda;                    // Leituras consumidas
+  volatile bool ocupado;                      // Leitura em curso
+  uint32_t perdidas;                          // Disparos sem conclusão ou com o anel cheio
+  uint16_t seguidas;                          // Disparos seguidos sem conclusão
+  void (*concluida)(void);
+} mpu6050_dma_t;
+
+// Reserva os canais de DMA e prepara o controlador; o barramento fica dedicado ao sensor
+// enquanto houver leituras por DMA
+bool mpu6050_dma_init(mpu6050_dma_t *d, i2c_inst_t *i2c, uint8_t endereco, void (*concluida)(void));
+
+// Dispara uma leitura (para chamar do temporizador). Uma leitura anterior que não terminou
+// (sensor sem resposta, barramento preso) é abortada e contada em `perdidas`
+bool mpu6050_dma_disparar(mpu6050_dma_t *d);
+
+// Retira a leitura mais antiga do anel; retorna false se não houver
+bool mpu6050_dma_retirar(mpu6050_dma_t *d, int16_t accel[3], int16_t gyro[3], uint64_t *instante_us);
+
+// Cancela a leitura em curso e refaz a configuração do controlador, depois que o
+// barramento foi reiniciado
+void mpu6050_dma_retomar(mpu6050_dma_t *d);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef PONTO_FIXO_H
+#define PONTO_FIXO_H
+
+#include <stdint.h>
+
+// Auxiliares de aritmética inteira para o Cortex-M0+ (sem FPU)
+
+// Produto de dois valores Q30 resultando em Q30
+static inline int32_t mul_q30(int32_t a, int32_t b)
+{
+  return (int32_t)(((int64_t)a * b) >> 30);
+}
+
+// Raiz quadrada inteira (piso) pelo método dígito a dígito; sem divisões
+static inline uint32_t isqrt64(uint64_t x)
+{
+  uint64_t resultado = 0;
+  uint64_t bit = 1ull << 62;
+  while (bit > x)
+    bit >>= 2;
+  while (bit)
+  {
+    if (x >= resultado + bit)
+    {
+      x -= resultado + bit;
+      resultado = (resultado >> 1) + bit;
+    }
+    else
+    {
+      resultado >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint32_t)resultado;
+}
+
+static inline uint32_t isqrt32(uint32_t x)
+{
+  uint32_t resultado = 0;
+  uint32_t bit = 1u << 30;
+  while (bit > x)
+    bit >>= 2;
+  while (bit)
+  {
+    if (x >= resultado + bit)
+    {
+      x -= resultado + bit;
+      resultado = (resultado >> 1) + bit;
+    }
+    else
+    {
+      resultado >>= 1;
+    }
+    bit >>= 2;
+  }
+  return resultado;
+}
+
+#endif
@@ -0,0 +1,186 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "recuperacao.h"
+#include "compressao.h"
+
+// Fragmentos previstos na tabela de busca rápida; o arquivo pré-alocado tem um só
+#define CLMT_TAM 32
+
+// Blocos sem ordem garantida no fim: o cache de escrita pode gravar setores fora de ordem
+// dentro de uma mesma descarga, então os últimos blocos são conferidos um a um
+#define VERIFICACAO_FINAL 16
+
+static uint8_t bloco[BLOCO_TAM];
+
+static void caminho_marcador(char *caminho, size_t tam, const char *volume)
+{
+  snprintf(caminho, tam, "%s%s", volume, RECUPERACAO_MARCADOR);
+}
+
+// Marcador: arquivo, sessão, membros, membro e faixa numa linha
+static FRESULT gravar_marcador(const char *volume, const char *arquivo, uint32_t sessao, uint32_t membros,
+                               uint32_t membro, uint32_t faixa)
+{
+  char caminho[24];
+  caminho_marcador(caminho, sizeof(caminho), volume);
+  FIL marcador;
+  FRESULT fr = f_open(&marcador, caminho, FA_WRITE | FA_CREATE_ALWAYS);
+  if (fr != FR_OK)
+    return fr;
+  char linha[80];
+  int len = snprintf(linha, sizeof(linha), "%s %lu %lu %lu %lu\n", arquivo, (unsigned long)sessao,
+                     (unsigned long)membros, (unsigned long)membro, (unsigned long)faixa);
+  UINT bw;
+  fr = f_write(&marcador, linha, len, &bw);
+  FRESULT fr_close = f_close(&marcador);
+  return fr != FR_OK ? fr : fr_close;
+}
+
+FRESULT recuperacao_iniciar(FIL *fp, const char *arquivo, uint32_t sessao, FSIZE_t prealocar)
+{
+  // Grava já a entrada de diretório com o tamanho pré-alocado: após uma queda, é ela que
+  // delimita a área onde a busca procura os blocos
+  FRESULT fr = f_expand(fp, prealocar, 1);
+  if (fr == FR_OK)
+    fr = f_sync(fp);
+  if (fr != FR_OK)
+    return fr;
+  return gravar_marcador("", arquivo, sessao, 1, 0, 1);
+}
+
+FRESULT recuperacao_retomar(FIL *fp, const char *arquivo, uint32_t sessao, FSIZE_t prealocar)
+{
+  // f_expand só aceita arquivos vazios; levar o ponteiro além do fim aloca os clusters que
+  // faltam, em geral logo em seguida aos do arquivo
+  FSIZE_t pos = f_tell(fp);
+  FRESULT fr = FR_OK;
+  if (f_size(fp) < prealocar)
+  {
+    fr = f_lseek(fp, prealocar);
+    if (fr == FR_OK && f_tell(fp) != prealocar)
+      fr = FR_DENIED; // Cartão cheio
+  }
+  if (fr == FR_OK)
+    fr = f_sync(fp);
+  FRESULT fr_volta = f_lseek(fp, pos);
+  if (fr == FR_OK)
+    fr = fr_volta;
+  if (fr != FR_OK)
+    return fr;
+  return gravar_marcador("", arquivo, sessao, 1, 0, 1);
+}
+
+FRESULT recuperacao_encerrar(FIL *fp)
+{
+  FRESULT fr = f_truncate(fp);
+  if (fr != FR_OK)
+    return fr;
+  fr = f_sync(fp);
+  if (fr != FR_OK)
+    return fr;
+  return recuperacao_desmarcar("");
+}
+
+FRESULT recuperacao_marcar(const char *volume, const char *arquivo, uint32_t sessao, uint32_t membros,
+                           uint32_t membro, uint32_t faixa)
+{
+  if (membros == 0 || membro >= membros || faixa == 0)
+    return FR_INVALID_PARAMETER;
+  return gravar_marcador(volume, arquivo, sessao, membros, membro, faixa);
+}
+
+FRESULT recuperacao_desmarcar(const char *volume)
+{
+  char caminho[24];
+  caminho_marcador(caminho, sizeof(caminho), volume);
+  FRESULT fr = f_unlink(caminho);
+  return fr == FR_NO_FILE ? FR_OK : fr;
+}
+
+// Lê o bloco i do arquivo e confere se é o bloco da sessão que deveria estar ali
+static bool bloco_da_sessao(FIL *fp, recuperacao_t *r, uint32_t i)
+{
+  UINT br;
+  r->leituras++;
+  if (f_lseek(fp, (FSIZE_t)i * BLOCO_TAM) != FR_OK ||
+      f_read(fp, bloco, BLOCO_TAM, &br) != FR_OK || br != BLOCO_TAM)
+    return false;
+  uint32_t seq = (i / r->faixa) * r->membros * r->faixa + r->membro * r->faixa + i % r->faixa;
+  return bloco_valido(bloco, r->sessao) && bloco_seq(bloco) == seq;
+}
+
+FRESULT recuperacao_executar(recuperacao_t *r, const char *volume)
+{
+  memset(r, 0, sizeof(*r));
+
+  char caminho[24];
+  caminho_marcador(caminho, sizeof(caminho), volume);
+  FIL f;
+  FRESULT fr = f_open(&f, caminho, FA_READ);
+  if (fr != FR_OK)
+    return FR_NO_FILE;
+  char linha[80];
+  UINT br;
+  fr = f_read(&f, linha, sizeof(linha) - 1, &br);
+  f_close(&f);
+  if (fr != FR_OK)
+    return fr;
+  linha[br] = '\0';
+  // Marcadores antigos só têm arquivo e sessão
+  unsigned long sessao, membros = 1, membro = 0, faixa = 1;
+  int campos = sscanf(linha, "%31s %lu %lu %lu %lu", r->arquivo, &sessao, &membros, &membro, &faixa);
+  if ((campos != 2 && campos != 5) || membros == 0 || membro >= membros || faixa == 0)
+    return FR_INVALID_OBJECT;
+  r->sessao = sessao;
+  r->membros = membros;
+  r->membro = membro;
+  r->faixa = faixa;
+
+  fr = f_open(&f, r->arquivo, FA_READ | FA_WRITE);
+  if (fr != FR_OK)
+    return fr;
+
+  // Tabela de busca rápida: cada f_lseek vira uma conta em vez de percorrer a FAT
+  DWORD clmt[CLMT_TAM];
+  clmt[0] = CLMT_TAM;
+  f.cltbl = clmt;
+  if (f_lseek(&f, CREATE_LINKMAP) != FR_OK)
+    f.cltbl = NULL;
+
+  // Os blocos válidos formam um prefixo: busca o primeiro inválido em [0, total]
+  uint32_t total = (uint32_t)(f_size(&f) / BLOCO_TAM);
+  uint32_t lo = 0, hi = total;
+  while (lo < hi)
+  {
+    uint32_t meio = lo + (hi - lo) / 2;
+    if (bloco_da_sessao(&f, r, meio))
+      lo = meio + 1;
+    else
+      hi = meio;
+  }
+
+  // Confere os últimos blocos do prefixo e corta no primeiro buraco
+  uint32_t inicio = lo > VERIFICACAO_FINAL ? lo - VERIFICACAO_FINAL : 0;
+  for (uint32_t i = inicio; i < lo; i++)
+  {
+    if (!bloco_da_sessao(&f, r, i))
+    {
+      lo = i;
+      break;
+    }
+  }
+  r->blocos = lo;
+  r->tamanho = (FSIZE_t)lo * BLOCO_TAM;
+
+  // O f_lseek rápido já deixa o cluster atual pronto para o f_truncate liberar o resto
+  fr = f_lseek(&f, r->tamanho);
+  if (fr == FR_OK)
+    fr = f_truncate(&f);
+  FRESULT fr_close = f_close(&f);
+  if (fr == FR_OK)
+    fr = fr_close;
+  if (fr == FR_OK)
+    fr = f_unlink(caminho);
+  return fr;
+}
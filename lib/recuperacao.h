@@ -0,0 +1,57 @@
+#ifndef RECUPERACAO_H
+#define RECUPERACAO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ff.h"
+
+// Recuperação de sessões binárias interrompidas por queda de energia.
+//
+// Ao iniciar a gravação o arquivo é pré-alocado de forma contígua (f_expand) e um arquivo
+// marcador guarda seu nome e a sessão. Se o marcador ainda existir no boot, a sessão não
+// foi fechada: o tamanho registrado no diretório é o da pré-alocação e o fim real é
+// encontrado por busca binária sobre os blocos de 512 bytes (sessão, sequência e CRC),
+// lendo O(log n) setores mesmo em arquivos de vários GB.
+//
+// No RAID (raid.h) cada cartão tem seu próprio marcador, na raiz do seu volume, para o
+// arquivo que recebeu: no espelho ele tem a sessão inteira; em faixas, o bloco i do arquivo
+// é o bloco (i / faixa) * membros * faixa + membro * faixa + i % faixa da sessão.
+
+#define RECUPERACAO_MARCADOR "sessao.rec"
+
+typedef struct {
+  char arquivo[32];
+  uint32_t sessao;
+  uint32_t membros;      // Cartões entre os quais os blocos foram distribuídos (1 sem faixas)
+  uint32_t membro;
+  uint32_t faixa;        // Blocos seguidos em cada cartão
+  uint32_t blocos;       // Blocos válidos mantidos
+  uint32_t leituras;     // Blocos lidos durante a busca
+  FSIZE_t tamanho;       // Tamanho final do arquivo
+} recuperacao_t;
+
+// Pré-aloca o arquivo recém-criado (ainda vazio) e grava o marcador da sessão
+FRESULT recuperacao_iniciar(FIL *fp, const char *arquivo, uint32_t sessao, FSIZE_t prealocar);
+
+// Continua a sessão num arquivo reaberto após uma falha do cartão, que recuperacao_executar
+// já cortou: volta a estender o arquivo até prealocar e recria o marcador. O ponteiro do
+// arquivo fica onde estava
+FRESULT recuperacao_retomar(FIL *fp, const char *arquivo, uint32_t sessao, FSIZE_t prealocar);
+
+// Corta a pré-alocação não usada e remove o marcador; chamar antes de f_close
+FRESULT recuperacao_encerrar(FIL *fp);
+
+// Grava o marcador de um membro do RAID no volume do cartão (ex.: "1:"), depois que
+// raid_open pré-alocou o arquivo (caminho completo, ex.: "1:mpu_data.imu")
+FRESULT recuperacao_marcar(const char *volume, const char *arquivo, uint32_t sessao, uint32_t membros,
+                           uint32_t membro, uint32_t faixa);
+
+// Remove o marcador do volume depois que raid_close cortou e fechou o arquivo
+FRESULT recuperacao_desmarcar(const char *volume);
+
+// Procura uma sessão não fechada no volume ("" para a unidade padrão) e restaura o
+// tamanho do arquivo. Retorna FR_NO_FILE se não houver nada a recuperar
+FRESULT recuperacao_executar(recuperacao_t *r, const char *volume);
+
+#endif
@@ -0,0 +1,96 @@
+#include "resumo.h"
+#include "ponto_fixo.h"
+
+static void reiniciar(resumo_t *r, uint32_t inicio_ms)
+{
+  r->inicio_ms = inicio_ms;
+  r->n = 0;
+  for (int i = 0; i < RESUMO_EIXOS; i++)
+  {
+    r->acc[i].soma = 0;
+    r->acc[i].soma2 = 0;
+    r->acc[i].min = INT16_MAX;
+    r->acc[i].max = INT16_MIN;
+  }
+}
+
+void resumo_init(resumo_t *r, uint32_t janela_ms)
+{
+  r->janela_ms = janela_ms;
+  reiniciar(r, 0);
+}
+
+static void acumular_eixo(resumo_acumulador_t *acc, int32_t v)
+{
+  acc->soma += v;
+  acc->soma2 += (uint32_t)(v * v);
+  if (v < acc->min)
+    acc->min = (int16_t)v;
+  if (v > acc->max)
+    acc->max = (int16_t)v;
+}
+
+static void acumular(resumo_t *r, const amostra_t *a)
+{
+  for (int i = 0; i < 3; i++)
+  {
+    acumular_eixo(&r->acc[i], a->accel[i]);
+    acumular_eixo(&r->acc[i + 3], a->gyro[i]);
+  }
+  r->n++;
+}
+
+static void fechar(const resumo_t *r, resumo_registro_t *saida)
+{
+  uint64_t n = r->n;
+  saida->tempo_ms = r->inicio_ms;
+  saida->n = r->n;
+
+  for (int i = 0; i < RESUMO_EIXOS; i++)
+  {
+    const resumo_acumulador_t *acc = &r->acc[i];
+    resumo_eixo_t *e = &saida->eixo[i];
+
+    // Média em Q8 arredondada
+    int64_t media = acc->soma * 256;
+    media = (media >= 0 ? media + (int64_t)(n / 2) : media - (int64_t)(n / 2)) / (int64_t)n;
+    e->media = (int32_t)media;
+    e->min = acc->min;
+    e->max = acc->max;
+
+    // n * soma2 - soma^2 = n^2 * variância; cabe em 64 bits com n <= 65535
+    uint64_t var_n2 = n * acc->soma2 - (uint64_t)(acc->soma * acc->soma);
+    e->desvio = isqrt64((var_n2 / n << 16) / n);
+    // soma2 <= 65535 * 2^30, então soma2 << 16 ainda cabe em 64 bits
+    e->rms = isqrt64((acc->soma2 << 16) / n);
+
+    int32_t acima = acc->max < 0 ? -acc->max : acc->max;
+    int32_t abaixo = acc->min < 0 ? -acc->min : acc->min;
+    e->pico = (uint32_t)(acima > abaixo ? acima : abaixo) << 8;
+    e->crista = e->rms ? (uint32_t)(((uint64_t)e->pico << 8) / e->rms) : 0;
+  }
+}
+
+bool resumo_adicionar(resumo_t *r, const amostra_t *a, resumo_registro_t *saida)
+{
+  bool fechou = false;
+  if (r->n && (a->tempo_ms - r->inicio_ms >= r->janela_ms || r->n >= RESUMO_MAX_AMOSTRAS))
+  {
+    fechar(r, saida);
+    fechou = true;
+    reiniciar(r, a->tempo_ms);
+  }
+  if (r->n == 0)
+    r->inicio_ms = a->tempo_ms;
+  acumular(r, a);
+  return fechou;
+}
+
+bool resumo_finalizar(resumo_t *r, resumo_registro_t *saida)
+{
+  if (r->n == 0)
+    return false;
+  fechar(r, saida);
+  reiniciar(r, 0);
+  return true;
+}
@@ -0,0 +1,58 @@
+#ifndef RESUMO_H
+#define RESUMO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "amostra.h"
+
+// Estatísticas por janela de tempo para cada um dos 6 eixos (accel x, y, z e giro x, y, z),
+// calculadas só com inteiros. Os valores fracionários saem em Q8 (LSB * 256).
+//
+// Em vez da atualização de Welford, que exige uma divisão por amostra, a janela acumula
+// a soma e a soma dos quadrados em 64 bits. Como a soma é exata, a variância
+// (n * soma2 - soma^2) / n^2 não sofre cancelamento numérico enquanto n <= 65535.
+
+#define RESUMO_EIXOS 6
+#define RESUMO_MAX_AMOSTRAS 65535
+
+typedef struct {
+  int32_t media;       // Média (Q8)
+  int16_t min;
+  int16_t max;
+  uint32_t desvio;     // Desvio padrão (Q8)
+  uint32_t rms;        // Valor eficaz, raiz da média dos quadrados (Q8)
+  uint32_t pico;       // Maior valor absoluto: max(|min|, |max|) (Q8)
+  uint32_t crista;     // Fator de crista pico / rms (Q8); 0 se o sinal for nulo
+} resumo_eixo_t;
+
+typedef struct {
+  uint32_t tempo_ms;   // Instante da primeira amostra da janela
+  uint32_t n;          // Amostras na janela
+  resumo_eixo_t eixo[RESUMO_EIXOS];
+} resumo_registro_t;
+
+typedef struct {
+  int64_t soma;
+  uint64_t soma2;
+  int16_t min;
+  int16_t max;
+} resumo_acumulador_t;
+
+typedef struct {
+  uint32_t janela_ms;
+  uint32_t inicio_ms;
+  uint32_t n;
+  resumo_acumulador_t acc[RESUMO_EIXOS];
+} resumo_t;
+
+void resumo_init(resumo_t *r, uint32_t janela_ms);
+
+// Acumula a amostra. Quando ela cai fora da janela atual, fecha a janela em saida,
+// inicia a próxima com esta amostra e retorna true
+bool resumo_adicionar(resumo_t *r, const amostra_t *a, resumo_registro_t *saida);
+
+// Fecha a janela parcial ao encerrar a gravação; retorna false se estiver vazia
+bool resumo_finalizar(resumo_t *r, resumo_registro_t *saida);
+
+#endif
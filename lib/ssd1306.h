@@ -5,6 +5,11 @@
 #define WIDTH 128
 #define HEIGHT 64
 
+// Deadline per I2C transaction: a fixed part plus a per-byte budget (one byte takes
+// 22.5 us at 400 kHz), so a stuck bus costs at most one deadline per call
+#define SSD1306_TIMEOUT_US 1000
+#define SSD1306_BYTE_US 50
+
 typedef enum {
   SET_CONTRAST = 0x81,
   SET_ENTIRE_ON = 0xA4,
@@ -32,12 +37,13 @@ typedef struct {
   uint8_t *ram_buffer;
   size_t bufsize;
   uint8_t port_buffer[2];
+  uint32_t errors;                    // Transactions that timed out or were not acknowledged
 } ssd1306_t;
 
 void ssd1306_init(ssd1306_t *ssd, uint8_t width, uint8_t height, bool external_vcc, uint8_t address, i2c_inst_t *i2c);
-void ssd1306_config(ssd1306_t *ssd);
-void ssd1306_command(ssd1306_t *ssd, uint8_t command);
-void ssd1306_send_data(ssd1306_t *ssd);
+bool ssd1306_config(ssd1306_t *ssd);
+bool ssd1306_command(ssd1306_t *ssd, uint8_t command);
+bool ssd1306_send_data(ssd1306_t *ssd);
 
 void ssd1306_pixel(ssd1306_t *ssd, uint8_t x, uint8_t y, bool value);
 void ssd1306_fill(ssd1306_t *ssd, bool value);